@@ -0,0 +1,24 @@
+#pragma once
+
+#include "../utils/common.h"
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Shared by the bench/ programs, which are built with the release flags and
+ * run with `make bench`. Each prints its own table, and returns 1 if anything
+ * it drives fails so the run stops there.
+ *
+ * Every bench defines _POSIX_C_SOURCE before its includes, for clock_gettime.
+ */
+
+// Written to so the compiler can't drop work whose result is never used.
+static volatile u64 bench_sink;
+
+// Seconds, monotonic.
+static inline f64 bench_Now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (f64)now.tv_sec + (f64)now.tv_nsec * 1e-9;
+}
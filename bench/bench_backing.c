@@ -0,0 +1,106 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../types/array.h"
+#include "bench.h"
+#include <string.h>
+
+/*
+ * Iteration over layout like chunk storage (a vector of 256 byte chunks, 8
+ * entities of a 32 byte prop each) of the same size, for every MemBacking.
+ * Mapped backings prefer the node of this thread. Huge pages mostly show on
+ * the random chunk accesses, where every access is a likely TLB miss.
+ */
+#define CHUNK_SIZE (256)
+#define CHUNK_COUNT ((u64)1 << 20)
+#define SEQ_PASSES (8)
+#define RANDOM_ACCESSES ((u64)1 << 24)
+
+// Transparent huge pages the process has, in MB, from smaps_rollup.
+static u64 GetHugePagesMB(void) {
+  FILE *file = fopen("/proc/self/smaps_rollup", "r");
+  if (!file) {
+    return 0;
+  }
+  char line[256];
+  u64 kb = 0;
+  while (fgets(line, sizeof(line), file)) {
+    if (sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) {
+      break;
+    }
+  }
+  fclose(file);
+
+  return kb / 1024;
+}
+
+// NULL backing means a plain heap vector, as layouts use when mmap fails.
+static int BenchBacking(const char *name, const MemBacking *backing) {
+  u64 huge_mb = GetHugePagesMB();
+  Vector *vector =
+      (backing) ? arr_VectorVirtualCreateWBacking(CHUNK_SIZE, CHUNK_COUNT,
+                                                  *backing, MEM_CATEGORY_ECS)
+                : arr_VectorCustomCreate(CHUNK_SIZE, CHUNK_COUNT);
+  if (!vector || arr_VectorReserve(vector, CHUNK_COUNT) != SUCCESS ||
+      arr_VectorSetLen(vector, CHUNK_COUNT) != SUCCESS) {
+    return 1;
+  }
+  u8 *mem = arr_VectorRaw(vector);
+
+  // Every page gets faulted in here.
+  f64 start = bench_Now();
+  memset(mem, 1, CHUNK_SIZE * CHUNK_COUNT);
+  f64 fault_time = bench_Now() - start;
+  huge_mb = GetHugePagesMB() - huge_mb;
+
+  u64 sum = 0;
+  start = bench_Now();
+  for (u64 pass = 0; pass < SEQ_PASSES; pass++) {
+    const u64 *words = (const u64 *)mem;
+    for (u64 i = 0; i < CHUNK_SIZE * CHUNK_COUNT / sizeof(u64); i++) {
+      sum += words[i];
+    }
+  }
+  f64 seq_time = bench_Now() - start;
+
+  u64 rng = 0x9e3779b97f4a7c15ULL;
+  start = bench_Now();
+  for (u64 i = 0; i < RANDOM_ACCESSES; i++) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    // A prop of one of the chunk's entities.
+    sum += *(const u64 *)(mem + (rng % CHUNK_COUNT) * CHUNK_SIZE +
+                          (rng >> 60) % 8 * 32);
+  }
+  f64 random_time = bench_Now() - start;
+  bench_sink = sum;
+
+  printf("%-24s %10.1f %10.2f %12.2f %10zu\n", name, fault_time * 1e3,
+         (f64)(SEQ_PASSES * CHUNK_SIZE * CHUNK_COUNT) / seq_time / 1e9,
+         random_time * 1e9 / RANDOM_ACCESSES, huge_mb);
+  arr_VectorDelete(vector);
+
+  return 0;
+}
+
+int main(void) {
+  printf("%zuMB of %d byte chunks\n", CHUNK_SIZE * CHUNK_COUNT >> 20,
+         CHUNK_SIZE);
+  printf("%-24s %10s %10s %12s %10s\n", "", "fault ms", "seq GB/s",
+         "random ns", "THP MB");
+
+  MemBacking heap = {.mode = MEM_BACKING_HEAP,
+                     .numa_node = MEM_NUMA_NODE_ANY};
+  MemBacking huge_pages = {.mode = MEM_BACKING_HUGE_PAGES,
+                           .numa_node = MEM_NUMA_NODE_LOCAL};
+  MemBacking hugetlb = {.mode = MEM_BACKING_HUGETLB,
+                        .numa_node = MEM_NUMA_NODE_LOCAL};
+  if (BenchBacking("heap vector", NULL) ||
+      BenchBacking("MEM_BACKING_HEAP", &heap) ||
+      BenchBacking("MEM_BACKING_HUGE_PAGES", &huge_pages) ||
+      BenchBacking("MEM_BACKING_HUGETLB", &hugetlb)) {
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,143 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../types/concurrent_hm.h"
+#include "bench.h"
+#include <pthread.h>
+
+/*
+ * Throughput of a ConcurrentHm against an Hm behind one global mutex, with
+ * 1 to 8 threads. Every thread reads keys all over the map, and adds/deletes
+ * keys of its own, 1 write for every READS_PER_WRITE reads.
+ */
+#define PREFILL_COUNT (1 << 16)
+#define THREAD_OPS (1 << 20)
+#define READS_PER_WRITE (9)
+#define MAX_THREADS (8)
+
+#define KEY(i) ((void *)(uintptr_t)((i) + 1))
+
+typedef struct {
+  ConcurrentHm *chm;
+  Hm *hm;
+  pthread_mutex_t *hm_lock;
+  u64 thread_index;
+  u64 found_count;
+  // Set if any operation failed.
+  bool failed;
+} Worker;
+
+static u64 HashFunc(const void *key) {
+  u64 x = (u64)(uintptr_t)key;
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+
+  return x;
+}
+
+static bool CmpFunc(const void *key, const void *compare_key) {
+  return key == compare_key;
+}
+
+static void *RunWorker(void *arg) {
+  Worker *worker = arg;
+  // Keys past the prefilled ones, unique to the thread.
+  u64 own_key = PREFILL_COUNT + worker->thread_index * THREAD_OPS;
+  u64 rng = worker->thread_index * 0x9e3779b97f4a7c15ULL + 1;
+  u64 found = 0;
+
+  for (u64 i = 0; i < THREAD_OPS; i++) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    void *key = KEY(rng % PREFILL_COUNT);
+    bool write = (i % (READS_PER_WRITE + 1)) == READS_PER_WRITE;
+    StatusCode code = SUCCESS;
+
+    if (worker->chm) {
+      if (!write) {
+        found += !!chm_GetEntry(worker->chm, key);
+      } else if ((i / (READS_PER_WRITE + 1)) % 2) {
+        code = chm_DeleteEntry(worker->chm, KEY(own_key++));
+      } else {
+        code = chm_AddEntry(worker->chm, KEY(own_key), key, HM_ADD_FAIL);
+      }
+    } else {
+      pthread_mutex_lock(worker->hm_lock);
+      if (!write) {
+        found += !!hm_GetEntry(worker->hm, key);
+      } else if ((i / (READS_PER_WRITE + 1)) % 2) {
+        code = hm_DeleteEntry(worker->hm, KEY(own_key++));
+      } else {
+        code = hm_AddEntry(worker->hm, KEY(own_key), key, HM_ADD_FAIL);
+      }
+      pthread_mutex_unlock(worker->hm_lock);
+    }
+    if (code != SUCCESS) {
+      worker->failed = true;
+      break;
+    }
+  }
+  worker->found_count = found;
+
+  return NULL;
+}
+
+// Returns the ops per second of all the threads together, 0 on failure.
+static f64 RunThreads(ConcurrentHm *chm, Hm *hm, u64 thread_count) {
+  pthread_mutex_t hm_lock = PTHREAD_MUTEX_INITIALIZER;
+  pthread_t threads[MAX_THREADS];
+  Worker workers[MAX_THREADS];
+
+  f64 start = bench_Now();
+  for (u64 i = 0; i < thread_count; i++) {
+    workers[i] = (Worker){
+        .chm = chm, .hm = hm, .hm_lock = &hm_lock, .thread_index = i};
+    if (pthread_create(&threads[i], NULL, RunWorker, &workers[i])) {
+      return 0;
+    }
+  }
+  bool failed = false;
+  for (u64 i = 0; i < thread_count; i++) {
+    pthread_join(threads[i], NULL);
+    failed |= workers[i].failed;
+    bench_sink += workers[i].found_count;
+  }
+  f64 elapsed = bench_Now() - start;
+
+  return (failed) ? 0 : (f64)(thread_count * THREAD_OPS) / elapsed;
+}
+
+int main(void) {
+  printf("ConcurrentHm vs Hm + mutex, %d prefilled keys, %d:1 reads:writes\n",
+         PREFILL_COUNT, READS_PER_WRITE);
+  printf("%8s %14s %14s %8s\n", "threads", "chm Mops/s", "hm+lock Mops/s",
+         "speedup");
+
+  for (u64 thread_count = 1; thread_count <= MAX_THREADS; thread_count *= 2) {
+    ConcurrentHm *chm = chm_Create(HashFunc, CmpFunc, NULL, NULL);
+    Hm *hm = hm_Create(HashFunc, CmpFunc, NULL, NULL);
+    if (!chm || !hm) {
+      return 1;
+    }
+    for (u64 i = 0; i < PREFILL_COUNT; i++) {
+      if (chm_AddEntry(chm, KEY(i), KEY(i), HM_ADD_FAIL) != SUCCESS ||
+          hm_AddEntry(hm, KEY(i), KEY(i), HM_ADD_FAIL) != SUCCESS) {
+        return 1;
+      }
+    }
+
+    f64 chm_ops = RunThreads(chm, NULL, thread_count);
+    f64 hm_ops = RunThreads(NULL, hm, thread_count);
+    if (!chm_ops || !hm_ops) {
+      return 1;
+    }
+    printf("%8zu %14.2f %14.2f %7.2fx\n", thread_count, chm_ops / 1e6,
+           hm_ops / 1e6, chm_ops / hm_ops);
+
+    chm_Delete(chm);
+    hm_Delete(hm);
+  }
+
+  return 0;
+}
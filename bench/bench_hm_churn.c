@@ -0,0 +1,67 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../types/hm.h"
+#include "bench.h"
+
+/*
+ * Adds and deletes keys in a sliding window, so the map holds the same number
+ * of entries all along while every delete leaves a tombstone behind. Every
+ * round should take about as long as the first, a map that never cleans its
+ * tombstones up gets slower every round until probing never ends.
+ */
+#define LIVE_COUNT (1024)
+#define ROUND_OPS (1 << 18)
+#define ROUND_COUNT (16)
+
+// Keys are the integers themselves, offset by 1 as NULL isn't a key.
+#define KEY(i) ((void *)(uintptr_t)((i) + 1))
+
+static u64 HashFunc(const void *key) {
+  u64 x = (u64)(uintptr_t)key;
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+
+  return x;
+}
+
+static bool CmpFunc(const void *key, const void *compare_key) {
+  return key == compare_key;
+}
+
+int main(void) {
+  Hm *hm = hm_Create(HashFunc, CmpFunc, NULL, NULL);
+  if (!hm) {
+    return 1;
+  }
+  for (u64 i = 0; i < LIVE_COUNT; i++) {
+    if (hm_AddEntry(hm, KEY(i), KEY(i), HM_ADD_FAIL) != SUCCESS) {
+      return 1;
+    }
+  }
+
+  printf("Hm churn, %d live entries, %d add/delete pairs per round\n",
+         LIVE_COUNT, ROUND_OPS);
+  printf("%6s %12s %10s\n", "round", "ns/pair", "vs first");
+  u64 next = LIVE_COUNT;
+  f64 first = 0;
+  for (u64 round = 0; round < ROUND_COUNT; round++) {
+    f64 start = bench_Now();
+    for (u64 i = 0; i < ROUND_OPS; i++, next++) {
+      if (hm_AddEntry(hm, KEY(next), KEY(next), HM_ADD_FAIL) != SUCCESS ||
+          hm_DeleteEntry(hm, KEY(next - LIVE_COUNT)) != SUCCESS) {
+        return 1;
+      }
+    }
+    f64 pair_ns = (bench_Now() - start) * 1e9 / ROUND_OPS;
+    if (!round) {
+      first = pair_ns;
+    }
+    printf("%6zu %12.1f %9.2fx\n", round, pair_ns, pair_ns / first);
+  }
+  bench_sink = hm_GetLen(hm);
+
+  hm_Delete(hm);
+
+  return (bench_sink == LIVE_COUNT) ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../ecs/ecs.h"
+#include "bench.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Snapshots and restores of a world of about 2MB, against a plain memcpy of
+ * the same size, which is the floor for copying the world out. Then the
+ * deltas of a stream of it, where every tick moves 1% of the entities and
+ * replaces a few.
+ */
+#define ENTITY_COUNT (1 << 16)
+#define TICK_COUNT (256)
+#define MOVED_PER_TICK (ENTITY_COUNT / 100)
+#define REPLACED_PER_TICK (8)
+
+typedef struct {
+  f32 x, y, z;
+} Vec3;
+
+typedef struct {
+  EcsWorld *world;
+  PropId position;
+  PropId velocity;
+  Layout *moving;
+  Layout *still;
+  Entity *entities[ENTITY_COUNT];
+} BenchWorld;
+
+static Layout *CreateLayout(EcsWorld *world, PropId first, PropId second) {
+  PropsSignature *signature = ecs_WorldPropSignatureCreate(world);
+  ecs_HandlePropIdToPropSignatures(signature, first, PROP_SIGNATURE_ATTACH);
+  if (second != INVALID_PROP_ID) {
+    ecs_HandlePropIdToPropSignatures(signature, second, PROP_SIGNATURE_ATTACH);
+  }
+
+  return ecs_LayoutCreate(signature, DUPLICATE_PROPS_SIGNATURE_FREE);
+}
+
+// 3/4 of the entities move, the rest only have a position.
+static int CreateBenchWorld(BenchWorld *bench) {
+  bench->world =
+      ecs_WorldCreate(&(EcsConfig){.entity_count = ENTITY_COUNT,
+                                   .layout_entity_count = ENTITY_COUNT});
+  if (!bench->world) {
+    return 1;
+  }
+  bench->position = ecs_WorldPropIdCreate(bench->world, sizeof(Vec3));
+  bench->velocity = ecs_WorldPropIdCreate(bench->world, sizeof(Vec3));
+  Layout *moving = bench->moving =
+      CreateLayout(bench->world, bench->position, bench->velocity);
+  Layout *still = bench->still =
+      CreateLayout(bench->world, bench->position, INVALID_PROP_ID);
+  if (!moving || !still) {
+    return 1;
+  }
+
+  for (u64 i = 0; i < ENTITY_COUNT; i++) {
+    Entity *entity = ecs_CreateEntityFromLayout((i % 4) ? moving : still);
+    if (!entity) {
+      return 1;
+    }
+    *(Vec3 *)ecs_GetPropDataFromEntity(entity, bench->position) =
+        (Vec3){(f32)i, 0, 0};
+    if (i % 4) {
+      *(Vec3 *)ecs_GetPropDataFromEntity(entity, bench->velocity) =
+          (Vec3){0, 1, 0};
+    }
+    bench->entities[i] = entity;
+  }
+
+  return 0;
+}
+
+static int BenchSnapshotRestore(BenchWorld *bench) {
+  u64 size = ecs_WorldSnapshotSize(bench->world);
+  EcsSnapshotRing *ring = ecs_SnapshotRingCreate(8, size);
+  u8 *copy_src = malloc(size), *copy_dest = malloc(size);
+  if (!ring || !copy_src || !copy_dest) {
+    return 1;
+  }
+  memset(copy_src, 1, size);
+  memset(copy_dest, 0, size);
+
+  f64 start = bench_Now();
+  for (u64 tick = 0; tick < TICK_COUNT; tick++) {
+    if (ecs_WorldSnapshot(bench->world, ring, tick) != SUCCESS) {
+      return 1;
+    }
+  }
+  f64 snapshot_time = (bench_Now() - start) / TICK_COUNT;
+
+  start = bench_Now();
+  for (u64 tick = 0; tick < TICK_COUNT; tick++) {
+    copy_src[tick % size] = (u8)tick;
+    memcpy(copy_dest, copy_src, size);
+    bench_sink += copy_dest[(tick * 4099) % size];
+  }
+  f64 memcpy_time = (bench_Now() - start) / TICK_COUNT;
+
+  // The last 8 ticks are still in the ring.
+  MemStats stats = mem_StatsGet(MEM_CATEGORY_ECS);
+  start = bench_Now();
+  for (u64 tick = 0; tick < TICK_COUNT; tick++) {
+    if (ecs_WorldRestore(bench->world, ring,
+                         TICK_COUNT - 8 + tick % 8) != SUCCESS) {
+      return 1;
+    }
+  }
+  f64 restore_time = (bench_Now() - start) / TICK_COUNT;
+  u64 restore_allocs =
+      mem_StatsGet(MEM_CATEGORY_ECS).total_count - stats.total_count;
+
+  // Snapshots that come from deltas get checked on their first restore.
+  EcsSnapshotRing *stream_ring = ecs_SnapshotRingCreate(1, size);
+  u64 delta_cap = (stream_ring) ? ecs_SnapshotDeltaMaxSize(stream_ring) : 0;
+  u8 *delta = malloc(delta_cap);
+  u64 delta_size = (delta) ? ecs_SnapshotDeltaEncode(
+                                 ring, ECS_SNAPSHOT_DELTA_KEYFRAME,
+                                 TICK_COUNT - 1, delta, delta_cap)
+                           : 0;
+  if (!stream_ring || !delta_size) {
+    return 1;
+  }
+  f64 checked_restore_time = 0;
+  for (u64 tick = 0; tick < TICK_COUNT; tick++) {
+    if (ecs_SnapshotDeltaApply(stream_ring, delta, delta_size) != SUCCESS) {
+      return 1;
+    }
+    start = bench_Now();
+    if (ecs_WorldRestore(bench->world, stream_ring, TICK_COUNT - 1) !=
+        SUCCESS) {
+      return 1;
+    }
+    checked_restore_time += bench_Now() - start;
+  }
+  checked_restore_time /= TICK_COUNT;
+
+  printf("World of %d entities, snapshot of %zu bytes\n", ENTITY_COUNT, size);
+  printf("%-12s %10s %10s\n", "", "us", "vs memcpy");
+  printf("%-12s %10.1f %9.2fx\n", "memcpy", memcpy_time * 1e6, 1.0);
+  printf("%-12s %10.1f %9.2fx\n", "snapshot", snapshot_time * 1e6,
+         snapshot_time / memcpy_time);
+  printf("%-12s %10.1f %9.2fx\n", "restore", restore_time * 1e6,
+         restore_time / memcpy_time);
+  printf("%-12s %10.1f %9.2fx\n", "restore+chk", checked_restore_time * 1e6,
+         checked_restore_time / memcpy_time);
+  printf("Allocations during the restores: %zu\n", restore_allocs);
+
+  free(copy_src);
+  free(copy_dest);
+  free(delta);
+  ecs_SnapshotRingDelete(stream_ring);
+  ecs_SnapshotRingDelete(ring);
+
+  return (restore_allocs == 0) ? 0 : 1;
+}
+
+/*
+ * One tick of the stream, entities are moved and replaced at random. The
+ * replacements go in the layout of the entity they replace, so the world stays
+ * the same size.
+ */
+static int SimulateTick(BenchWorld *bench, u64 *rng) {
+  for (u64 i = 0; i < MOVED_PER_TICK + REPLACED_PER_TICK; i++) {
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 7;
+    *rng ^= *rng << 17;
+    u64 index = *rng % ENTITY_COUNT;
+    Entity **entity = &bench->entities[index];
+    if (i >= MOVED_PER_TICK) {
+      ecs_DeleteEntity(*entity);
+      *entity = ecs_CreateEntityFromLayout((index % 4) ? bench->moving
+                                                       : bench->still);
+      IF_NULL(*entity) {
+        return 1;
+      }
+    }
+    Vec3 *position = ecs_GetPropDataFromEntity(*entity, bench->position);
+    position->x += 1;
+    position->y = (f32)(*rng % 1024);
+  }
+
+  return 0;
+}
+
+static int BenchDeltas(BenchWorld *bench) {
+  // Headroom, in case the layouts grow.
+  u64 size = ecs_WorldSnapshotSize(bench->world) * 2;
+  EcsSnapshotRing *ring = ecs_SnapshotRingCreate(2, size);
+  EcsSnapshotRing *spectator_ring = ecs_SnapshotRingCreate(2, size);
+  u64 delta_cap = (ring) ? ecs_SnapshotDeltaMaxSize(ring) : 0;
+  u8 *delta = malloc(delta_cap);
+  if (!ring || !spectator_ring || !delta) {
+    return 1;
+  }
+
+  u64 rng = 0x9e3779b97f4a7c15ULL;
+  u64 keyframe_size = 0, delta_total = 0;
+  f64 encode_time = 0, apply_time = 0;
+  for (u64 tick = 0; tick <= TICK_COUNT; tick++) {
+    if ((tick && SimulateTick(bench, &rng)) ||
+        ecs_WorldSnapshot(bench->world, ring, tick) != SUCCESS) {
+      return 1;
+    }
+    u64 base_tick = (tick) ? tick - 1 : ECS_SNAPSHOT_DELTA_KEYFRAME;
+    f64 start = bench_Now();
+    u64 delta_size =
+        ecs_SnapshotDeltaEncode(ring, base_tick, tick, delta, delta_cap);
+    f64 encoded = bench_Now();
+    if (!delta_size ||
+        ecs_SnapshotDeltaApply(spectator_ring, delta, delta_size) !=
+            SUCCESS) {
+      return 1;
+    }
+    if (tick) {
+      encode_time += encoded - start;
+      apply_time += bench_Now() - encoded;
+      delta_total += delta_size;
+    } else {
+      keyframe_size = delta_size;
+    }
+  }
+
+  printf("\nStream of %d ticks, %d entities moved and %d replaced a tick\n",
+         TICK_COUNT, MOVED_PER_TICK, REPLACED_PER_TICK);
+  printf("Snapshot: %zu bytes, keyframe: %zu bytes, average delta: %zu "
+         "bytes\n",
+         ecs_WorldSnapshotSize(bench->world), keyframe_size,
+         delta_total / TICK_COUNT);
+  printf("Average delta encode: %.1fus, apply: %.1fus\n",
+         encode_time * 1e6 / TICK_COUNT, apply_time * 1e6 / TICK_COUNT);
+
+  free(delta);
+  ecs_SnapshotRingDelete(spectator_ring);
+  ecs_SnapshotRingDelete(ring);
+
+  return 0;
+}
+
+int main(void) {
+  static BenchWorld bench;
+  if (CreateBenchWorld(&bench) || BenchSnapshotRestore(&bench) ||
+      BenchDeltas(&bench)) {
+    return 1;
+  }
+  ecs_WorldDelete(bench.world);
+
+  return 0;
+}
@@ -0,0 +1,143 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../types/array.h"
+#include "../types/array_typed.h"
+#include "bench.h"
+
+/*
+ * The typed vectors against the opaque Vector. First pushing and reading back
+ * one big vector, then many short lived small ones, which is where the inline
+ * buffer of SVEC_DEFINE saves the allocations.
+ */
+#define BIG_COUNT (1 << 22)
+#define SMALL_VEC_COUNT (1 << 20)
+#define SMALL_LEN (8)
+
+VEC_DEFINE(BenchVec, u64)
+SVEC_DEFINE(BenchSmallVec, u64, SMALL_LEN)
+
+static u64 ArrayAllocCount(void) {
+  return mem_StatsGet(MEM_CATEGORY_ARRAY).total_count;
+}
+
+static int BenchBig(void) {
+  printf("%d pushes then reads of a u64\n", BIG_COUNT);
+  printf("%-24s %10s %10s\n", "", "ns/push", "ns/read");
+
+  Vector *vector = arr_VectorCreate(sizeof(u64));
+  if (!vector) {
+    return 1;
+  }
+  f64 start = bench_Now();
+  for (u64 i = 0; i < BIG_COUNT; i++) {
+    if (arr_VectorPush(vector, &i, NULL) != SUCCESS) {
+      return 1;
+    }
+  }
+  f64 push_end = bench_Now();
+  u64 sum = 0;
+  for (u64 i = 0; i < BIG_COUNT; i++) {
+    u64 val;
+    arr_VectorGet(vector, i, &val);
+    sum += val;
+  }
+  f64 read_end = bench_Now();
+  printf("%-24s %10.2f %10.2f\n", "arr_VectorCreate",
+         (push_end - start) * 1e9 / BIG_COUNT,
+         (read_end - push_end) * 1e9 / BIG_COUNT);
+  arr_VectorDelete(vector);
+
+  BenchVec vec;
+  if (BenchVec_Init(&vec, 1, NULL) != SUCCESS) {
+    return 1;
+  }
+  start = bench_Now();
+  for (u64 i = 0; i < BIG_COUNT; i++) {
+    if (BenchVec_Push(&vec, i) != SUCCESS) {
+      return 1;
+    }
+  }
+  push_end = bench_Now();
+  for (u64 i = 0; i < BIG_COUNT; i++) {
+    sum -= BenchVec_Get(&vec, i);
+  }
+  read_end = bench_Now();
+  printf("%-24s %10.2f %10.2f\n", "VEC_DEFINE",
+         (push_end - start) * 1e9 / BIG_COUNT,
+         (read_end - push_end) * 1e9 / BIG_COUNT);
+  BenchVec_Deinit(&vec);
+  bench_sink = sum;
+
+  return (sum == 0) ? 0 : 1;
+}
+
+static void PrintSmallRow(const char *name, f64 elapsed, u64 allocs) {
+  printf("%-24s %10.2f %12.2f\n", name, elapsed * 1e9 / SMALL_VEC_COUNT,
+         (f64)allocs / SMALL_VEC_COUNT);
+}
+
+static int BenchSmall(void) {
+  printf("\n%d vectors created, filled with %d u64s and deleted\n",
+         SMALL_VEC_COUNT, SMALL_LEN);
+  printf("%-24s %10s %12s\n", "", "ns/vec", "allocs/vec");
+  u64 sum = 0;
+
+  u64 allocs = ArrayAllocCount();
+  f64 start = bench_Now();
+  for (u64 n = 0; n < SMALL_VEC_COUNT; n++) {
+    Vector *vector = arr_VectorCustomCreate(sizeof(u64), SMALL_LEN);
+    if (!vector) {
+      return 1;
+    }
+    for (u64 i = 0; i < SMALL_LEN; i++) {
+      arr_VectorPush(vector, &i, NULL);
+    }
+    u64 val;
+    arr_VectorGet(vector, n % SMALL_LEN, &val);
+    sum += val;
+    arr_VectorDelete(vector);
+  }
+  PrintSmallRow("arr_VectorCustomCreate", bench_Now() - start,
+                ArrayAllocCount() - allocs);
+
+  allocs = ArrayAllocCount();
+  start = bench_Now();
+  for (u64 n = 0; n < SMALL_VEC_COUNT; n++) {
+    BenchVec vec;
+    if (BenchVec_Init(&vec, SMALL_LEN, NULL) != SUCCESS) {
+      return 1;
+    }
+    for (u64 i = 0; i < SMALL_LEN; i++) {
+      BenchVec_Push(&vec, i);
+    }
+    sum -= BenchVec_Get(&vec, n % SMALL_LEN);
+    BenchVec_Deinit(&vec);
+  }
+  PrintSmallRow("VEC_DEFINE", bench_Now() - start,
+                ArrayAllocCount() - allocs);
+
+  allocs = ArrayAllocCount();
+  start = bench_Now();
+  for (u64 n = 0; n < SMALL_VEC_COUNT; n++) {
+    BenchSmallVec vec;
+    BenchSmallVec_Init(&vec, NULL);
+    for (u64 i = 0; i < SMALL_LEN; i++) {
+      BenchSmallVec_Push(&vec, i);
+    }
+    sum += BenchSmallVec_Get(&vec, n % SMALL_LEN);
+    BenchSmallVec_Deinit(&vec);
+  }
+  PrintSmallRow("SVEC_DEFINE", bench_Now() - start,
+                ArrayAllocCount() - allocs);
+  bench_sink = sum;
+
+  return 0;
+}
+
+int main(void) {
+  if (BenchBig() || BenchSmall()) {
+    return 1;
+  }
+
+  return 0;
+}
@@ -1,20 +1,63 @@
+// For read/write on file descriptors and pthread_mutex_t, hidden by -std=c17
+// otherwise.
+#define _POSIX_C_SOURCE 200809L
+
 #include "ecs.h"
 #include "../types/array.h"
+#include "../types/array_typed.h"
+#include "../types/bitset.h"
 #include "../types/hm.h"
+#include "../types/sort.h"
 #include "../utils/mem.h"
+#include "../utils/slab.h"
+#include <errno.h>
+#include <pthread.h>
 #include <time.h>
-
-#ifdef _MSC_VER
-#include <intrin.h>
-#pragma intrinsic(_BitScanForward)
-#endif
+#include <unistd.h>
 
 #define CHUNK_ARR_CAP (8)
-#define U64_BIT_COUNT (sizeof(u64) * 8)
+/*
+ * Address space reserved for each layout's data. Only the touched part of it
+ * is ever backed by memory, so this just caps how many entities a layout holds.
+ */
+#define LAYOUT_DATA_RESERVE_SIZE ((u64)1 << 32)
+
+// EcsConfig defaults.
+#define DEFAULT_PROP_COUNT (BITSET_WORD_BITS)
+#define DEFAULT_ARENA_COUNT (24)
+#define DEFAULT_LAYOUT_ENTITY_COUNT (CHUNK_ARR_CAP)
+
+/*
+ * A fresh layout chunk frees exactly CHUNK_ARR_CAP indices, so most layouts
+ * never need a heap allocation for these.
+ */
+SVEC_DEFINE(LayoutFreeIndices, u64, CHUNK_ARR_CAP)
+VEC_DEFINE(LayoutEntityIndices, u64)
+VEC_DEFINE(WorldLayouts, Layout *)
+VEC_DEFINE(WorldEntities, Entity *)
+
+// An entity id is its index in the world's tables, and the generation of it.
+#define ENTITY_ID(index, generation) ((index) | ((u64)(generation) << 32))
+#define ENTITY_ID_INDEX(id) ((id) & 0xffffffffULL)
+#define ENTITY_ID_GENERATION(id) ((u32)((id) >> 32))
+// Indices are below it, so no id is INVALID_INDEX.
+#define ENTITY_INDEX_LIMIT (0xffffffffULL)
+#define INVALID_LAYOUT_INDEX ((u32)(-1))
+
+typedef struct {
+  // In the world's layouts, INVALID_LAYOUT_INDEX when the index is free.
+  u32 layout_index;
+  // Bumped every time the index is freed, so stale ids don't match.
+  u32 generation;
+  u64 slot;
+} EntityLocation;
+
+VEC_DEFINE(EntityLocations, EntityLocation)
 
 struct __PropsSignature {
   // Its an array of u64, where each u64 holds 64 props as for of bitset.
   BuffArr *id_bitset;
+  EcsWorld *world;
 };
 
 struct __Layout {
@@ -23,26 +66,49 @@ struct __Layout {
    * entities of the defined props the layout belongs to. This allows for super
    * local data with one continuous buffer for all data.
    */
-  // Chose Vector as it auto grows.😁
+  /*
+   * Chose Vector as it auto grows.😁 Where possible it is a virtual vector, so
+   * growing never moves the data and prop pointers handed out stay valid.
+   */
   Vector *data;
-  Vector *data_free_indices; // array of u64
+  LayoutFreeIndices data_free_indices;
+  /*
+   * The index of the entity in each slot of data, INVALID_INDEX for free
+   * slots. Lets the layout move entities around and fix up their locations,
+   * see ecs_LayoutSortBy.
+   */
+  LayoutEntityIndices entity_indices;
   PropsSignature *layout_signature;
   u64 props_combined_size;
+  EcsWorld *world;
+  // Position in the world's layouts, what entity locations refer to it by.
+  u64 index;
+  // The SnapshotLayout it takes in the restore going on, see ecs_WorldRestore.
+  u64 snapshot_record;
 };
 
+/*
+ * The handle of an index, shared by every entity that gets the index. The
+ * entity itself is found through the world's entity_locations, so handles
+ * never have to be touched when entities move or get restored.
+ */
 struct __Entity {
-  Layout *layout;
+  EcsWorld *world;
   u64 index;
 };
 
 typedef struct {
-  Vector *size;
+  U64Vec size;
 } PropsMetadata;
 
-typedef struct {
+struct __EcsWorld {
+  // From ecs_slab, all the ecs containers allocate from this.
+  Allocator allocator;
   PoolArena *layout_arena;
   PoolArena *entity_arena;
   PoolArena *props_signature_arena;
+  // Slots every new layout is presized for, a multiple of CHUNK_ARR_CAP.
+  u64 layout_slot_count;
   // Seed used to hash the prop signature for ecs hashmap.
   time_t signature_hash_seed;
   /*
@@ -51,34 +117,54 @@ typedef struct {
    * performant entity creation.
    */
   Hm *ecs;
+  // Every layout of the world, in no particular order.
+  WorldLayouts layouts;
+  /*
+   * Where the entity of every index lives. Holds no pointers, so snapshots
+   * copy it as is, along with the free indices.
+   */
+  EntityLocations entity_locations;
+  /*
+   * Indices deleted entities left free, reused last in first out. Its cap is
+   * kept at least that of entity_locations, so deletes never allocate.
+   */
+  U64Vec free_entity_indices;
+  // The handle of every index, at least as many as entity_locations.
+  WorldEntities entities;
+  // Cleared bits for checking snapshots with, only grows.
+  U64Vec snapshot_check_bitset;
   /*
    * Defines the metadata for each component, mapping the props enum to its
    * frequently used props. This is to reduce the time that it may take
    * determining metadata from props.
    */
   PropsMetadata props_metadata_table;
-} EcsState;
+};
 
-static EcsState *ecs_state = NULL;
+// The world behind the functions that don't take one, see ecs_Init.
+static EcsWorld *default_world = NULL;
+/*
+ * Every world's containers allocate from this one slab, created along with the
+ * first world and deleted with the last one, when leaks get reported.
+ */
+static SlabArena *ecs_slab = NULL;
+static u64 world_count = 0;
+static pthread_mutex_t ecs_slab_lock = PTHREAD_MUTEX_INITIALIZER;
 #define ECS_STATE_MISSING_LOG                                                  \
   ("Modsys functions called without initializing modsys.")
 #define CHECK_VALID_ECS_STATE(ret_val)                                         \
-  NULL_EXCEPTION_ROUTINE(ecs_state, ret_val, ECS_STATE_MISSING_LOG)
-
-/* ----  UTILITY FUNCTIONS   ---- */
-
-static u64 PropBitsetToPropId(u64 prop_bitset, u64 prop_signature_index);
-static u64 PropIdToPropBitset(PropId id, u64 *pSignature_index);
+  NULL_EXCEPTION_ROUTINE(default_world, ret_val, ECS_STATE_MISSING_LOG)
 
 /* ----  PROPS METADATA RELATED FUNCTIONS  ---- */
 
-static StatusCode PropsMetadataCreate(void);
-static StatusCode PropsMetadataDelete(void);
-static StatusCode PopulateBuiltinPropsMetadata(void);
+static StatusCode PropsMetadataCreate(EcsWorld *world, u64 prop_count);
+static StatusCode PropsMetadataDelete(EcsWorld *world);
+static StatusCode PopulateBuiltinPropsMetadata(EcsWorld *world);
 
 /* ----  PROP RELATED FUNCTIONS  ---- */
 
 static inline u64 mix64(u64 x);
+static u64 GetSignatureWordCount(const PropsSignature *signature);
 static u64 PropsSignatureHashFunc(const void *signature);
 static bool PropsSignatureCmpFunc(const void *signature,
                                   const void *the_other_one);
@@ -89,12 +175,16 @@ static StatusCode PropSignatureDeleteCallback(void *signature);
 static u64 LayoutDataGrowCallback(u64 size);
 static StatusCode AddLayoutMem(Layout *layout);
 static StatusCode LayoutDeleteCallback(void *layout);
+static u64 GetLayoutPropArrOffset(const Layout *layout, PropId id);
+static inline u64 GetLayoutSlotPropOffset(const Layout *layout,
+                                          u64 prop_arr_offset, u64 prop_size,
+                                          u64 slot);
 
 /* ----  ENTITY RELATED FUNCTIONS  ---- */
 
-#define ENTITY_USE_AFTER_FREE_ROUTINE(entity, ret_val)                         \
+#define ENTITY_USE_AFTER_FREE_ROUTINE(location, ret_val)                       \
   do {                                                                         \
-    if (!entity->layout || entity->index == INVALID_INDEX) {                   \
+    if (!(location)) {                                                         \
       STATUS_LOG(                                                              \
           USE_AFTER_FREE,                                                      \
           "Cannot operate on an entity that has already been deleted.");       \
@@ -102,63 +192,31 @@ static StatusCode LayoutDeleteCallback(void *layout);
     }                                                                          \
   } while (0)
 
-static u64 GetEntityPropArrOffset(Entity *entity, PropId id);
-
-/* ----  UTILITY FUNCTIONS   ---- */
-
-static u64 PropBitsetToPropId(u64 prop_bitset, u64 prop_signature_index) {
-  if (prop_bitset == 0) {
-    return INVALID_INDEX; // Undefined for zero
-  }
-
-  u64 bit_position = INVALID_INDEX;
-
-#if defined(__GNUC__) || defined(__clang__)
-  bit_position = __builtin_ctzll(prop_bitset);
-
-#elif defined(_MSC_VER)
-  unsigned long index;
-  _BitScanForward64(&index, prop);
-  table_index = (u64)index;
-
-#else
-  // Portable fallback
-  u64 n = 0;
-  while ((prop & 1) == 0) {
-    prop >>= 1;
-    n++;
-  }
-  table_index = n;
-#endif
-
-  return bit_position + (prop_signature_index * U64_BIT_COUNT);
-}
-
-static u64 PropIdToPropBitset(PropId id, u64 *pSignature_index) {
-  *pSignature_index = id / U64_BIT_COUNT;
+static inline EntityLocation *GetEntityLocation(const Entity *entity);
+static Entity *GetEntityHandle(EcsWorld *world, u64 index);
 
-  return (1 << id % U64_BIT_COUNT);
-}
 
 /* ----  PROPS METADATA RELATED FUNCTIONS  ---- */
 
-static StatusCode PropsMetadataCreate(void) {
-  ecs_state->props_metadata_table.size = arr_VectorCreate(sizeof(u64));
-  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(ecs_state->props_metadata_table.size,
-                                       CREATION_FAILURE);
+static StatusCode PropsMetadataCreate(EcsWorld *world, u64 prop_count) {
+  IF_FUNC_FAILED(U64Vec_Init(&world->props_metadata_table.size, prop_count,
+                             &world->allocator)) {
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(world->props_metadata_table.size,
+                                  CREATION_FAILURE);
+  }
 
   return SUCCESS;
 }
 
-static StatusCode PropsMetadataDelete(void) {
-  if (ecs_state->props_metadata_table.size) {
-    arr_VectorDelete(ecs_state->props_metadata_table.size);
-  }
+static StatusCode PropsMetadataDelete(EcsWorld *world) {
+  // Safe even if never initialized, as the world is calloced.
+  U64Vec_Deinit(&world->props_metadata_table.size);
 
   return SUCCESS;
 }
 
-static StatusCode PopulateBuiltinPropsMetadata(void) {
+static StatusCode PopulateBuiltinPropsMetadata(EcsWorld *world) {
+  (void)world;
   /*
    * TODO:
    * builtin_props_metadata.size[PROP1] = sizeof(Prop1)
@@ -173,9 +231,15 @@ static StatusCode PopulateBuiltinPropsMetadata(void) {
 PropId ecs_PropIdCreate(u64 prop_struct_size) {
   CHECK_VALID_ECS_STATE(INVALID_PROP_ID);
 
-  PropId id = arr_VectorLen(ecs_state->props_metadata_table.size);
-  IF_FUNC_FAILED(arr_VectorPush(ecs_state->props_metadata_table.size,
-                                &prop_struct_size, NULL)) {
+  return ecs_WorldPropIdCreate(default_world, prop_struct_size);
+}
+
+PropId ecs_WorldPropIdCreate(EcsWorld *world, u64 prop_struct_size) {
+  NULL_FUNC_ARG_ROUTINE(world, INVALID_PROP_ID);
+
+  PropId id = U64Vec_Len(&world->props_metadata_table.size);
+  IF_FUNC_FAILED(
+      U64Vec_Push(&world->props_metadata_table.size, prop_struct_size)) {
     STATUS_LOG(FAILURE, "Unable to create new PropId. Internal failure.");
     return INVALID_PROP_ID;
   }
@@ -186,9 +250,16 @@ PropId ecs_PropIdCreate(u64 prop_struct_size) {
 PropsSignature *ecs_PropSignatureCreate(void) {
   CHECK_VALID_ECS_STATE(NULL);
 
-  PropsSignature *signature =
-      mem_PoolArenaAlloc(ecs_state->props_signature_arena);
+  return ecs_WorldPropSignatureCreate(default_world);
+}
+
+PropsSignature *ecs_WorldPropSignatureCreate(EcsWorld *world) {
+  NULL_FUNC_ARG_ROUTINE(world, NULL);
+
+  PropsSignature *signature = mem_PoolArenaAlloc(world->props_signature_arena);
   MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(signature, NULL);
+  signature->id_bitset = NULL;
+  signature->world = world;
   /*
    * The signature preallocates for all the props that exists. This shall not be
    * a problem as the load is 8 bytes per 64 props, so its super lean.
@@ -197,13 +268,13 @@ PropsSignature *ecs_PropSignatureCreate(void) {
    * allocated sizes if they were created at different times, but thats also
    * okay and not undefined state.
    */
-  u64 props_count = arr_VectorLen(ecs_state->props_metadata_table.size);
-  // Taking the ceil.
-  u64 cap = (props_count + U64_BIT_COUNT - 1) / U64_BIT_COUNT;
+  u64 props_count = U64Vec_Len(&world->props_metadata_table.size);
+  u64 cap = BITSET_WORD_COUNT(props_count);
 
-  signature->id_bitset = arr_BuffArrCreate(sizeof(u64), cap);
+  signature->id_bitset =
+      arr_BuffArrCreateWAllocator(sizeof(u64), cap, &world->allocator);
   IF_NULL(signature->id_bitset) {
-    ecs_PropsSignatureDelete(signature);
+    PropSignatureDeleteCallback(signature);
     MEM_ALLOC_FAILURE_SUB_ROUTINE(signature->id_bitset, NULL);
   }
 
@@ -211,10 +282,9 @@ PropsSignature *ecs_PropSignatureCreate(void) {
 }
 
 StatusCode ecs_PropsSignatureDelete(PropsSignature *signature) {
-  CHECK_VALID_ECS_STATE(NULL_EXCEPTION);
   NULL_FUNC_ARG_ROUTINE(signature, NULL_EXCEPTION);
 
-  Layout *layout = hm_GetEntry(ecs_state->ecs, signature);
+  Layout *layout = hm_GetEntry(signature->world->ecs, signature);
   if (layout && layout->layout_signature == signature) {
     /*
      * Since this is a user callable function that is not called by internals
@@ -239,7 +309,6 @@ StatusCode ecs_PropsSignatureDelete(PropsSignature *signature) {
 StatusCode ecs_HandlePropIdToPropSignatures(PropsSignature *signature,
                                             PropId id,
                                             PropsSignatureHandleMode mode) {
-  CHECK_VALID_ECS_STATE(NULL_EXCEPTION);
   NULL_FUNC_ARG_ROUTINE(signature, NULL_EXCEPTION);
   if (id == INVALID_PROP_ID) {
     STATUS_LOG(FAILURE, "Invalid prop id provided.");
@@ -251,16 +320,12 @@ StatusCode ecs_HandlePropIdToPropSignatures(PropsSignature *signature,
   }
   char *log_str = (mode == PROP_SIGNATURE_DETACH) ? "detach" : "attach";
 
-  u64 props_count = arr_VectorLen(ecs_state->props_metadata_table.size);
+  u64 props_count = U64Vec_Len(&signature->world->props_metadata_table.size);
   if (id >= props_count) {
     STATUS_LOG(FAILURE, "Invalid PropId: %zu provided to %s.", id, log_str);
     return FAILURE;
   }
-  /*
-   * required_signature_cap - 1 also doubles as the index of the int where to
-   * write/unwrite the PropId bit.
-   */
-  u64 required_signature_cap = (id + U64_BIT_COUNT) / U64_BIT_COUNT;
+  u64 required_signature_cap = BITSET_WORD_COUNT(id + 1);
   u64 curr_signature_cap = arr_BuffArrCap(signature->id_bitset);
   if (required_signature_cap > curr_signature_cap) {
     if (mode == PROP_SIGNATURE_DETACH) {
@@ -276,27 +341,21 @@ StatusCode ecs_HandlePropIdToPropSignatures(PropsSignature *signature,
       }
     }
   }
-  /*
-   * Using raw data here as at this point we are sure required_signature_cap - 1
-   * is a valid index in the array. and using the getters and setter will just
-   * bloat the function.
-   */
+  // At this point the bitset is sure to have the word id lives in.
   u64 *bitset_raw = arr_BuffArrRaw(signature->id_bitset);
   NULL_EXCEPTION_ROUTINE(bitset_raw, NULL_EXCEPTION,
                          "Cannot access signature internals to %s prop id.",
                          log_str);
   if (mode == PROP_SIGNATURE_DETACH) {
-    CLEAR_FLAG(bitset_raw[required_signature_cap - 1],
-               1UL << (id % U64_BIT_COUNT));
+    bitset_Clear(bitset_raw, id);
   } else {
-    bitset_raw[required_signature_cap - 1] |= 1UL << (id % U64_BIT_COUNT);
+    bitset_Set(bitset_raw, id);
   }
 
   return SUCCESS;
 }
 
 StatusCode ecs_PropSignatureClear(PropsSignature *signature) {
-  CHECK_VALID_ECS_STATE(NULL_EXCEPTION);
   NULL_FUNC_ARG_ROUTINE(signature, NULL_EXCEPTION);
 
   arr_BuffArrReset(signature->id_bitset);
@@ -315,19 +374,33 @@ static inline u64 mix64(u64 x) {
   return x;
 }
 
+/*
+ * Words past the last set bit are left out, so signatures of the same props
+ * match no matter how many props were registered when each was created.
+ */
+static u64 GetSignatureWordCount(const PropsSignature *signature) {
+  const u64 *words = arr_BuffArrRaw(signature->id_bitset);
+  u64 word_count = arr_BuffArrCap(signature->id_bitset);
+  while (word_count && !words[word_count - 1]) {
+    word_count--;
+  }
+
+  return word_count;
+}
+
 static u64 PropsSignatureHashFunc(const void *signature) {
   const PropsSignature *sign = signature;
 
   const u64 *data = arr_BuffArrRaw(sign->id_bitset);
-  size_t cap = arr_BuffArrCap(sign->id_bitset);
-  u64 hash = ecs_state->signature_hash_seed;
+  size_t word_count = GetSignatureWordCount(sign);
+  u64 hash = sign->world->signature_hash_seed;
 
-  for (size_t i = 0; i < cap; i++) {
+  for (size_t i = 0; i < word_count; i++) {
     u64 k = mix64(data[i]); // pre-mix each element
     hash ^=
         k + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2); // Jenkins mix
   }
-  hash ^= cap; // cap affects result
+  hash ^= word_count; // word count affects result
 
   return mix64(hash); // final avalanche
 }
@@ -335,8 +408,11 @@ static u64 PropsSignatureHashFunc(const void *signature) {
 static bool PropsSignatureCmpFunc(const void *signature,
                                   const void *the_other_one) {
   const PropsSignature *sign1 = signature, *sign2 = the_other_one;
+  u64 word_count = GetSignatureWordCount(sign1);
 
-  return arr_BuffArrCmp(sign1->id_bitset, sign2->id_bitset);
+  return word_count == GetSignatureWordCount(sign2) &&
+         !memcmp(arr_BuffArrRaw(sign1->id_bitset),
+                 arr_BuffArrRaw(sign2->id_bitset), word_count * sizeof(u64));
 }
 
 static StatusCode PropSignatureDeleteCallback(void *signature) {
@@ -345,7 +421,7 @@ static StatusCode PropSignatureDeleteCallback(void *signature) {
   if (sign->id_bitset) {
     arr_BuffArrDelete(sign->id_bitset);
   }
-  mem_PoolArenaFree(ecs_state->props_signature_arena, sign);
+  mem_PoolArenaFree(sign->world->props_signature_arena, sign);
 
   return SUCCESS;
 }
@@ -365,7 +441,12 @@ static StatusCode AddLayoutMem(Layout *layout) {
   }
 
   for (u64 i = new_index; i < new_index + CHUNK_ARR_CAP; i++) {
-    IF_FUNC_FAILED(arr_VectorPush(layout->data_free_indices, &i, NULL)) {
+    IF_FUNC_FAILED(
+        LayoutEntityIndices_Push(&layout->entity_indices, INVALID_INDEX)) {
+      STATUS_LOG(FAILURE, "Failed to track the new slots of the layout.");
+      return FAILURE;
+    }
+    IF_FUNC_FAILED(LayoutFreeIndices_Push(&layout->data_free_indices, i)) {
       STATUS_LOG(FAILURE, "Failed to enter free spots in the layout. Previous "
                           "data still persists.");
       return FAILURE;
@@ -377,7 +458,12 @@ static StatusCode AddLayoutMem(Layout *layout) {
 
 Layout *ecs_LayoutCreate(PropsSignature *signature,
                          DuplicatePropsSignatureHandleMode mode) {
-  CHECK_VALID_ECS_STATE(NULL);
+  return ecs_LayoutCreateWBacking(signature, mode, MEM_BACKING_DEFAULT);
+}
+
+Layout *ecs_LayoutCreateWBacking(PropsSignature *signature,
+                                 DuplicatePropsSignatureHandleMode mode,
+                                 MemBacking backing) {
   NULL_FUNC_ARG_ROUTINE(signature, NULL);
   if (mode != DUPLICATE_PROPS_SIGNATURE_FREE &&
       mode != DUPLICATE_PROPS_SIGNATURE_KEEP) {
@@ -400,8 +486,9 @@ Layout *ecs_LayoutCreate(PropsSignature *signature,
     }
   }
 
+  EcsWorld *world = signature->world;
   Layout *layout = NULL;
-  if ((layout = hm_GetEntry(ecs_state->ecs, signature)) != NULL) {
+  if ((layout = hm_GetEntry(world->ecs, signature)) != NULL) {
     if (mode == DUPLICATE_PROPS_SIGNATURE_FREE) {
       if (layout->layout_signature != signature) {
         /*
@@ -420,27 +507,17 @@ Layout *ecs_LayoutCreate(PropsSignature *signature,
 
   // Size of one of each attached components.
   u64 props_combined_size = 0;
-  u64 *size_raw = arr_VectorRaw(ecs_state->props_metadata_table.size);
-  for (u64 i = 0; i < prop_signature_cap; i++) {
-    u64 bitset_int = prop_signature_raw[i];
-
-    // This lets us decompose prop bitflags into individual props.
-    while (bitset_int) {
-      // Extract the lowest most set bit.
-      u64 prop_bitset = bitset_int & -bitset_int;
-
-      u64 index = PropBitsetToPropId(prop_bitset, i);
-      // Since bitset_int != 0, this will be a valid index.
-      props_combined_size += size_raw[index];
-
-      // Clearing the lowest set bit from the props;
-      bitset_int ^= prop_bitset;
-    }
+  u64 *size_raw = world->props_metadata_table.size.mem;
+  BitsetIter iter = bitset_IterCreate(prop_signature_raw, prop_signature_cap);
+  for (PropId id; (id = bitset_IterNext(&iter)) != INVALID_INDEX;) {
+    props_combined_size += size_raw[id];
   }
 
-  layout = mem_PoolArenaCalloc(ecs_state->layout_arena);
+  layout = mem_PoolArenaCalloc(world->layout_arena);
   MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(layout, NULL);
+  layout->world = world;
   layout->props_combined_size = props_combined_size;
+  layout->snapshot_record = INVALID_INDEX;
   /*
    * We create the array with props_struct_size * CHUNK_ARR_CAP, but each
    * entry in itself be multiple arrays of capacity CHUNK_ARR_CAP.
@@ -451,17 +528,40 @@ Layout *ecs_LayoutCreate(PropsSignature *signature,
    * The props_struct_size * CHUNK_ARR_CAP is just a size calculation and
    * doesn't reflect internal memory structure.
    */
-  layout->data = arr_VectorCustomCreate(props_combined_size * CHUNK_ARR_CAP, 1);
+  u64 chunk_size = props_combined_size * CHUNK_ARR_CAP;
+  layout->data = arr_VectorVirtualCreateWBacking(
+      chunk_size, MAX(LAYOUT_DATA_RESERVE_SIZE / MAX(chunk_size, 1), 1),
+      backing, MEM_CATEGORY_ECS);
   IF_NULL(layout->data) {
+    // Falls back to a realloc'd vector where address space can't be reserved.
+    layout->data =
+        arr_VectorCreateWAllocator(chunk_size, 1, &world->allocator);
+  }
+  IF_NULL(layout->data) {
+    LayoutDeleteCallback(layout);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(layout->data, NULL);
+  }
+  u64 slot_count = world->layout_slot_count;
+  IF_FUNC_FAILED(
+      arr_VectorReserve(layout->data, slot_count / CHUNK_ARR_CAP)) {
     LayoutDeleteCallback(layout);
     MEM_ALLOC_FAILURE_SUB_ROUTINE(layout->data, NULL);
   }
-  layout->data_free_indices =
-      arr_VectorCustomCreate(sizeof(u64), CHUNK_ARR_CAP);
-  IF_NULL(layout->data_free_indices) {
+  IF_FUNC_FAILED(LayoutFreeIndices_Init(&layout->data_free_indices,
+                                        &world->allocator)) {
     LayoutDeleteCallback(layout);
     MEM_ALLOC_FAILURE_SUB_ROUTINE(layout->data_free_indices, NULL);
   }
+  IF_FUNC_FAILED(
+      LayoutFreeIndices_Reserve(&layout->data_free_indices, slot_count)) {
+    LayoutDeleteCallback(layout);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(layout->data_free_indices, NULL);
+  }
+  IF_FUNC_FAILED(LayoutEntityIndices_Init(&layout->entity_indices, slot_count,
+                                          &world->allocator)) {
+    LayoutDeleteCallback(layout);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(layout->entity_indices, NULL);
+  }
   IF_FUNC_FAILED(AddLayoutMem(layout)) {
     LayoutDeleteCallback(layout);
     STATUS_LOG(CREATION_FAILURE, "Cannot create initial memory for layout.");
@@ -469,49 +569,217 @@ Layout *ecs_LayoutCreate(PropsSignature *signature,
   }
   layout->layout_signature = signature;
 
-  IF_FUNC_FAILED(hm_AddEntry(ecs_state->ecs, layout->layout_signature, layout,
+  IF_FUNC_FAILED(hm_AddEntry(world->ecs, layout->layout_signature, layout,
                              HM_ADD_FAIL)) {
     LayoutDeleteCallback(layout);
     STATUS_LOG(FAILURE, "Cannot add layout to ecs.");
     return NULL;
   }
+  layout->index = WorldLayouts_Len(&world->layouts);
+  IF_FUNC_FAILED(WorldLayouts_Push(&world->layouts, layout)) {
+    hm_DeleteEntry(world->ecs, layout->layout_signature);
+    STATUS_LOG(FAILURE, "Cannot add layout to the world's layouts.");
+    return NULL;
+  }
 
   return layout;
 }
 
 static StatusCode LayoutDeleteCallback(void *layout) {
   Layout *to_delete = layout;
+  EcsWorld *world = to_delete->world;
+
+  // Not listed if its creation failed, or the world is being deleted.
+  if (to_delete->index < WorldLayouts_Len(&world->layouts) &&
+      world->layouts.mem[to_delete->index] == to_delete) {
+    // Its entities go along with it.
+    LayoutEntityIndices *indices = &to_delete->entity_indices;
+    for (u64 slot = 0; slot < LayoutEntityIndices_Len(indices); slot++) {
+      if (indices->mem[slot] != INVALID_INDEX) {
+        EntityLocation *location =
+            &world->entity_locations.mem[indices->mem[slot]];
+        location->layout_index = INVALID_LAYOUT_INDEX;
+        location->generation++;
+        // Can't fail, there is room for every index.
+        U64Vec_Push(&world->free_entity_indices, indices->mem[slot]);
+      }
+    }
+
+    Layout *moved = WorldLayouts_Pop(&world->layouts);
+    if (moved != to_delete) {
+      moved->index = to_delete->index;
+      world->layouts.mem[moved->index] = moved;
+      indices = &moved->entity_indices;
+      for (u64 slot = 0; slot < LayoutEntityIndices_Len(indices); slot++) {
+        if (indices->mem[slot] != INVALID_INDEX) {
+          world->entity_locations.mem[indices->mem[slot]].layout_index =
+              (u32)moved->index;
+        }
+      }
+    }
+  }
   if (to_delete->data) {
     arr_VectorDelete(to_delete->data);
   }
-  if (to_delete->data_free_indices) {
-    arr_VectorDelete(to_delete->data_free_indices);
-  }
+  LayoutFreeIndices_Deinit(&to_delete->data_free_indices);
+  LayoutEntityIndices_Deinit(&to_delete->entity_indices);
   /*
    * We don't free to_delete->layout_signature, as the ecs hashmap handles it
    * in the key delete callback. This is true as the PropsSignature is also
    * stored separately in the hashmap, and we let it free the signature rather
    * than we free it along side value.
    */
-  mem_PoolArenaFree(ecs_state->layout_arena, to_delete);
+  mem_PoolArenaFreeUnchecked(to_delete->world->layout_arena, to_delete);
 
   return SUCCESS;
 }
 
 StatusCode ecs_LayoutDelete(Layout *layout) {
-  CHECK_VALID_ECS_STATE(NULL_EXCEPTION);
   NULL_FUNC_ARG_ROUTINE(layout, NULL_EXCEPTION);
 
-  return hm_DeleteEntry(ecs_state->ecs, layout->layout_signature);
+  return hm_DeleteEntry(layout->world->ecs, layout->layout_signature);
+}
+
+StatusCode ecs_LayoutSortBy(Layout *layout, PropId id,
+                            u64 (*key_func)(const void *prop_data)) {
+  NULL_FUNC_ARG_ROUTINE(layout, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(key_func, NULL_EXCEPTION);
+  EcsWorld *world = layout->world;
+  if (id >= U64Vec_Len(&world->props_metadata_table.size)) {
+    STATUS_LOG(FAILURE, "Invalid prop id provided.");
+    return FAILURE;
+  }
+
+  u64 key_prop_offset = GetLayoutPropArrOffset(layout, id);
+  if (key_prop_offset == INVALID_OFFSET) {
+    STATUS_LOG(FAILURE, "Cannot sort layout by a prop it doesn't have.");
+    return FAILURE;
+  }
+
+  u64 *size_raw = world->props_metadata_table.size.mem;
+  u64 slot_count = LayoutEntityIndices_Len(&layout->entity_indices);
+  u64 chunk_count = arr_VectorLen(layout->data);
+  u64 chunk_size = layout->props_combined_size * CHUNK_ARR_CAP;
+  u8 *data = arr_VectorRaw(layout->data);
+  u64 *entity_indices = layout->entity_indices.mem;
+
+  StatusCode code = SUCCESS;
+  Allocator *allocator = &world->allocator;
+  u64 *keys = mem_Alloc(allocator, sizeof(u64) * slot_count);
+  u64 *slots = mem_Alloc(allocator, sizeof(u64) * slot_count);
+  u64 *sorted_indices = mem_Alloc(allocator, sizeof(u64) * slot_count);
+  // Freed slots end up zeroed, same as fresh ones.
+  u8 *sorted_data = mem_Calloc(allocator, chunk_count * chunk_size);
+  if (!keys || !slots || !sorted_indices || (!sorted_data && chunk_size)) {
+    STATUS_LOG(CREATION_FAILURE, "Cannot allocate scratch memory for sort.");
+    code = CREATION_FAILURE;
+    goto cleanup;
+  }
+
+  u64 entity_count = 0;
+  for (u64 slot = 0; slot < slot_count; slot++) {
+    if (entity_indices[slot] == INVALID_INDEX) {
+      continue;
+    }
+    keys[entity_count] = key_func(
+        data + GetLayoutSlotPropOffset(layout, key_prop_offset, size_raw[id],
+                                       slot));
+    slots[entity_count++] = slot;
+  }
+  IF_FUNC_FAILED(sort_RadixU64Parallel(keys, slots, sizeof(u64), entity_count,
+                                       1, allocator)) {
+    STATUS_LOG(FAILURE, "Cannot sort the layout's entities.");
+    code = FAILURE;
+    goto cleanup;
+  }
+
+  /*
+   * The entities get packed to the front in key order, one prop array at a
+   * time so the writes stay sequential.
+   */
+  const u64 *signature_raw =
+      arr_BuffArrRaw(layout->layout_signature->id_bitset);
+  u64 signature_cap = arr_BuffArrCap(layout->layout_signature->id_bitset);
+  u64 prop_arr_offset = 0;
+  BitsetIter iter = bitset_IterCreate(signature_raw, signature_cap);
+  for (PropId prop; (prop = bitset_IterNext(&iter)) != INVALID_INDEX;) {
+    u64 prop_size = size_raw[prop];
+    for (u64 i = 0; i < entity_count; i++) {
+      memcpy(sorted_data + GetLayoutSlotPropOffset(layout, prop_arr_offset,
+                                                   prop_size, i),
+             data + GetLayoutSlotPropOffset(layout, prop_arr_offset,
+                                            prop_size, slots[i]),
+             prop_size);
+    }
+    prop_arr_offset += prop_size * CHUNK_ARR_CAP;
+  }
+  if (sorted_data) {
+    memcpy(data, sorted_data, chunk_count * chunk_size);
+  }
+
+  for (u64 i = 0; i < entity_count; i++) {
+    sorted_indices[i] = entity_indices[slots[i]];
+  }
+  for (u64 slot = 0; slot < slot_count; slot++) {
+    entity_indices[slot] =
+        (slot < entity_count) ? sorted_indices[slot] : INVALID_INDEX;
+    if (entity_indices[slot] != INVALID_INDEX) {
+      world->entity_locations.mem[entity_indices[slot]].slot = slot;
+    }
+  }
+
+  /*
+   * Every slot past the entities is free now. Pushed from the back, so new
+   * entities fill the lowest slots first and the layout stays packed. It holds
+   * as many free slots as before, so this never has to grow.
+   */
+  LayoutFreeIndices_Clear(&layout->data_free_indices);
+  for (u64 slot = slot_count; slot > entity_count; slot--) {
+    LayoutFreeIndices_Push(&layout->data_free_indices, slot - 1);
+  }
+
+cleanup:
+  mem_Free(allocator, keys, sizeof(u64) * slot_count);
+  mem_Free(allocator, slots, sizeof(u64) * slot_count);
+  mem_Free(allocator, sorted_indices, sizeof(u64) * slot_count);
+  mem_Free(allocator, sorted_data, chunk_count * chunk_size);
+
+  return code;
 }
 
 /* ----  ENTITY RELATED FUNCTIONS  ---- */
 
+// NULL if no entity lives at the handle's index.
+static inline EntityLocation *GetEntityLocation(const Entity *entity) {
+  EntityLocations *locations = &entity->world->entity_locations;
+  if (entity->index >= EntityLocations_Len(locations) ||
+      locations->mem[entity->index].layout_index == INVALID_LAYOUT_INDEX) {
+    return NULL;
+  }
+
+  return &locations->mem[entity->index];
+}
+
+// Creates the handles up to index, the ones that exist are kept for good.
+static Entity *GetEntityHandle(EcsWorld *world, u64 index) {
+  while (WorldEntities_Len(&world->entities) <= index) {
+    Entity *entity = mem_PoolArenaAlloc(world->entity_arena);
+    MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(entity, NULL);
+    *entity =
+        (Entity){.world = world, .index = WorldEntities_Len(&world->entities)};
+    IF_FUNC_FAILED(WorldEntities_Push(&world->entities, entity)) {
+      mem_PoolArenaFreeUnchecked(world->entity_arena, entity);
+      MEM_ALLOC_FAILURE_SUB_ROUTINE(world->entities, NULL);
+    }
+  }
+
+  return world->entities.mem[index];
+}
+
 Entity *ecs_CreateEntityFromLayout(Layout *layout) {
-  CHECK_VALID_ECS_STATE(NULL);
   NULL_FUNC_ARG_ROUTINE(layout, NULL);
 
-  if (arr_VectorLen(layout->data_free_indices) == 0) {
+  if (LayoutFreeIndices_Len(&layout->data_free_indices) == 0) {
     IF_FUNC_FAILED(AddLayoutMem(layout)) {
       STATUS_LOG(CREATION_FAILURE,
                  "Failed to find valid spot to create entity in.");
@@ -519,14 +787,41 @@ Entity *ecs_CreateEntityFromLayout(Layout *layout) {
     }
   }
 
-  Entity *entity = mem_PoolArenaAlloc(ecs_state->entity_arena);
-  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(entity, NULL);
-
-  entity->layout = layout;
+  EcsWorld *world = layout->world;
+  u64 index = 0;
+  if (U64Vec_Len(&world->free_entity_indices)) {
+    index = U64Vec_Pop(&world->free_entity_indices);
+  } else {
+    index = EntityLocations_Len(&world->entity_locations);
+    if (index >= ENTITY_INDEX_LIMIT) {
+      STATUS_LOG(FAILURE, "The world can't hold any more entities.");
+      return NULL;
+    }
+    IF_FUNC_FAILED(EntityLocations_Push(
+        &world->entity_locations,
+        (EntityLocation){.layout_index = INVALID_LAYOUT_INDEX})) {
+      MEM_ALLOC_FAILURE_SUB_ROUTINE(world->entity_locations, NULL);
+    }
+    IF_FUNC_FAILED(U64Vec_Reserve(&world->free_entity_indices,
+                                  world->entity_locations.cap)) {
+      EntityLocations_Pop(&world->entity_locations);
+      MEM_ALLOC_FAILURE_SUB_ROUTINE(world->free_entity_indices, NULL);
+    }
+  }
 
-  arr_VectorPop(layout->data_free_indices, &entity->index);
+  Entity *entity = GetEntityHandle(world, index);
+  IF_NULL(entity) {
+    // Can't fail, there is room for every index.
+    U64Vec_Push(&world->free_entity_indices, index);
+    STATUS_LOG(CREATION_FAILURE, "Failed to create the entity's handle.");
+    return NULL;
+  }
 
-  printf("Index: %zu, ", entity->index);
+  u64 slot = LayoutFreeIndices_Pop(&layout->data_free_indices);
+  LayoutEntityIndices_Set(&layout->entity_indices, slot, index);
+  EntityLocation *location = &world->entity_locations.mem[index];
+  location->layout_index = (u32)layout->index;
+  location->slot = slot;
 
   return entity;
 }
@@ -546,60 +841,89 @@ Entity *ecs_CreateEntity(PropsSignature *signature,
 }
 
 StatusCode ecs_DeleteEntity(Entity *entity) {
-  CHECK_VALID_ECS_STATE(NULL_EXCEPTION);
   NULL_FUNC_ARG_ROUTINE(entity, NULL_EXCEPTION);
-  ENTITY_USE_AFTER_FREE_ROUTINE(entity, USE_AFTER_FREE);
+  EntityLocation *location = GetEntityLocation(entity);
+  ENTITY_USE_AFTER_FREE_ROUTINE(location, USE_AFTER_FREE);
+  EcsWorld *world = entity->world;
+  Layout *layout = world->layouts.mem[location->layout_index];
 
   IF_FUNC_FAILED(
       /*
        * Since the layout and entity are opaque pointers, we trust
        * in the creation that no duplicate values to be sent down the stream.
        */
-      arr_VectorPush(entity->layout->data_free_indices, &entity->index, NULL)) {
+      LayoutFreeIndices_Push(&layout->data_free_indices, location->slot)) {
     STATUS_LOG(FAILURE, "Failed to delete entity from layout.");
     return FAILURE;
   }
 
-  entity->layout = NULL;
-  entity->index = INVALID_INDEX;
+  LayoutEntityIndices_Set(&layout->entity_indices, location->slot,
+                          INVALID_INDEX);
+  // Ids of the old generation no longer match the index.
+  location->layout_index = INVALID_LAYOUT_INDEX;
+  location->generation++;
+  // Can't fail, there is room for every index.
+  U64Vec_Push(&world->free_entity_indices, entity->index);
 
   return SUCCESS;
 }
 
-static u64 GetEntityPropArrOffset(Entity *entity, PropId id) {
-  u64 prop_array_offset = 0;
-  u64 *prop_signature_raw =
-      arr_BuffArrRaw(entity->layout->layout_signature->id_bitset);
-  u64 prop_signature_cap =
-      arr_BuffArrCap(entity->layout->layout_signature->id_bitset);
-  u64 *size_raw = arr_VectorRaw(ecs_state->props_metadata_table.size);
+u64 ecs_EntityId(const Entity *entity) {
+  NULL_FUNC_ARG_ROUTINE(entity, INVALID_INDEX);
+  const EntityLocation *location = GetEntityLocation(entity);
+  ENTITY_USE_AFTER_FREE_ROUTINE(location, INVALID_INDEX);
 
-  u64 signature_index = 0;
-  u64 id_bitset = PropIdToPropBitset(id, &signature_index);
+  return ENTITY_ID(entity->index, location->generation);
+}
 
-  for (u64 i = 0; i < prop_signature_cap; i++) {
-    u64 bitset_int = prop_signature_raw[i];
-    if (i == signature_index && HAS_FLAG(bitset_int, id_bitset)) {
-      return prop_array_offset;
-    }
+Entity *ecs_WorldEntityFromId(EcsWorld *world, u64 id) {
+  NULL_FUNC_ARG_ROUTINE(world, NULL);
+  u64 index = ENTITY_ID_INDEX(id);
+  if (index >= EntityLocations_Len(&world->entity_locations)) {
+    STATUS_LOG(FAILURE, "No entity of id: %zu in the world.", id);
+    return NULL;
+  }
 
-    // This lets us decompose prop bitflags into individual props.
-    while (bitset_int) {
-      // Extract the lowest most set bit.
-      u64 prop_bitset = bitset_int & -bitset_int;
+  // Deleted, or the index went to another entity since.
+  const EntityLocation *location = &world->entity_locations.mem[index];
+  if (location->layout_index == INVALID_LAYOUT_INDEX ||
+      location->generation != ENTITY_ID_GENERATION(id)) {
+    return NULL;
+  }
 
-      PropId id = PropBitsetToPropId(prop_bitset, i);
-      // Since bitset_int != 0, this will be a valid index.
-      prop_array_offset += size_raw[id] * CHUNK_ARR_CAP;
+  return world->entities.mem[index];
+}
 
-      // Clearing the lowest set bit from the props;
-      bitset_int ^= prop_bitset;
-    }
+static u64 GetLayoutPropArrOffset(const Layout *layout, PropId id) {
+  u64 prop_array_offset = 0;
+  u64 *prop_signature_raw = arr_BuffArrRaw(layout->layout_signature->id_bitset);
+  u64 prop_signature_cap = arr_BuffArrCap(layout->layout_signature->id_bitset);
+  u64 *size_raw = layout->world->props_metadata_table.size.mem;
+
+  if (id / BITSET_WORD_BITS >= prop_signature_cap ||
+      !bitset_Test(prop_signature_raw, id)) {
+    STATUS_LOG(FAILURE, "Invalid PropId: %zu does not belong to the layout.",
+               id);
+    return INVALID_OFFSET;
+  }
+
+  // The prop arrays are laid out in increasing PropId order.
+  BitsetIter iter = bitset_IterCreate(prop_signature_raw, prop_signature_cap);
+  for (PropId curr_id; (curr_id = bitset_IterNext(&iter)) != id;) {
+    prop_array_offset += size_raw[curr_id] * CHUNK_ARR_CAP;
   }
 
-  STATUS_LOG(FAILURE, "Invalid PropId: %zu does not belong to the entity.", id);
+  return prop_array_offset;
+}
+
+// Offset of the slot's element in the prop array, from the start of data.
+static inline u64 GetLayoutSlotPropOffset(const Layout *layout,
+                                          u64 prop_arr_offset, u64 prop_size,
+                                          u64 slot) {
+  u64 chunk_size = layout->props_combined_size * CHUNK_ARR_CAP;
 
-  return INVALID_OFFSET;
+  return ((slot / CHUNK_ARR_CAP) * chunk_size) + prop_arr_offset +
+         ((slot % CHUNK_ARR_CAP) * prop_size);
 }
 
 void *ecs_GetPropDataFromEntity(Entity *entity, PropId id) {
@@ -607,24 +931,22 @@ void *ecs_GetPropDataFromEntity(Entity *entity, PropId id) {
    * NOTE: This function is susceptible to out of bounds access, but since this
    * is a user facing function, we have to say so as the users are dumb.
    */
-  CHECK_VALID_ECS_STATE(NULL);
   NULL_FUNC_ARG_ROUTINE(entity, NULL);
-  ENTITY_USE_AFTER_FREE_ROUTINE(entity, NULL);
+  const EntityLocation *location = GetEntityLocation(entity);
+  ENTITY_USE_AFTER_FREE_ROUTINE(location, NULL);
+  EcsWorld *world = entity->world;
+  Layout *layout = world->layouts.mem[location->layout_index];
   if (id == INVALID_PROP_ID) {
     STATUS_LOG(FAILURE, "Invalid prop id provided.");
     return NULL;
   }
-  u64 prop_id_size = -1;
-  IF_FUNC_FAILED(
-      arr_VectorGet(ecs_state->props_metadata_table.size, id, &prop_id_size)) {
+  if (id >= U64Vec_Len(&world->props_metadata_table.size)) {
     STATUS_LOG(FAILURE, "Invalid prop id provided.");
     return NULL;
   }
+  u64 prop_id_size = U64Vec_Get(&world->props_metadata_table.size, id);
 
-  u64 layout_data_index = entity->index / CHUNK_ARR_CAP;
-  u64 internal_data_index = entity->index % CHUNK_ARR_CAP;
-
-  void *layout_mem = arr_VectorRaw(entity->layout->data);
+  void *layout_mem = arr_VectorRaw(layout->data);
   IF_NULL(layout_mem) {
     STATUS_LOG(
         FAILURE,
@@ -632,41 +954,997 @@ void *ecs_GetPropDataFromEntity(Entity *entity, PropId id) {
     return NULL;
   }
 
-  u64 prop_arr_offset = GetEntityPropArrOffset(entity, id);
+  u64 prop_arr_offset = GetLayoutPropArrOffset(layout, id);
   if (prop_arr_offset == INVALID_OFFSET) {
     STATUS_LOG(FAILURE, "Cannot find the array offset of the PropId: %zu", id);
     return NULL;
   }
 
-  return layout_mem + (layout_data_index * CHUNK_ARR_CAP) +
-         GetEntityPropArrOffset(entity, id) +
-         (internal_data_index * prop_id_size);
+  return MEM_OFFSET(layout_mem,
+                    GetLayoutSlotPropOffset(layout, prop_arr_offset,
+                                            prop_id_size, location->slot));
+}
+
+
+/* ----  SNAPSHOT RELATED FUNCTIONS  ---- */
+
+typedef struct {
+  u64 tick;
+  // Bytes written, 0 for a slot that was never written.
+  u64 size;
+  /*
+   * Taken from a world, or checked by a restore already. Restores trust it and
+   * skip the checks, which touch every entity.
+   */
+  bool checked;
+  u8 *mem;
+} EcsSnapshot;
+
+struct __EcsSnapshotRing {
+  Allocator allocator;
+  EcsSnapshot *snapshots;
+  u64 snapshot_count;
+  u64 snapshot_size;
+  // All the snapshots' memory, in one block.
+  u8 *mem;
+};
+
+/*
+ * A snapshot is the header, the world's entity locations and free entity
+ * indices, then every layout's SnapshotLayout, its signature, chunks, entity
+ * indices and free slots, each part 8 byte aligned. Layouts are in the
+ * world's order, so the locations' layout indices are the records'.
+ *
+ * It holds no pointers, layouts are found by their signature and entities by
+ * their index, so it restores into any world that registered the same props.
+ */
+typedef struct {
+  u64 layout_count;
+  // Length of the entity locations, every index of the snapshot is below it.
+  u64 entity_count;
+  u64 free_entity_count;
+} SnapshotHeader;
+
+typedef struct {
+  // The signature's words, without the trailing zero ones.
+  u64 signature_word_count;
+  u64 props_combined_size;
+  u64 chunk_count;
+  u64 slot_count;
+  u64 free_count;
+} SnapshotLayout;
+
+// Where the parts of a snapshot are, once its bounds have been checked.
+typedef struct {
+  const SnapshotHeader *header;
+  const EntityLocation *entity_locations;
+  const u64 *free_entity_indices;
+  // The first SnapshotLayout.
+  const u8 *layouts;
+  const u8 *end;
+} SnapshotView;
+
+typedef struct {
+  const SnapshotLayout *record;
+  const u64 *signature_words;
+  const u8 *data;
+  const u64 *entity_indices;
+  const u64 *free_slots;
+} SnapshotLayoutView;
+
+#define SNAPSHOT_ALIGNMENT (8)
+
+static bool ReadSnapshot(const EcsSnapshot *snapshot, SnapshotView *view);
+static const u8 *ReadSnapshotLayout(const u8 *cursor, const u8 *end,
+                                    SnapshotLayoutView *view);
+static bool IsUniqueBelow(const u64 *vals, u64 count, u64 bound,
+                          u64 *scratch_bitset);
+static StatusCode CheckSnapshot(const SnapshotView *view,
+                                U64Vec *scratch_bitset);
+static bool IsSnapshotLayout(const Layout *layout, const u64 *words,
+                             u64 word_count);
+static Layout *FindSnapshotLayout(const EcsWorld *world, const u64 *words,
+                                  u64 word_count, u64 record_index);
+static Layout *CreateSnapshotLayout(EcsWorld *world, const u64 *words,
+                                    u64 word_count);
+static StatusCode PrepareSnapshotLayout(EcsWorld *world,
+                                        const SnapshotLayoutView *view,
+                                        u64 record_index);
+static u64 GetSnapshotLayoutSize(const Layout *layout);
+
+static bool ReadSnapshot(const EcsSnapshot *snapshot, SnapshotView *view) {
+  if (snapshot->size < sizeof(SnapshotHeader)) {
+    return false;
+  }
+  const SnapshotHeader *header = (const SnapshotHeader *)snapshot->mem;
+  u64 remaining = snapshot->size - sizeof(SnapshotHeader);
+  // Written this way against overflows.
+  if (header->layout_count > INVALID_LAYOUT_INDEX ||
+      header->entity_count > ENTITY_INDEX_LIMIT ||
+      header->free_entity_count > header->entity_count ||
+      header->entity_count > remaining / sizeof(EntityLocation) ||
+      header->free_entity_count >
+          (remaining - header->entity_count * sizeof(EntityLocation)) /
+              sizeof(u64)) {
+    return false;
+  }
+
+  const u8 *cursor = snapshot->mem + sizeof(SnapshotHeader);
+  *view = (SnapshotView){.header = header,
+                         .entity_locations = (const EntityLocation *)cursor};
+  cursor += header->entity_count * sizeof(EntityLocation);
+  view->free_entity_indices = (const u64 *)cursor;
+  cursor += header->free_entity_count * sizeof(u64);
+  view->layouts = cursor;
+  view->end = snapshot->mem + snapshot->size;
+
+  return true;
+}
+
+// Returns the next SnapshotLayout, NULL if the one at cursor runs past end.
+static const u8 *ReadSnapshotLayout(const u8 *cursor, const u8 *end,
+                                    SnapshotLayoutView *view) {
+  u64 remaining = (u64)(end - cursor);
+  if (remaining < sizeof(SnapshotLayout)) {
+    return NULL;
+  }
+  const SnapshotLayout *record = (const SnapshotLayout *)cursor;
+  cursor += sizeof(SnapshotLayout);
+  remaining -= sizeof(SnapshotLayout);
+  if (!record->signature_word_count ||
+      record->signature_word_count > remaining / sizeof(u64)) {
+    return NULL;
+  }
+  view->record = record;
+  view->signature_words = (const u64 *)cursor;
+  if (!view->signature_words[record->signature_word_count - 1]) {
+    return NULL;
+  }
+  cursor += record->signature_word_count * sizeof(u64);
+  remaining -= record->signature_word_count * sizeof(u64);
+
+  // Written this way against overflows.
+  u64 chunk_size = record->props_combined_size * CHUNK_ARR_CAP;
+  if (record->props_combined_size > UINT64_MAX / CHUNK_ARR_CAP ||
+      (chunk_size && record->chunk_count > remaining / chunk_size)) {
+    return NULL;
+  }
+  u64 data_size = ALIGN_UP(record->chunk_count * chunk_size,
+                           SNAPSHOT_ALIGNMENT);
+  if (data_size > remaining) {
+    return NULL;
+  }
+  view->data = cursor;
+  cursor += data_size;
+  remaining -= data_size;
+  // Every chunk has CHUNK_ARR_CAP slots.
+  if (record->slot_count / CHUNK_ARR_CAP != record->chunk_count ||
+      record->slot_count % CHUNK_ARR_CAP ||
+      record->slot_count > remaining / sizeof(u64) ||
+      record->free_count > record->slot_count ||
+      record->free_count >
+          (remaining - record->slot_count * sizeof(u64)) / sizeof(u64)) {
+    return NULL;
+  }
+  view->entity_indices = (const u64 *)cursor;
+  cursor += record->slot_count * sizeof(u64);
+  view->free_slots = (const u64 *)cursor;
+  cursor += record->free_count * sizeof(u64);
+
+  return cursor;
+}
+
+// Leaves scratch_bitset, of at least bound bits, cleared as it found it.
+static bool IsUniqueBelow(const u64 *vals, u64 count, u64 bound,
+                          u64 *scratch_bitset) {
+  u64 i = 0;
+  for (; i < count; i++) {
+    if (vals[i] >= bound || bitset_Test(scratch_bitset, vals[i])) {
+      break;
+    }
+    bitset_Set(scratch_bitset, vals[i]);
+  }
+  for (u64 j = 0; j < i; j++) {
+    bitset_Clear(scratch_bitset, vals[j]);
+  }
+
+  return i == count;
+}
+
+/*
+ * Checks every live slot and its entity's location point at one another, and
+ * every free slot and free index is listed once. The props are checked against
+ * the world's as its layouts are found.
+ */
+static StatusCode CheckSnapshot(const SnapshotView *view,
+                                U64Vec *scratch_bitset) {
+  const SnapshotHeader *header = view->header;
+  SnapshotLayoutView layout_view;
+  u64 bound = header->entity_count;
+  const u8 *cursor = view->layouts;
+  for (u64 i = 0; i < header->layout_count; i++) {
+    IF_NULL(cursor = ReadSnapshotLayout(cursor, view->end, &layout_view)) {
+      goto corrupt;
+    }
+    bound = MAX(bound, layout_view.record->slot_count);
+  }
+
+  u64 old_cap = scratch_bitset->cap;
+  IF_FUNC_FAILED(U64Vec_Reserve(scratch_bitset, BITSET_WORD_COUNT(bound))) {
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(scratch_bitset, CREATION_FAILURE);
+  }
+  if (scratch_bitset->cap > old_cap) {
+    memset(scratch_bitset->mem + old_cap, 0,
+           (scratch_bitset->cap - old_cap) * sizeof(u64));
+  }
+  u64 *bitset = scratch_bitset->mem;
+
+  const EntityLocation *locations = view->entity_locations;
+  u64 live_count = 0;
+  cursor = view->layouts;
+  for (u64 i = 0; i < header->layout_count; i++) {
+    cursor = ReadSnapshotLayout(cursor, view->end, &layout_view);
+    const SnapshotLayout *record = layout_view.record;
+    u64 layout_live_count = 0;
+    for (u64 slot = 0; slot < record->slot_count; slot++) {
+      u64 index = layout_view.entity_indices[slot];
+      if (index == INVALID_INDEX) {
+        continue;
+      }
+      if (index >= header->entity_count ||
+          locations[index].layout_index != i ||
+          locations[index].slot != slot) {
+        goto corrupt;
+      }
+      layout_live_count++;
+    }
+    if (record->free_count != record->slot_count - layout_live_count ||
+        !IsUniqueBelow(layout_view.free_slots, record->free_count,
+                       record->slot_count, bitset)) {
+      goto corrupt;
+    }
+    for (u64 j = 0; j < record->free_count; j++) {
+      if (layout_view.entity_indices[layout_view.free_slots[j]] !=
+          INVALID_INDEX) {
+        goto corrupt;
+      }
+    }
+    live_count += layout_live_count;
+  }
+
+  // Each live slot has its own location, so no other location can be live.
+  u64 live_location_count = 0;
+  for (u64 i = 0; i < header->entity_count; i++) {
+    live_location_count += locations[i].layout_index != INVALID_LAYOUT_INDEX;
+  }
+  if (live_location_count != live_count ||
+      header->free_entity_count != header->entity_count - live_count ||
+      !IsUniqueBelow(view->free_entity_indices, header->free_entity_count,
+                     header->entity_count, bitset)) {
+    goto corrupt;
+  }
+  for (u64 i = 0; i < header->free_entity_count; i++) {
+    if (locations[view->free_entity_indices[i]].layout_index !=
+        INVALID_LAYOUT_INDEX) {
+      goto corrupt;
+    }
+  }
+
+  return SUCCESS;
+
+corrupt:
+  STATUS_LOG(FAILURE, "Corrupt snapshot.");
+  return FAILURE;
+}
+
+static bool IsSnapshotLayout(const Layout *layout, const u64 *words,
+                             u64 word_count) {
+  const PropsSignature *signature = layout->layout_signature;
+
+  return GetSignatureWordCount(signature) == word_count &&
+         !memcmp(arr_BuffArrRaw(signature->id_bitset), words,
+                 word_count * sizeof(u64));
+}
+
+static Layout *FindSnapshotLayout(const EcsWorld *world, const u64 *words,
+                                  u64 word_count, u64 record_index) {
+  const WorldLayouts *layouts = &world->layouts;
+  // Restoring into the world the snapshot was taken from, the layouts match.
+  if (record_index < WorldLayouts_Len(layouts) &&
+      IsSnapshotLayout(layouts->mem[record_index], words, word_count)) {
+    return layouts->mem[record_index];
+  }
+  for (u64 i = 0; i < WorldLayouts_Len(layouts); i++) {
+    if (IsSnapshotLayout(layouts->mem[i], words, word_count)) {
+      return layouts->mem[i];
+    }
+  }
+
+  return NULL;
+}
+
+static Layout *CreateSnapshotLayout(EcsWorld *world, const u64 *words,
+                                    u64 word_count) {
+  PropsSignature *signature = ecs_WorldPropSignatureCreate(world);
+  IF_NULL(signature) {
+    STATUS_LOG(CREATION_FAILURE, "Cannot create the signature of a layout "
+                                 "from the snapshot.");
+    return NULL;
+  }
+  BitsetIter iter = bitset_IterCreate(words, word_count);
+  for (PropId id; (id = bitset_IterNext(&iter)) != INVALID_INDEX;) {
+    // Fails on props the world hasn't registered.
+    IF_FUNC_FAILED(ecs_HandlePropIdToPropSignatures(signature, id,
+                                                    PROP_SIGNATURE_ATTACH)) {
+      PropSignatureDeleteCallback(signature);
+      STATUS_LOG(FAILURE, "Snapshot has a layout of unknown props.");
+      return NULL;
+    }
+  }
+
+  return ecs_LayoutCreate(signature, DUPLICATE_PROPS_SIGNATURE_FREE);
+}
+
+/*
+ * Finds the layout of the SnapshotLayout, creating it if the world doesn't
+ * have it, checks its props fit and makes room for the record in it.
+ */
+static StatusCode PrepareSnapshotLayout(EcsWorld *world,
+                                        const SnapshotLayoutView *view,
+                                        u64 record_index) {
+  const SnapshotLayout *record = view->record;
+  Layout *layout = FindSnapshotLayout(world, view->signature_words,
+                                      record->signature_word_count,
+                                      record_index);
+  IF_NULL(layout) {
+    layout = CreateSnapshotLayout(world, view->signature_words,
+                                  record->signature_word_count);
+    IF_NULL(layout) {
+      STATUS_LOG(FAILURE, "Cannot create a layout of the snapshot.");
+      return FAILURE;
+    }
+  }
+  if (layout->snapshot_record != INVALID_INDEX) {
+    STATUS_LOG(FAILURE, "Corrupt snapshot, it has a layout twice.");
+    return FAILURE;
+  }
+  if (record->props_combined_size != layout->props_combined_size) {
+    STATUS_LOG(FAILURE, "Snapshot's props are of other sizes than the "
+                        "world's, are they registered in the same order?");
+    return FAILURE;
+  }
+  layout->snapshot_record = record_index;
+
+  // Only allocates when the layout never held that many entities.
+  IF_FUNC_FAILED(arr_VectorReserve(layout->data, record->chunk_count)) {
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(layout->data, CREATION_FAILURE);
+  }
+  IF_FUNC_FAILED(LayoutEntityIndices_Reserve(&layout->entity_indices,
+                                             record->slot_count)) {
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(layout->entity_indices, CREATION_FAILURE);
+  }
+  IF_FUNC_FAILED(LayoutFreeIndices_Reserve(&layout->data_free_indices,
+                                           record->slot_count)) {
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(layout->data_free_indices,
+                                  CREATION_FAILURE);
+  }
+
+  return SUCCESS;
+}
+
+static u64 GetSnapshotLayoutSize(const Layout *layout) {
+  u64 chunk_size = layout->props_combined_size * CHUNK_ARR_CAP;
+
+  return sizeof(SnapshotLayout) +
+         GetSignatureWordCount(layout->layout_signature) * sizeof(u64) +
+         ALIGN_UP(arr_VectorLen(layout->data) * chunk_size,
+                  SNAPSHOT_ALIGNMENT) +
+         LayoutEntityIndices_Len(&layout->entity_indices) * sizeof(u64) +
+         LayoutFreeIndices_Len(&layout->data_free_indices) * sizeof(u64);
+}
+
+EcsSnapshotRing *ecs_SnapshotRingCreate(u64 snapshot_count,
+                                        u64 snapshot_size) {
+  if (!snapshot_count || snapshot_size < sizeof(SnapshotHeader)) {
+    STATUS_LOG(FAILURE, "Invalid snapshot count: %zu or size: %zu provided.",
+               snapshot_count, snapshot_size);
+    return NULL;
+  }
+  // Keeps every snapshot cache line aligned.
+  snapshot_size = ALIGN_UP(snapshot_size, CACHE_LINE_SIZE);
+
+  Allocator allocator = mem_HeapAllocatorWCategory(MEM_CATEGORY_ECS);
+  EcsSnapshotRing *ring = mem_Calloc(&allocator, sizeof(EcsSnapshotRing));
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(ring, NULL);
+  ring->allocator = allocator;
+  ring->snapshot_count = snapshot_count;
+  ring->snapshot_size = snapshot_size;
+
+  ring->snapshots =
+      mem_Calloc(&allocator, sizeof(EcsSnapshot) * snapshot_count);
+  ring->mem = mem_Alloc(&allocator, snapshot_size * snapshot_count);
+  if (!ring->snapshots || !ring->mem) {
+    ecs_SnapshotRingDelete(ring);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(ring->mem, NULL);
+  }
+  for (u64 i = 0; i < snapshot_count; i++) {
+    ring->snapshots[i].mem = ring->mem + i * snapshot_size;
+  }
+
+  return ring;
+}
+
+StatusCode ecs_SnapshotRingDelete(EcsSnapshotRing *ring) {
+  NULL_FUNC_ARG_ROUTINE(ring, NULL_EXCEPTION);
+
+  Allocator allocator = ring->allocator;
+  mem_Free(&allocator, ring->snapshots,
+           sizeof(EcsSnapshot) * ring->snapshot_count);
+  mem_Free(&allocator, ring->mem, ring->snapshot_size * ring->snapshot_count);
+  mem_Free(&allocator, ring, sizeof(EcsSnapshotRing));
+
+  return SUCCESS;
+}
+
+u64 ecs_WorldSnapshotSize(const EcsWorld *world) {
+  NULL_FUNC_ARG_ROUTINE(world, 0);
+
+  u64 size = sizeof(SnapshotHeader) +
+             EntityLocations_Len(&world->entity_locations) *
+                 sizeof(EntityLocation) +
+             U64Vec_Len(&world->free_entity_indices) * sizeof(u64);
+  for (u64 i = 0; i < WorldLayouts_Len(&world->layouts); i++) {
+    size += ALIGN_UP(GetSnapshotLayoutSize(world->layouts.mem[i]),
+                     SNAPSHOT_ALIGNMENT);
+  }
+
+  return size;
+}
+
+StatusCode ecs_WorldSnapshot(EcsWorld *world, EcsSnapshotRing *ring,
+                             u64 tick) {
+  NULL_FUNC_ARG_ROUTINE(world, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(ring, NULL_EXCEPTION);
+
+  EcsSnapshot *snapshot = &ring->snapshots[tick % ring->snapshot_count];
+  u64 size = ecs_WorldSnapshotSize(world);
+  if (size > ring->snapshot_size) {
+    STATUS_LOG(FAILURE,
+               "World snapshot of: %zu bytes doesn't fit the ring's: %zu.",
+               size, ring->snapshot_size);
+    return FAILURE;
+  }
+
+  u8 *cursor = snapshot->mem;
+  u64 layout_count = WorldLayouts_Len(&world->layouts);
+  SnapshotHeader *header = (SnapshotHeader *)cursor;
+  *header = (SnapshotHeader){
+      .layout_count = layout_count,
+      .entity_count = EntityLocations_Len(&world->entity_locations),
+      .free_entity_count = U64Vec_Len(&world->free_entity_indices)};
+  cursor += sizeof(SnapshotHeader);
+  memcpy(cursor, world->entity_locations.mem,
+         header->entity_count * sizeof(EntityLocation));
+  cursor += header->entity_count * sizeof(EntityLocation);
+  memcpy(cursor, world->free_entity_indices.mem,
+         header->free_entity_count * sizeof(u64));
+  cursor += header->free_entity_count * sizeof(u64);
+
+  for (u64 i = 0; i < layout_count; i++) {
+    Layout *layout = world->layouts.mem[i];
+    u64 data_size =
+        arr_VectorLen(layout->data) * layout->props_combined_size *
+        CHUNK_ARR_CAP;
+    SnapshotLayout *record = (SnapshotLayout *)cursor;
+    *record = (SnapshotLayout){
+        .signature_word_count =
+            GetSignatureWordCount(layout->layout_signature),
+        .props_combined_size = layout->props_combined_size,
+        .chunk_count = arr_VectorLen(layout->data),
+        .slot_count = LayoutEntityIndices_Len(&layout->entity_indices),
+        .free_count = LayoutFreeIndices_Len(&layout->data_free_indices)};
+    cursor += sizeof(SnapshotLayout);
+
+    memcpy(cursor, arr_BuffArrRaw(layout->layout_signature->id_bitset),
+           record->signature_word_count * sizeof(u64));
+    cursor += record->signature_word_count * sizeof(u64);
+    memcpy(cursor, arr_VectorRaw(layout->data), data_size);
+    cursor += ALIGN_UP(data_size, SNAPSHOT_ALIGNMENT);
+    memcpy(cursor, layout->entity_indices.mem,
+           record->slot_count * sizeof(u64));
+    cursor += record->slot_count * sizeof(u64);
+    memcpy(cursor, LayoutFreeIndices_Data(&layout->data_free_indices),
+           record->free_count * sizeof(u64));
+    cursor += record->free_count * sizeof(u64);
+  }
+
+  snapshot->tick = tick;
+  snapshot->size = size;
+  snapshot->checked = true;
+
+  return SUCCESS;
+}
+
+StatusCode ecs_WorldRestore(EcsWorld *world, EcsSnapshotRing *ring,
+                            u64 tick) {
+  NULL_FUNC_ARG_ROUTINE(world, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(ring, NULL_EXCEPTION);
+
+  EcsSnapshot *snapshot = &ring->snapshots[tick % ring->snapshot_count];
+  if (!snapshot->size || snapshot->tick != tick) {
+    STATUS_LOG(FAILURE, "No snapshot of tick: %zu in the ring.", tick);
+    return FAILURE;
+  }
+  SnapshotView view;
+  if (!ReadSnapshot(snapshot, &view)) {
+    STATUS_LOG(FAILURE, "Corrupt snapshot of tick: %zu.", tick);
+    return FAILURE;
+  }
+  if (!snapshot->checked) {
+    IF_FUNC_FAILED(CheckSnapshot(&view, &world->snapshot_check_bitset)) {
+      STATUS_LOG(FAILURE, "Cannot restore the snapshot of tick: %zu.", tick);
+      return FAILURE;
+    }
+    snapshot->checked = true;
+  }
+  const SnapshotHeader *header = view.header;
+
+  /*
+   * Nothing the world's entities depend on is touched before every layout of
+   * the snapshot exists, with room for it. Only a world that never held as
+   * much as the snapshot allocates.
+   */
+  for (u64 i = 0; i < WorldLayouts_Len(&world->layouts); i++) {
+    world->layouts.mem[i]->snapshot_record = INVALID_INDEX;
+  }
+  SnapshotLayoutView layout_view;
+  const u8 *cursor = view.layouts;
+  for (u64 i = 0; i < header->layout_count; i++) {
+    // Can't fail, the snapshot was checked above.
+    cursor = ReadSnapshotLayout(cursor, view.end, &layout_view);
+    IF_FUNC_FAILED(PrepareSnapshotLayout(world, &layout_view, i)) {
+      STATUS_LOG(FAILURE, "Cannot restore the snapshot of tick: %zu.", tick);
+      return FAILURE;
+    }
+  }
+  IF_FUNC_FAILED(EntityLocations_Reserve(&world->entity_locations,
+                                         header->entity_count)) {
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(world->entity_locations, CREATION_FAILURE);
+  }
+  IF_FUNC_FAILED(U64Vec_Reserve(&world->free_entity_indices,
+                                world->entity_locations.cap)) {
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(world->free_entity_indices,
+                                  CREATION_FAILURE);
+  }
+  if (header->entity_count &&
+      !GetEntityHandle(world, header->entity_count - 1)) {
+    STATUS_LOG(CREATION_FAILURE, "Cannot create the snapshot's handles.");
+    return CREATION_FAILURE;
+  }
+
+  // Every layout moves to its record's place, the rest go after them.
+  WorldLayouts *layouts = &world->layouts;
+  for (u64 i = 0; i < WorldLayouts_Len(layouts); i++) {
+    Layout *layout = layouts->mem[i];
+    while (layout->snapshot_record != INVALID_INDEX &&
+           layout->snapshot_record != i) {
+      layouts->mem[i] = layouts->mem[layout->snapshot_record];
+      layouts->mem[layout->snapshot_record] = layout;
+      layout = layouts->mem[i];
+    }
+  }
+
+  cursor = view.layouts;
+  for (u64 i = 0; i < WorldLayouts_Len(layouts); i++) {
+    Layout *layout = layouts->mem[i];
+    layout->index = i;
+    if (i >= header->layout_count) {
+      // Layouts missing from the snapshot stay empty.
+      arr_VectorSetLen(layout->data, 0);
+      layout->entity_indices.len = 0;
+      layout->data_free_indices.len = 0;
+      continue;
+    }
+    cursor = ReadSnapshotLayout(cursor, view.end, &layout_view);
+    const SnapshotLayout *record = layout_view.record;
+    u64 data_size =
+        record->chunk_count * layout->props_combined_size * CHUNK_ARR_CAP;
+
+    // Can't fail either, the caps were reserved above.
+    arr_VectorSetLen(layout->data, record->chunk_count);
+    memcpy(arr_VectorRaw(layout->data), layout_view.data, data_size);
+    layout->entity_indices.len = record->slot_count;
+    memcpy(layout->entity_indices.mem, layout_view.entity_indices,
+           record->slot_count * sizeof(u64));
+    layout->data_free_indices.len = record->free_count;
+    memcpy(LayoutFreeIndices_Data(&layout->data_free_indices),
+           layout_view.free_slots, record->free_count * sizeof(u64));
+  }
+
+  // The handles find their entities through these, nothing else to fix up.
+  world->entity_locations.len = header->entity_count;
+  memcpy(world->entity_locations.mem, view.entity_locations,
+         header->entity_count * sizeof(EntityLocation));
+  world->free_entity_indices.len = header->free_entity_count;
+  memcpy(world->free_entity_indices.mem, view.free_entity_indices,
+         header->free_entity_count * sizeof(u64));
+
+  return SUCCESS;
+}
+
+/* ----  SNAPSHOT DELTA RELATED FUNCTIONS  ---- */
+
+/*
+ * A delta is the header (magic, then varints of base_tick + 1, tick and the
+ * snapshot's size), followed by runs covering the snapshot front to back:
+ * a varint of bytes equal to the base, a varint of bytes that differ, and
+ * those bytes XORed with the base. Bytes past the end of the base count as 0.
+ */
+static const u8 delta_magic[4] = {'E', 'C', 'S', 'D'};
+// Zero XOR runs shorter than this are cheaper kept in the literal run.
+#define DELTA_MIN_ZERO_RUN (8)
+#define VARINT_MAX_SIZE (10)
+
+static inline u8 GetXorByte(const u8 *target, const u8 *base, u64 base_size,
+                            u64 i);
+static u64 SkipZeroXor(const u8 *target, const u8 *base, u64 base_size,
+                       u64 i, u64 size);
+static u8 *WriteVarint(u8 *cursor, const u8 *end, u64 val);
+static const u8 *ReadVarint(const u8 *cursor, const u8 *end, u64 *val);
+
+static inline u8 GetXorByte(const u8 *target, const u8 *base, u64 base_size,
+                            u64 i) {
+  return target[i] ^ ((i < base_size) ? base[i] : 0);
 }
 
+// Returns the index of the first byte from i on that differs, or size.
+static u64 SkipZeroXor(const u8 *target, const u8 *base, u64 base_size,
+                       u64 i, u64 size) {
+  u64 common = MIN(base_size, size);
+  while (i + sizeof(u64) <= common) {
+    u64 target_word, base_word;
+    memcpy(&target_word, target + i, sizeof(u64));
+    memcpy(&base_word, base + i, sizeof(u64));
+    if (target_word != base_word) {
+      break;
+    }
+    i += sizeof(u64);
+  }
+  while (i < size && !GetXorByte(target, base, base_size, i)) {
+    i++;
+  }
+
+  return i;
+}
+
+// LEB128, NULL if it doesn't fit before end.
+static u8 *WriteVarint(u8 *cursor, const u8 *end, u64 val) {
+  do {
+    if (cursor >= end) {
+      return NULL;
+    }
+    u8 byte = val & 0x7f;
+    val >>= 7;
+    *cursor++ = byte | ((val) ? 0x80 : 0);
+  } while (val);
+
+  return cursor;
+}
+
+static const u8 *ReadVarint(const u8 *cursor, const u8 *end, u64 *val) {
+  *val = 0;
+  for (u64 shift = 0; shift < 7 * VARINT_MAX_SIZE; shift += 7) {
+    if (cursor >= end) {
+      return NULL;
+    }
+    u8 byte = *cursor++;
+    *val |= (u64)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return cursor;
+    }
+  }
+
+  return NULL;
+}
+
+u64 ecs_SnapshotDeltaMaxSize(const EcsSnapshotRing *ring) {
+  NULL_FUNC_ARG_ROUTINE(ring, 0);
+
+  /*
+   * The worst case is 1 differing byte every DELTA_MIN_ZERO_RUN + 1, with 2
+   * bytes of varints for each run.
+   */
+  return sizeof(delta_magic) + 3 * VARINT_MAX_SIZE + ring->snapshot_size +
+         ring->snapshot_size / 4 + 2 * VARINT_MAX_SIZE;
+}
+
+u64 ecs_SnapshotDeltaEncode(const EcsSnapshotRing *ring, u64 base_tick,
+                            u64 tick, u8 *dest, u64 dest_cap) {
+  NULL_FUNC_ARG_ROUTINE(ring, 0);
+  NULL_FUNC_ARG_ROUTINE(dest, 0);
+
+  const EcsSnapshot *target = &ring->snapshots[tick % ring->snapshot_count];
+  if (!target->size || target->tick != tick) {
+    STATUS_LOG(FAILURE, "No snapshot of tick: %zu in the ring.", tick);
+    return 0;
+  }
+  const u8 *base = NULL;
+  u64 base_size = 0;
+  if (base_tick != ECS_SNAPSHOT_DELTA_KEYFRAME) {
+    const EcsSnapshot *base_snapshot =
+        &ring->snapshots[base_tick % ring->snapshot_count];
+    if (!base_snapshot->size || base_snapshot->tick != base_tick) {
+      STATUS_LOG(FAILURE, "No base snapshot of tick: %zu in the ring.",
+                 base_tick);
+      return 0;
+    }
+    base = base_snapshot->mem;
+    base_size = base_snapshot->size;
+  }
+
+  u8 *cursor = dest;
+  const u8 *end = dest + dest_cap;
+  if (dest_cap < sizeof(delta_magic)) {
+    goto overflow;
+  }
+  memcpy(cursor, delta_magic, sizeof(delta_magic));
+  cursor += sizeof(delta_magic);
+  // The keyframe's base_tick wraps around to 0.
+  if (!(cursor = WriteVarint(cursor, end, base_tick + 1)) ||
+      !(cursor = WriteVarint(cursor, end, tick)) ||
+      !(cursor = WriteVarint(cursor, end, target->size))) {
+    goto overflow;
+  }
+
+  const u8 *mem = target->mem;
+  u64 size = target->size;
+  u64 i = 0;
+  while (i < size) {
+    // Trailing zeros end up as a run with no literal.
+    u64 zero_start = i;
+    i = SkipZeroXor(mem, base, base_size, i, size);
+    u64 literal_start = i;
+    // Short zero runs are absorbed, the literal ends where a long one starts.
+    while (i < size) {
+      if (GetXorByte(mem, base, base_size, i)) {
+        i++;
+        continue;
+      }
+      u64 zero_end = SkipZeroXor(mem, base, base_size, i, size);
+      if (zero_end - i >= DELTA_MIN_ZERO_RUN || zero_end == size) {
+        break;
+      }
+      i = zero_end;
+    }
+
+    u64 literal_len = i - literal_start;
+    if (!(cursor = WriteVarint(cursor, end, literal_start - zero_start)) ||
+        !(cursor = WriteVarint(cursor, end, literal_len)) ||
+        (u64)(end - cursor) < literal_len) {
+      goto overflow;
+    }
+    for (u64 j = literal_start; j < i; j++) {
+      *cursor++ = GetXorByte(mem, base, base_size, j);
+    }
+  }
+
+  return (u64)(cursor - dest);
+
+overflow:
+  STATUS_LOG(FAILURE, "Delta of tick: %zu doesn't fit in: %zu bytes.", tick,
+             dest_cap);
+  return 0;
+}
+
+StatusCode ecs_SnapshotDeltaApply(EcsSnapshotRing *ring, const u8 *delta,
+                                  u64 delta_size) {
+  NULL_FUNC_ARG_ROUTINE(ring, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(delta, NULL_EXCEPTION);
+
+  const u8 *cursor = delta, *end = delta + delta_size;
+  u64 base_tick = 0, tick = 0, size = 0;
+  if (delta_size < sizeof(delta_magic) ||
+      memcmp(delta, delta_magic, sizeof(delta_magic)) ||
+      !(cursor = ReadVarint(cursor + sizeof(delta_magic), end, &base_tick)) ||
+      !(cursor = ReadVarint(cursor, end, &tick)) ||
+      !(cursor = ReadVarint(cursor, end, &size))) {
+    STATUS_LOG(FAILURE, "Invalid snapshot delta header.");
+    return FAILURE;
+  }
+  base_tick--;
+  if (size > ring->snapshot_size) {
+    STATUS_LOG(FAILURE, "Snapshot of: %zu bytes doesn't fit the ring's: %zu.",
+               size, ring->snapshot_size);
+    return FAILURE;
+  }
+
+  EcsSnapshot *target = &ring->snapshots[tick % ring->snapshot_count];
+  const EcsSnapshot *base = NULL;
+  if (base_tick != ECS_SNAPSHOT_DELTA_KEYFRAME) {
+    base = &ring->snapshots[base_tick % ring->snapshot_count];
+    if (!base->size || base->tick != base_tick) {
+      STATUS_LOG(FAILURE, "No base snapshot of tick: %zu in the ring.",
+                 base_tick);
+      return FAILURE;
+    }
+  }
+
+  // Starts from the base, in place if both share the slot.
+  u64 base_size = (base) ? base->size : 0;
+  if (base && base != target) {
+    memcpy(target->mem, base->mem, MIN(base_size, size));
+  }
+  if (size > base_size) {
+    memset(target->mem + base_size, 0, size - base_size);
+  }
+  // Invalid until fully applied, and checked on its first restore.
+  target->size = 0;
+  target->checked = false;
+
+  u64 i = 0;
+  while (i < size) {
+    u64 zero_run = 0, literal_len = 0;
+    if (!(cursor = ReadVarint(cursor, end, &zero_run)) ||
+        !(cursor = ReadVarint(cursor, end, &literal_len)) ||
+        zero_run > size - i || literal_len > size - i - zero_run ||
+        literal_len > (u64)(end - cursor)) {
+      STATUS_LOG(FAILURE, "Corrupt snapshot delta of tick: %zu.", tick);
+      return FAILURE;
+    }
+    i += zero_run;
+    for (u64 j = 0; j < literal_len; j++) {
+      target->mem[i + j] ^= cursor[j];
+    }
+    cursor += literal_len;
+    i += literal_len;
+  }
+
+  target->tick = tick;
+  target->size = size;
+
+  return SUCCESS;
+}
+
+StatusCode ecs_SnapshotDeltaWrite(int fd, const u8 *delta, u64 delta_size) {
+  NULL_FUNC_ARG_ROUTINE(delta, NULL_EXCEPTION);
+
+  // Framed by its size, so the reader knows where each delta ends.
+  u8 frame[VARINT_MAX_SIZE];
+  u8 *frame_end = WriteVarint(frame, frame + sizeof(frame), delta_size);
+  const u8 *parts[] = {frame, delta};
+  u64 part_sizes[] = {(u64)(frame_end - frame), delta_size};
+
+  for (u64 part = 0; part < 2; part++) {
+    for (u64 written = 0; written < part_sizes[part];) {
+      ssize_t n =
+          write(fd, parts[part] + written, part_sizes[part] - written);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        STATUS_LOG(FAILURE, "Cannot write snapshot delta: %s.",
+                   strerror(errno));
+        return FAILURE;
+      }
+      written += (u64)n;
+    }
+  }
+
+  return SUCCESS;
+}
+
+StatusCode ecs_SnapshotDeltaRead(int fd, u8 *dest, u64 dest_cap,
+                                 u64 *delta_size) {
+  NULL_FUNC_ARG_ROUTINE(dest, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(delta_size, NULL_EXCEPTION);
+  *delta_size = 0;
+
+  // The frame's varint, a byte at a time so nothing past it is consumed.
+  u8 frame[VARINT_MAX_SIZE];
+  u64 frame_len = 0;
+  for (;;) {
+    if (frame_len == VARINT_MAX_SIZE) {
+      STATUS_LOG(FAILURE, "Corrupt snapshot delta frame.");
+      return FAILURE;
+    }
+    ssize_t n = read(fd, &frame[frame_len], 1);
+    if (n < 0 && errno == EINTR) {
+      // Nothing was read, frame_len only moves past bytes that were.
+      continue;
+    }
+    if (n == 0 && frame_len == 0) {
+      // Clean end of the stream.
+      return WARNING;
+    }
+    if (n <= 0) {
+      STATUS_LOG(FAILURE, "Cannot read snapshot delta frame.");
+      return FAILURE;
+    }
+    if (!(frame[frame_len++] & 0x80)) {
+      break;
+    }
+  }
+
+  u64 size = 0;
+  ReadVarint(frame, frame + frame_len, &size);
+  if (size > dest_cap) {
+    STATUS_LOG(FAILURE, "Snapshot delta of: %zu bytes doesn't fit in: %zu.",
+               size, dest_cap);
+    return FAILURE;
+  }
+  for (u64 read_size = 0; read_size < size;) {
+    ssize_t n = read(fd, dest + read_size, size - read_size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      STATUS_LOG(FAILURE, "Snapshot delta stream ended mid delta.");
+      return FAILURE;
+    }
+    read_size += (u64)n;
+  }
+  *delta_size = size;
+
+  return SUCCESS;
+}
 
 /* ----  INIT/EXIT FUNCTIONS  ---- */
 
-#define INIT_FAILED_ROUTINE(x)                                                 \
+#define INIT_FAILED_ROUTINE(world, x)                                          \
   do {                                                                         \
     IF_NULL((x)) {                                                             \
-      ecs_Exit();                                                              \
-      MEM_ALLOC_FAILURE_SUB_ROUTINE(x, CREATION_FAILURE);                      \
+      ecs_WorldDelete(world);                                                  \
+      MEM_ALLOC_FAILURE_SUB_ROUTINE(x, NULL);                                  \
     }                                                                          \
   } while (0)
 
-StatusCode ecs_Init(void) {
-  ecs_state = calloc(1, sizeof(EcsState));
-  INIT_FAILED_ROUTINE(ecs_state);
+EcsWorld *ecs_WorldCreate(const EcsConfig *config) {
+  NULL_FUNC_ARG_ROUTINE(config, NULL);
+  u64 prop_count = (config->prop_count) ? config->prop_count
+                                        : DEFAULT_PROP_COUNT;
+  u64 layout_count = (config->layout_count) ? config->layout_count
+                                            : DEFAULT_ARENA_COUNT;
+  u64 signature_count = (config->signature_count) ? config->signature_count
+                                                  : DEFAULT_ARENA_COUNT;
+  u64 entity_count = (config->entity_count) ? config->entity_count
+                                            : DEFAULT_ARENA_COUNT;
+  u64 layout_entity_count = (config->layout_entity_count)
+                                ? config->layout_entity_count
+                                : DEFAULT_LAYOUT_ENTITY_COUNT;
+
+  Allocator allocator = mem_HeapAllocatorWCategory(MEM_CATEGORY_ECS);
+  EcsWorld *world = mem_Calloc(&allocator, sizeof(EcsWorld));
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(world, NULL);
+
+  pthread_mutex_lock(&ecs_slab_lock);
+  if (!ecs_slab) {
+    ecs_slab = mem_SlabArenaCreateWCategory(MEM_CATEGORY_ECS);
+  }
+  SlabArena *slab = ecs_slab;
+  if (slab) {
+    world_count++;
+  }
+  pthread_mutex_unlock(&ecs_slab_lock);
+  IF_NULL(slab) {
+    mem_Free(&allocator, world, sizeof(EcsWorld));
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(ecs_slab, NULL);
+  }
+
+  world->allocator = mem_SlabArenaAllocator(slab);
+  world->layout_slot_count = ALIGN_UP(layout_entity_count, CHUNK_ARR_CAP);
 
-  ecs_state->layout_arena = mem_PoolArenaCreate(sizeof(Layout));
-  INIT_FAILED_ROUTINE(ecs_state->layout_arena);
+  world->layout_arena = mem_PoolArenaCreateWCategory(
+      sizeof(Layout), layout_count, MEM_BACKING_DEFAULT, MEM_CATEGORY_ECS);
+  INIT_FAILED_ROUTINE(world, world->layout_arena);
 
-  ecs_state->entity_arena = mem_PoolArenaCreate(sizeof(Entity));
-  INIT_FAILED_ROUTINE(ecs_state->entity_arena);
+  world->entity_arena = mem_PoolArenaCreateWCategory(
+      sizeof(Entity), entity_count, MEM_BACKING_DEFAULT, MEM_CATEGORY_ECS);
+  INIT_FAILED_ROUTINE(world, world->entity_arena);
 
-  ecs_state->props_signature_arena =
-      mem_PoolArenaCreate(sizeof(PropsSignature));
-  INIT_FAILED_ROUTINE(ecs_state->props_signature_arena);
+  world->props_signature_arena =
+      mem_PoolArenaCreateWCategory(sizeof(PropsSignature), signature_count,
+                                   MEM_BACKING_DEFAULT, MEM_CATEGORY_ECS);
+  INIT_FAILED_ROUTINE(world, world->props_signature_arena);
 
   /*
    * Hashmap maps PropSignature to Layout. The layout will also be stored
@@ -674,49 +1952,129 @@ StatusCode ecs_Init(void) {
    * signature inside the layout, as we return the layout to the user and we
    * need a way to check what type of layout it is.
    */
-  ecs_state->ecs = hm_Create(PropsSignatureHashFunc, PropsSignatureCmpFunc,
-                             PropSignatureDeleteCallback, LayoutDeleteCallback);
-  INIT_FAILED_ROUTINE(ecs_state->ecs);
+  world->ecs = hm_CreateWAllocator(
+      PropsSignatureHashFunc, PropsSignatureCmpFunc,
+      PropSignatureDeleteCallback, LayoutDeleteCallback, &world->allocator);
+  INIT_FAILED_ROUTINE(world, world->ecs);
+  IF_FUNC_FAILED(WorldLayouts_Init(&world->layouts, layout_count,
+                                   &world->allocator)) {
+    ecs_WorldDelete(world);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(world->layouts, NULL);
+  }
+  IF_FUNC_FAILED(WorldEntities_Init(&world->entities, entity_count,
+                                    &world->allocator)) {
+    ecs_WorldDelete(world);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(world->entities, NULL);
+  }
+  IF_FUNC_FAILED(EntityLocations_Init(&world->entity_locations, entity_count,
+                                      &world->allocator)) {
+    ecs_WorldDelete(world);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(world->entity_locations, NULL);
+  }
+  IF_FUNC_FAILED(U64Vec_Init(&world->free_entity_indices,
+                             world->entity_locations.cap,
+                             &world->allocator)) {
+    ecs_WorldDelete(world);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(world->free_entity_indices, NULL);
+  }
+  IF_FUNC_FAILED(U64Vec_Init(&world->snapshot_check_bitset, 1,
+                             &world->allocator)) {
+    ecs_WorldDelete(world);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(world->snapshot_check_bitset, NULL);
+  }
+  world->snapshot_check_bitset.mem[0] = 0;
+  IF_FUNC_FAILED(hm_Reserve(world->ecs, layout_count)) {
+    ecs_WorldDelete(world);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(world->ecs, NULL);
+  }
 
-  IF_FUNC_FAILED(PropsMetadataCreate()) {
-    ecs_Exit();
+  IF_FUNC_FAILED(PropsMetadataCreate(world, prop_count)) {
+    ecs_WorldDelete(world);
     STATUS_LOG(CREATION_FAILURE,
                "Failed to create metadata table for the ecs.");
-    return CREATION_FAILURE;
+    return NULL;
   }
-  PopulateBuiltinPropsMetadata();
+  PopulateBuiltinPropsMetadata(world);
 
-  ecs_state->signature_hash_seed = time(NULL);
+  world->signature_hash_seed = time(NULL);
 
-  return SUCCESS;
+  return world;
 }
 
-StatusCode ecs_Exit(void) {
-  IF_NULL(ecs_state) { return SUCCESS; }
+StatusCode ecs_WorldDelete(EcsWorld *world) {
+  NULL_FUNC_ARG_ROUTINE(world, NULL_EXCEPTION);
 
-  if (ecs_state->entity_arena) {
-    mem_PoolArenaDelete(ecs_state->entity_arena);
+  if (world->entity_arena) {
+    // Every handle is listed, so they all go here.
+    for (u64 i = 0; i < WorldEntities_Len(&world->entities); i++) {
+      mem_PoolArenaFreeUnchecked(world->entity_arena, world->entities.mem[i]);
+    }
+    mem_PoolArenaDelete(world->entity_arena);
   }
-  if (ecs_state->ecs) {
+  WorldEntities_Deinit(&world->entities);
+  EntityLocations_Deinit(&world->entity_locations);
+  U64Vec_Deinit(&world->free_entity_indices);
+  U64Vec_Deinit(&world->snapshot_check_bitset);
+  // Emptied first, so the layouts being deleted don't have to unlist.
+  WorldLayouts_Deinit(&world->layouts);
+  if (world->ecs) {
     // If ecs is created means that the layout arena was created first, and
     // the callbacks are valid.
-    hm_Delete(ecs_state->ecs);
+    hm_Delete(world->ecs);
   }
   /*
    * layout and signature arenas will be freed after attempting the ecs
    * deletion, as ecs deletion will free internal allocations from these
    * arenas.
    */
-  if (ecs_state->layout_arena) {
-    mem_PoolArenaDelete(ecs_state->layout_arena);
+  if (world->layout_arena) {
+    mem_PoolArenaDelete(world->layout_arena);
+  }
+  if (world->props_signature_arena) {
+    mem_PoolArenaDelete(world->props_signature_arena);
+  }
+  PropsMetadataDelete(world);
+
+  Allocator allocator = mem_HeapAllocatorWCategory(MEM_CATEGORY_ECS);
+  mem_Free(&allocator, world, sizeof(EcsWorld));
+
+  // Everything the ecs allocated has to be gone once no world is left.
+  pthread_mutex_lock(&ecs_slab_lock);
+  if (!--world_count) {
+    mem_SlabArenaDelete(ecs_slab);
+    ecs_slab = NULL;
+    mem_StatsReportLeaks(MEM_CATEGORY_ECS);
   }
-  if (ecs_state->props_signature_arena) {
-    mem_PoolArenaDelete(ecs_state->props_signature_arena);
+  pthread_mutex_unlock(&ecs_slab_lock);
+
+  return SUCCESS;
+}
+
+StatusCode ecs_Init(void) { return ecs_InitWConfig(&(EcsConfig){0}); }
+
+StatusCode ecs_InitWConfig(const EcsConfig *config) {
+  NULL_FUNC_ARG_ROUTINE(config, NULL_EXCEPTION);
+  if (default_world) {
+    STATUS_LOG(FAILURE, "The ecs has already been initialized.");
+    return FAILURE;
   }
-  PropsMetadataDelete();
 
-  free(ecs_state);
-  ecs_state = NULL;
+  default_world = ecs_WorldCreate(config);
+  IF_NULL(default_world) {
+    STATUS_LOG(CREATION_FAILURE, "Failed to create the default world.");
+    return CREATION_FAILURE;
+  }
 
   return SUCCESS;
 }
+
+EcsWorld *ecs_DefaultWorld(void) { return default_world; }
+
+StatusCode ecs_Exit(void) {
+  IF_NULL(default_world) { return SUCCESS; }
+
+  StatusCode code = ecs_WorldDelete(default_world);
+  default_world = NULL;
+
+  return code;
+}
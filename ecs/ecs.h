@@ -5,8 +5,20 @@ extern "C" {
 #endif
 
 #include "../utils/common.h"
+#include "../utils/mem.h"
 #include "../utils/status.h"
 
+/*
+ * A whole independent ecs, with its own arenas, layouts and props. Layouts,
+ * entities and signatures belong to the world they were created in, and the
+ * functions taking them work on that world. Only the functions that create
+ * props and signatures out of nothing have a world variant; the ones without
+ * it use the default world (see ecs_Init).
+ *
+ * A world is not thread safe, but different worlds can be used from different
+ * threads at the same time, e.g. one world per core.
+ */
+typedef struct __EcsWorld EcsWorld;
 typedef struct __Layout Layout;
 typedef struct __Entity Entity;
 /*
@@ -39,7 +51,9 @@ typedef enum {
 } PropsSignatureHandleMode;
 
 PropId ecs_PropIdCreate(u64 prop_struct_size);
+PropId ecs_WorldPropIdCreate(EcsWorld *world, u64 prop_struct_size);
 PropsSignature *ecs_PropSignatureCreate(void);
+PropsSignature *ecs_WorldPropSignatureCreate(EcsWorld *world);
 StatusCode ecs_PropsSignatureDelete(PropsSignature *signature);
 StatusCode ecs_HandlePropIdToPropSignatures(PropsSignature *signature,
                                             PropId id,
@@ -55,7 +69,23 @@ typedef enum {
 
 Layout *ecs_LayoutCreate(PropsSignature *signature,
                          DuplicatePropsSignatureHandleMode mode);
+/*
+ * The layout's chunks take their memory from backing, e.g. huge pages on the
+ * NUMA node of the thread that will iterate it. Only applies when the layout
+ * gets created, an existing layout for the signature is returned as is.
+ */
+Layout *ecs_LayoutCreateWBacking(PropsSignature *signature,
+                                 DuplicatePropsSignatureHandleMode mode,
+                                 MemBacking backing);
 StatusCode ecs_LayoutDelete(Layout *layout);
+/*
+ * Reorders the entities of the layout by key_func of their id prop, ascending,
+ * and packs them to the front of the layout. Every prop moves along and the
+ * entity handles are updated, but prop pointers taken before the sort now
+ * point at whichever entity took that slot.
+ */
+StatusCode ecs_LayoutSortBy(Layout *layout, PropId id,
+                            u64 (*key_func)(const void *prop_data));
 
 /* ----  ENTITY RELATED FUNCTIONS  ---- */
 
@@ -64,10 +94,119 @@ Entity *ecs_CreateEntity(PropsSignature *signature,
                          DuplicatePropsSignatureHandleMode mode);
 StatusCode ecs_DeleteEntity(Entity *entity);
 void *ecs_GetPropDataFromEntity(Entity *entity, PropId id);
+/*
+ * A deleted entity's slot, handle and id index go to the next entity created,
+ * so the world only holds as many as are alive at once. The handle then refers
+ * to the new entity, keep ids of entities that may get deleted instead.
+ *
+ * An id is the entity's index (low 32 bits) and the generation of that index
+ * (high 32 bits), bumped every time an entity there is deleted. So an id stays
+ * unique to its entity, and can be sent to other processes, see the snapshots
+ * below. INVALID_INDEX for a deleted entity.
+ */
+u64 ecs_EntityId(const Entity *entity);
+// NULL if the entity of the id has been deleted.
+Entity *ecs_WorldEntityFromId(EcsWorld *world, u64 id);
+
+/* ----  SNAPSHOT RELATED FUNCTIONS  ---- */
+
+/*
+ * A fixed number of preallocated, fixed size world snapshots, for rollback.
+ * Every tick snapshots into slot tick % snapshot_count, overwriting the
+ * snapshot from snapshot_count ticks ago.
+ *
+ * A snapshot holds every layout's chunks and free slots, and where each entity
+ * index lives with its generation, so a restore brings back every entity
+ * (props included) alive at that tick under the same id, and deletes the ones
+ * created since. Handles keep to their index across restores.
+ * Props registered and layouts created since are kept (the layouts emptied),
+ * and layouts deleted since are created again.
+ *
+ * Snapshots hold no pointers, layouts are stored by their props and entities
+ * by their index. So they restore into any world that registered the same props
+ * in the same order, e.g. a replay loaded in a later run or a spectator in
+ * another process, as long as that world only gets its entities from the
+ * snapshots (see ecs_WorldEntityFromId). Both ends need the same architecture.
+ */
+typedef struct __EcsSnapshotRing EcsSnapshotRing;
+
+// snapshot_size is in bytes, see ecs_WorldSnapshotSize.
+EcsSnapshotRing *ecs_SnapshotRingCreate(u64 snapshot_count,
+                                        u64 snapshot_size);
+StatusCode ecs_SnapshotRingDelete(EcsSnapshotRing *ring);
+// Bytes a snapshot of the world would take right now.
+u64 ecs_WorldSnapshotSize(const EcsWorld *world);
+// Fails if the world has outgrown the ring's snapshot_size.
+StatusCode ecs_WorldSnapshot(EcsWorld *world, EcsSnapshotRing *ring,
+                             u64 tick);
+/*
+ * Only allocates for what the world never held, so restoring into the world
+ * the snapshot was taken from doesn't, unless a layout was deleted since.
+ * Fails if the snapshot of tick has been overwritten, or is of props the world
+ * doesn't have. A snapshot from a delta is checked whole on its first restore,
+ * and fails it if corrupt.
+ */
+StatusCode ecs_WorldRestore(EcsWorld *world, EcsSnapshotRing *ring,
+                            u64 tick);
+
+/*
+ * Deltas between snapshots, for streaming world state to replays or other
+ * processes. A delta is the byte wise XOR of a snapshot against an older one
+ * (its base), with the unchanged runs taken out, so its size follows what
+ * changed rather than the size of the world.
+ *
+ * The receiving side applies deltas to its own ring, which rebuilds the exact
+ * snapshot as long as it holds the delta's base. A stream starts with a
+ * keyframe (base_tick of ECS_SNAPSHOT_DELTA_KEYFRAME), which encodes the
+ * whole snapshot and needs no base.
+ */
+#define ECS_SNAPSHOT_DELTA_KEYFRAME ((u64)(-1))
+
+// Biggest delta the ring's snapshots can encode to, to size buffers with.
+u64 ecs_SnapshotDeltaMaxSize(const EcsSnapshotRing *ring);
+// Returns the bytes written to dest, 0 on failure.
+u64 ecs_SnapshotDeltaEncode(const EcsSnapshotRing *ring, u64 base_tick,
+                            u64 tick, u8 *dest, u64 dest_cap);
+// Writes the delta's snapshot into its tick's slot in ring.
+StatusCode ecs_SnapshotDeltaApply(EcsSnapshotRing *ring, const u8 *delta,
+                                  u64 delta_size);
+// Writes the delta to fd (a file, pipe or socket), framed with its size.
+StatusCode ecs_SnapshotDeltaWrite(int fd, const u8 *delta, u64 delta_size);
+// Reads the next delta of the stream, WARNING once the stream has ended.
+StatusCode ecs_SnapshotDeltaRead(int fd, u8 *dest, u64 dest_cap,
+                                 u64 *delta_size);
 
 /* ----  INIT/EXIT FUNCTIONS  ---- */
 
+/*
+ * Expected sizes of the world, so everything gets allocated at once on init
+ * (and on layout creation) instead of growing while the world fills up. A
+ * world that stays within them never grows at runtime. 0 keeps the default of
+ * any field, going over a size only means growing from there as usual.
+ */
+typedef struct {
+  // Registered props, presizes the prop metadata table.
+  u64 prop_count;
+  // Layouts (unique prop signatures), presizes the layout map and arena.
+  u64 layout_count;
+  // Prop signatures alive at once, those owned by layouts included.
+  u64 signature_count;
+  // Entities alive at once in the whole world, presizes the entity tables.
+  u64 entity_count;
+  // Entities per layout, every layout presizes its chunks for that many.
+  u64 layout_entity_count;
+} EcsConfig;
+
+EcsWorld *ecs_WorldCreate(const EcsConfig *config);
+// Frees everything created in the world.
+StatusCode ecs_WorldDelete(EcsWorld *world);
+
+// Creates the default world.
 StatusCode ecs_Init(void);
+StatusCode ecs_InitWConfig(const EcsConfig *config);
+// NULL before ecs_Init.
+EcsWorld *ecs_DefaultWorld(void);
+// Deletes the default world.
 StatusCode ecs_Exit(void);
 
 #ifdef __cplusplus
@@ -1,5 +1,231 @@
+// For nanosleep and clock_gettime, which are hidden by -std=c17 otherwise.
+#define _POSIX_C_SOURCE 200809L
+
 #include "engine.h"
 #include "../ecs/ecs.h"
+#include "../utils/mem.h"
+#include <time.h>
+
+// Weight of the latest frame in the phase averages.
+#define PHASE_AVG_WEIGHT (0.05)
+
+typedef struct {
+  StatusCode (*system_func)(f64 dt, void *ctx);
+  void *ctx;
+} EngineSystem;
+
+typedef struct {
+  EngineSystem systems[ENGINE_PHASE_COUNT][ENGINE_MAX_PHASE_SYSTEMS];
+  u64 system_counts[ENGINE_PHASE_COUNT];
+  EngineLoopConfig config;
+  EngineLoopStats stats;
+  // Time not yet simulated by fixed steps.
+  f64 accumulator;
+  f64 last_frame_start;
+  bool started;
+  bool running;
+} EngineLoop;
+
+static EngineLoop engine_loop = {.config = ENGINE_LOOP_CONFIG_DEFAULT};
+
+static f64 GetTime(void);
+static void SleepFor(f64 seconds);
+static StatusCode RunPhase(EnginePhases phase, f64 dt, f64 *phase_time);
+static void RecordPhaseTime(EnginePhases phase, f64 phase_time);
+
+StatusCode engine_Init(void) {
+  EngineConfig config = ENGINE_CONFIG_DEFAULT;
+
+  return engine_InitWConfig(&config);
+}
+
+StatusCode engine_InitWConfig(const EngineConfig *config) {
+  NULL_FUNC_ARG_ROUTINE(config, NULL_EXCEPTION);
+
+  IF_FUNC_FAILED(engine_LoopSetConfig(&config->loop)) { return FAILURE; }
+
+  return ecs_InitWConfig(&config->ecs);
+}
+
+StatusCode engine_Exit(void) {
+  StatusCode code = ecs_Exit();
+
+  // The engine is the last owner of anything, so whatever is left leaked.
+  for (MemCategories category = 0; category < MEM_CATEGORY_COUNT; category++) {
+    mem_StatsReportLeaks(category);
+  }
+  // Stops the logging thread if async logging was on, writing what's left.
+  status_LogSetMode(STATUS_LOG_SYNC);
+
+  return code;
+}
+
+/* ----  FRAME LOOP  ---- */
+
+// Seconds, monotonic.
+static f64 GetTime(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (f64)now.tv_sec + (f64)now.tv_nsec * 1e-9;
+}
+
+static void SleepFor(f64 seconds) {
+  struct timespec duration = {.tv_sec = (time_t)seconds};
+  duration.tv_nsec = (long)((seconds - (f64)duration.tv_sec) * 1e9);
+  nanosleep(&duration, NULL);
+}
+
+// Adds the time the phase took to phase_time.
+static StatusCode RunPhase(EnginePhases phase, f64 dt, f64 *phase_time) {
+  f64 start = GetTime();
+
+  for (u64 i = 0; i < engine_loop.system_counts[phase]; i++) {
+    EngineSystem *system = &engine_loop.systems[phase][i];
+    StatusCode code = system->system_func(dt, system->ctx);
+    if (code != SUCCESS && code != WARNING) {
+      STATUS_LOG(code, "System %zu of phase %d failed, stopping the loop.", i,
+                 phase);
+      *phase_time += GetTime() - start;
+      return code;
+    }
+  }
+  *phase_time += GetTime() - start;
+
+  return SUCCESS;
+}
+
+static void RecordPhaseTime(EnginePhases phase, f64 phase_time) {
+  EnginePhaseStats *stats = &engine_loop.stats.phases[phase];
+
+  stats->last_time = phase_time;
+  stats->avg_time = (stats->runs)
+                        ? stats->avg_time +
+                              (phase_time - stats->avg_time) * PHASE_AVG_WEIGHT
+                        : phase_time;
+  stats->max_time = MAX(stats->max_time, phase_time);
+  stats->runs++;
+}
+
+StatusCode engine_RegisterSystem(EnginePhases phase,
+                                 StatusCode (*system_func)(f64 dt, void *ctx),
+                                 void *ctx) {
+  NULL_FUNC_ARG_ROUTINE(system_func, NULL_EXCEPTION);
+  if (phase >= ENGINE_PHASE_COUNT) {
+    STATUS_LOG(OUT_OF_BOUNDS_ACCESS, "Invalid phase: %d.", phase);
+    return OUT_OF_BOUNDS_ACCESS;
+  }
+  if (engine_loop.system_counts[phase] >= ENGINE_MAX_PHASE_SYSTEMS) {
+    STATUS_LOG(FAILURE, "Phase %d already has the max of %d systems.", phase,
+               ENGINE_MAX_PHASE_SYSTEMS);
+    return FAILURE;
+  }
+
+  engine_loop.systems[phase][engine_loop.system_counts[phase]++] =
+      (EngineSystem){.system_func = system_func, .ctx = ctx};
+
+  return SUCCESS;
+}
+
+StatusCode engine_LoopSetConfig(const EngineLoopConfig *config) {
+  NULL_FUNC_ARG_ROUTINE(config, NULL_EXCEPTION);
+  if (!(config->fixed_dt >= 0) || !(config->frame_budget >= 0)) {
+    STATUS_LOG(FAILURE, "Invalid loop config, fixed_dt and frame_budget must "
+                        "be at least 0.");
+    return FAILURE;
+  }
+
+  // Same as EcsConfig, 0 keeps the default.
+  EngineLoopConfig defaults = ENGINE_LOOP_CONFIG_DEFAULT;
+  engine_loop.config = (EngineLoopConfig){
+      .fixed_dt = (config->fixed_dt) ? config->fixed_dt : defaults.fixed_dt,
+      .max_fixed_steps = (config->max_fixed_steps) ? config->max_fixed_steps
+                                                   : defaults.max_fixed_steps,
+      .frame_budget = config->frame_budget};
+
+  return SUCCESS;
+}
+
+StatusCode engine_RunFrame(void) {
+  const EngineLoopConfig *config = &engine_loop.config;
+  EngineLoopStats *stats = &engine_loop.stats;
+
+  f64 frame_start = GetTime();
+  // The first frame has nothing to measure against.
+  f64 dt = (engine_loop.started) ? frame_start - engine_loop.last_frame_start
+                                 : 0;
+  engine_loop.last_frame_start = frame_start;
+  engine_loop.started = true;
+  engine_loop.accumulator += dt;
+
+  f64 phase_times[ENGINE_PHASE_COUNT] = {0};
+  StatusCode code = SUCCESS;
+
+  code = RunPhase(ENGINE_PHASE_PRE_UPDATE, dt,
+                  &phase_times[ENGINE_PHASE_PRE_UPDATE]);
+
+  u32 steps = 0;
+  while (code == SUCCESS && engine_loop.accumulator >= config->fixed_dt &&
+         steps < config->max_fixed_steps) {
+    code = RunPhase(ENGINE_PHASE_FIXED_UPDATE, config->fixed_dt,
+                    &phase_times[ENGINE_PHASE_FIXED_UPDATE]);
+    engine_loop.accumulator -= config->fixed_dt;
+    steps++;
+  }
+  stats->fixed_step_count += steps;
+  if (engine_loop.accumulator >= config->fixed_dt) {
+    u64 dropped = (u64)(engine_loop.accumulator / config->fixed_dt);
+    engine_loop.accumulator -= (f64)dropped * config->fixed_dt;
+    stats->dropped_fixed_steps += dropped;
+  }
+  stats->fixed_alpha = engine_loop.accumulator / config->fixed_dt;
+
+  for (EnginePhases phase = ENGINE_PHASE_UPDATE;
+       code == SUCCESS && phase < ENGINE_PHASE_COUNT; phase++) {
+    code = RunPhase(phase, dt, &phase_times[phase]);
+  }
+
+  for (EnginePhases phase = 0; phase < ENGINE_PHASE_COUNT; phase++) {
+    RecordPhaseTime(phase, phase_times[phase]);
+  }
+  stats->last_frame_time = GetTime() - frame_start;
+  if (config->frame_budget > 0 &&
+      stats->last_frame_time > config->frame_budget) {
+    stats->over_budget_count++;
+  }
+  stats->frame_count++;
+
+  return code;
+}
+
+StatusCode engine_Run(void) {
+  StatusCode code = SUCCESS;
+
+  engine_loop.running = true;
+  while (engine_loop.running) {
+    code = engine_RunFrame();
+    IF_FUNC_FAILED(code) { break; }
+
+    f64 budget = engine_loop.config.frame_budget;
+    if (budget > 0 && engine_loop.stats.last_frame_time < budget) {
+      SleepFor(budget - engine_loop.stats.last_frame_time);
+    }
+  }
+  engine_loop.running = false;
+
+  return code;
+}
+
+StatusCode engine_Stop(void) {
+  engine_loop.running = false;
+
+  return SUCCESS;
+}
+
+EngineLoopStats engine_LoopStatsGet(void) { return engine_loop.stats; }
+
+StatusCode engine_LoopStatsReset(void) {
+  engine_loop.stats = (EngineLoopStats){0};
 
-StatusCode engine_Init(void) { return ecs_Init(); }
-StatusCode engine_Exit(void) { return ecs_Exit(); }
+  return SUCCESS;
+}
@@ -4,9 +4,105 @@
 extern "C" {
 #endif
 
+#include "../ecs/ecs.h"
 #include "../utils/status.h"
 
+/* ----  FRAME LOOP  ---- */
+
+/*
+ * Every frame runs the phases in order. ENGINE_PHASE_FIXED_UPDATE runs as many
+ * times as fixed_dt steps fit in the time passed (so 0 or more times), with
+ * fixed_dt as dt, the others run exactly once with the real frame time as dt.
+ */
+typedef enum {
+  ENGINE_PHASE_PRE_UPDATE,
+  // The simulation, deterministic as its dt never changes.
+  ENGINE_PHASE_FIXED_UPDATE,
+  ENGINE_PHASE_UPDATE,
+  ENGINE_PHASE_POST_UPDATE,
+  ENGINE_PHASE_END_OF_FRAME,
+  ENGINE_PHASE_COUNT
+} EnginePhases;
+
+#define ENGINE_MAX_PHASE_SYSTEMS (32)
+
+typedef struct {
+  // Seconds per simulation step.
+  f64 fixed_dt;
+  /*
+   * Max fixed steps in one frame. When a frame falls further behind than that,
+   * the rest of the time is dropped, so the simulation slows down instead of
+   * every next frame having even more steps to catch up on.
+   */
+  u32 max_fixed_steps;
+  /*
+   * Seconds per frame engine_Run aims for, sleeping out whatever is left of
+   * it. 0 runs frames back to back.
+   */
+  f64 frame_budget;
+} EngineLoopConfig;
+
+#define ENGINE_LOOP_CONFIG_DEFAULT                                             \
+  ((EngineLoopConfig){                                                         \
+      .fixed_dt = 1.0 / 60.0, .max_fixed_steps = 4, .frame_budget = 0})
+
+typedef struct {
+  // Seconds, of the phase's last frame (summed over its fixed steps).
+  f64 last_time;
+  // Moving average of last_time.
+  f64 avg_time;
+  f64 max_time;
+  u64 runs;
+} EnginePhaseStats;
+
+typedef struct {
+  u64 frame_count;
+  u64 fixed_step_count;
+  // Fixed steps skipped due to max_fixed_steps.
+  u64 dropped_fixed_steps;
+  // Frames that took longer than frame_budget.
+  u64 over_budget_count;
+  // Seconds spent running the last frame's phases, sleep excluded.
+  f64 last_frame_time;
+  /*
+   * How far into the next fixed step the last frame ended, in [0, 1), to
+   * interpolate the rendered state between the last two simulation steps.
+   */
+  f64 fixed_alpha;
+  EnginePhaseStats phases[ENGINE_PHASE_COUNT];
+} EngineLoopStats;
+
+/*
+ * Systems run in the order they were registered in, and whatever they return
+ * other than SUCCESS or WARNING stops the loop with that code. Not thread
+ * safe, register before running the loop (or from a system).
+ */
+StatusCode engine_RegisterSystem(EnginePhases phase,
+                                 StatusCode (*system_func)(f64 dt, void *ctx),
+                                 void *ctx);
+// A 0 fixed_dt or max_fixed_steps keeps its default, so partial configs work.
+StatusCode engine_LoopSetConfig(const EngineLoopConfig *config);
+// Runs frames until engine_Stop is called or a system fails.
+StatusCode engine_Run(void);
+// Runs a single frame, for callers that own their main loop.
+StatusCode engine_RunFrame(void);
+// Makes engine_Run return after the current frame.
+StatusCode engine_Stop(void);
+EngineLoopStats engine_LoopStatsGet(void);
+StatusCode engine_LoopStatsReset(void);
+
+/* ----  INIT/EXIT FUNCTIONS  ---- */
+
+typedef struct {
+  EcsConfig ecs;
+  EngineLoopConfig loop;
+} EngineConfig;
+
+#define ENGINE_CONFIG_DEFAULT                                                  \
+  ((EngineConfig){.ecs = {0}, .loop = ENGINE_LOOP_CONFIG_DEFAULT})
+
 StatusCode engine_Init(void);
+StatusCode engine_InitWConfig(const EngineConfig *config);
 StatusCode engine_Exit(void);
 
 #ifdef __cplusplus
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdio.h>
+
+/*
+ * Minimal checks for the tests/ programs, every failed CHECK is printed and the
+ * program exits with 1 once done, so `make check` stops at it.
+ */
+static int test_failures = 0;
+
+#define CHECK(x)                                                               \
+  do {                                                                         \
+    if (!(x)) {                                                                \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed.\n", __FILE__, __LINE__, #x);   \
+      test_failures++;                                                         \
+    }                                                                          \
+  } while (0)
+
+#define TEST_RESULT() (test_failures ? 1 : 0)
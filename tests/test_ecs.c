@@ -0,0 +1,96 @@
+#include "../ecs/ecs.h"
+#include "test.h"
+
+#define CHURN_COUNT (1 << 20)
+#define ALIVE_COUNT (64)
+
+static Layout *CreateLayout(EcsWorld *world, PropId id) {
+  PropsSignature *signature = ecs_WorldPropSignatureCreate(world);
+  ecs_HandlePropIdToPropSignatures(signature, id, PROP_SIGNATURE_ATTACH);
+
+  return ecs_LayoutCreate(signature, DUPLICATE_PROPS_SIGNATURE_FREE);
+}
+
+// Spawning and despawning forever only takes the memory of those alive.
+static void TestEntityChurn(void) {
+  EcsWorld *world = ecs_WorldCreate(&(EcsConfig){0});
+  PropId num = ecs_WorldPropIdCreate(world, sizeof(u64));
+  Layout *layout = CreateLayout(world, num);
+  CHECK(layout);
+
+  Entity *alive[ALIVE_COUNT];
+  for (u64 i = 0; i < ALIVE_COUNT; i++) {
+    alive[i] = ecs_CreateEntityFromLayout(layout);
+  }
+  u64 live_bytes = mem_StatsGet(MEM_CATEGORY_ECS).live_bytes;
+  for (u64 i = 0; i < CHURN_COUNT; i++) {
+    Entity **entity = &alive[i % ALIVE_COUNT];
+    CHECK(ecs_DeleteEntity(*entity) == SUCCESS);
+    *entity = ecs_CreateEntityFromLayout(layout);
+    *(u64 *)ecs_GetPropDataFromEntity(*entity, num) = i;
+  }
+  CHECK(mem_StatsGet(MEM_CATEGORY_ECS).live_bytes == live_bytes);
+  // The indices keep going round, only their generations grow.
+  for (u64 i = 0; i < ALIVE_COUNT; i++) {
+    u64 id = ecs_EntityId(alive[i]);
+    CHECK((id & 0xffffffff) < ALIVE_COUNT);
+    CHECK(ecs_WorldEntityFromId(world, id) == alive[i]);
+  }
+
+  ecs_WorldDelete(world);
+}
+
+static void TestStaleIds(void) {
+  EcsWorld *world = ecs_WorldCreate(&(EcsConfig){0});
+  PropId num = ecs_WorldPropIdCreate(world, sizeof(u64));
+  Layout *layout = CreateLayout(world, num);
+
+  Entity *entity = ecs_CreateEntityFromLayout(layout);
+  u64 id = ecs_EntityId(entity);
+  CHECK(ecs_WorldEntityFromId(world, id) == entity);
+  ecs_DeleteEntity(entity);
+  CHECK(!ecs_WorldEntityFromId(world, id));
+  CHECK(ecs_EntityId(entity) == INVALID_INDEX);
+  CHECK(ecs_DeleteEntity(entity) == USE_AFTER_FREE);
+
+  // The index and handle go to the next entity, under a new id.
+  Entity *next = ecs_CreateEntityFromLayout(layout);
+  u64 next_id = ecs_EntityId(next);
+  CHECK(next == entity);
+  CHECK(next_id != id && (next_id & 0xffffffff) == (id & 0xffffffff));
+  CHECK(!ecs_WorldEntityFromId(world, id));
+  CHECK(ecs_WorldEntityFromId(world, next_id) == next);
+
+  ecs_WorldDelete(world);
+}
+
+// Deleting a layout deletes its entities, and keeps the other layouts' intact.
+static void TestLayoutDelete(void) {
+  EcsWorld *world = ecs_WorldCreate(&(EcsConfig){0});
+  PropId num = ecs_WorldPropIdCreate(world, sizeof(u64));
+  PropId other = ecs_WorldPropIdCreate(world, sizeof(u32));
+  Layout *first = CreateLayout(world, num);
+  Layout *second = CreateLayout(world, other);
+
+  Entity *doomed = ecs_CreateEntityFromLayout(first);
+  u64 doomed_id = ecs_EntityId(doomed);
+  Entity *kept = ecs_CreateEntityFromLayout(second);
+  u64 kept_id = ecs_EntityId(kept);
+  *(u32 *)ecs_GetPropDataFromEntity(kept, other) = 42;
+
+  CHECK(ecs_LayoutDelete(first) == SUCCESS);
+  CHECK(!ecs_WorldEntityFromId(world, doomed_id));
+  CHECK(ecs_WorldEntityFromId(world, kept_id) == kept);
+  CHECK(*(u32 *)ecs_GetPropDataFromEntity(kept, other) == 42);
+  CHECK(ecs_EntityId(ecs_CreateEntityFromLayout(second)) != doomed_id);
+
+  ecs_WorldDelete(world);
+}
+
+int main(void) {
+  TestEntityChurn();
+  TestStaleIds();
+  TestLayoutDelete();
+
+  return TEST_RESULT();
+}
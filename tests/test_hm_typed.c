@@ -0,0 +1,133 @@
+#include "../types/hm_typed.h"
+#include "test.h"
+
+HM_DEFINE(U64Map, u64, u64)
+
+#define KEY_COUNT (1000)
+
+// Heap allocations, with reallocs failing while fail_reallocs is set.
+typedef struct {
+  Allocator heap;
+  bool fail_reallocs;
+} TestAllocator;
+
+static void *TestAllocFunc(void *ctx, u64 size) {
+  return mem_Alloc(&((TestAllocator *)ctx)->heap, size);
+}
+
+static void *TestReallocFunc(void *ctx, void *ptr, u64 old_size,
+                             u64 new_size) {
+  TestAllocator *allocator = ctx;
+  if (allocator->fail_reallocs) {
+    return NULL;
+  }
+
+  return mem_Realloc(&allocator->heap, ptr, old_size, new_size);
+}
+
+static void TestFreeFunc(void *ctx, void *ptr, u64 size) {
+  mem_Free(&((TestAllocator *)ctx)->heap, ptr, size);
+}
+
+static void TestAddGetDelete(void) {
+  MemStats before = mem_StatsGet(MEM_CATEGORY_HASHMAP);
+  U64Map map;
+  CHECK(U64Map_Init(&map, NULL) == SUCCESS);
+
+  for (u64 i = 0; i < KEY_COUNT; i++) {
+    CHECK(U64Map_AddEntry(&map, i, i * 3, HM_ADD_FAIL) == SUCCESS);
+  }
+  CHECK(U64Map_GetLen(&map) == KEY_COUNT);
+  CHECK(U64Map_AddEntry(&map, 7, 0, HM_ADD_FAIL) != SUCCESS);
+  CHECK(U64Map_AddEntry(&map, 7, 0, HM_ADD_OVERWRITE) == SUCCESS);
+  CHECK(*U64Map_GetEntry(&map, 7) == 0);
+
+  for (u64 i = 0; i < KEY_COUNT; i += 2) {
+    CHECK(U64Map_DeleteEntry(&map, i) == SUCCESS);
+  }
+  CHECK(U64Map_DeleteEntry(&map, 0) != SUCCESS);
+  CHECK(U64Map_GetLen(&map) == KEY_COUNT / 2);
+  for (u64 i = 0; i < KEY_COUNT; i++) {
+    u64 *val = U64Map_GetEntry(&map, i);
+    CHECK(!val == !(i % 2));
+    CHECK(!val || i == 7 || *val == i * 3);
+  }
+
+  // Counted under its category, and all of it goes on deinit.
+  CHECK(mem_StatsGet(MEM_CATEGORY_HASHMAP).live_bytes > before.live_bytes);
+  U64Map_Deinit(&map);
+  CHECK(mem_StatsGet(MEM_CATEGORY_HASHMAP).live_bytes == before.live_bytes);
+}
+
+static void TestTombstones(void) {
+  U64Map map;
+  U64Map_Init(&map, NULL);
+  // Few enough that the churn below never needs a bigger structure.
+  for (u64 i = 0; i < 4; i++) {
+    U64Map_AddEntry(&map, i, i, HM_ADD_FAIL);
+  }
+
+  // Adding a deleted key back takes its tombstone.
+  U64Map_DeleteEntry(&map, 3);
+  CHECK(map.tombstones == 1);
+  U64Map_AddEntry(&map, 3, 33, HM_ADD_FAIL);
+  CHECK(map.tombstones == 0);
+  CHECK(*U64Map_GetEntry(&map, 3) == 33);
+
+  // Churn at the same size rehashes in place, dropping the tombstones.
+  u64 structure_cap = map.structure_cap;
+  for (u64 i = 4; i < 4 + KEY_COUNT; i++) {
+    U64Map_AddEntry(&map, i, i, HM_ADD_FAIL);
+    U64Map_DeleteEntry(&map, i);
+    CHECK((map.len + map.tombstones) * HM_TYPED_LOAD_DEN <
+          map.structure_cap * HM_TYPED_LOAD_NUM);
+  }
+  CHECK(map.structure_cap == structure_cap);
+  for (u64 i = 0; i < 4; i++) {
+    CHECK(*U64Map_GetEntry(&map, i) == ((i == 3) ? 33 : i));
+  }
+
+  U64Map_Deinit(&map);
+}
+
+// A failed add leaves the map as it was, tombstone count included.
+static void TestFailedAdd(void) {
+  TestAllocator test_allocator = {.heap = mem_HeapAllocator()};
+  Allocator allocator = {.alloc_func = TestAllocFunc,
+                         .realloc_func = TestReallocFunc,
+                         .free_func = TestFreeFunc,
+                         .ctx = &test_allocator};
+  U64Map map;
+  U64Map_Init(&map, &allocator);
+  // Fills the entries, their next add has to grow them.
+  for (u64 i = 0; i < HM_TYPED_MIN_BUCKET_SIZE; i++) {
+    U64Map_AddEntry(&map, i, i, HM_ADD_FAIL);
+  }
+  // Keeps the entries full while leaving a tombstone in the structure.
+  U64Map_DeleteEntry(&map, 5);
+  U64Map_AddEntry(&map, 100, 100, HM_ADD_FAIL);
+  u64 tombstones = map.tombstones;
+  CHECK(map.len == map.entries_cap && tombstones);
+
+  test_allocator.fail_reallocs = true;
+  CHECK(U64Map_AddEntry(&map, 5, 5, HM_ADD_FAIL) != SUCCESS);
+  CHECK(map.tombstones == tombstones);
+  CHECK(!U64Map_GetEntry(&map, 5));
+
+  test_allocator.fail_reallocs = false;
+  CHECK(U64Map_AddEntry(&map, 5, 5, HM_ADD_FAIL) == SUCCESS);
+  CHECK(map.tombstones == tombstones - 1);
+  for (u64 i = 0; i < HM_TYPED_MIN_BUCKET_SIZE; i++) {
+    CHECK(*U64Map_GetEntry(&map, i) == i);
+  }
+
+  U64Map_Deinit(&map);
+}
+
+int main(void) {
+  TestAddGetDelete();
+  TestTombstones();
+  TestFailedAdd();
+
+  return TEST_RESULT();
+}
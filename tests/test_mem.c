@@ -0,0 +1,143 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../utils/mem.h"
+#include "test.h"
+#include <pthread.h>
+
+#define STATS_THREAD_COUNT (4)
+#define STATS_RECORD_COUNT (1000)
+
+static void TestPoolArenaCategory(void) {
+  MemStats before = mem_StatsGet(MEM_CATEGORY_ECS);
+  PoolArena *arena = mem_PoolArenaCreateWCategory(sizeof(u64), 4,
+                                                  MEM_BACKING_DEFAULT,
+                                                  MEM_CATEGORY_ECS);
+  CHECK(arena);
+  CHECK(mem_StatsGet(MEM_CATEGORY_ECS).live_bytes > before.live_bytes);
+
+  void *entries[10];
+  for (u64 i = 0; i < 10; i++) {
+    entries[i] = mem_PoolArenaAlloc(arena);
+    CHECK(entries[i]);
+  }
+  CHECK(mem_PoolArenaLiveCount(arena) == 10);
+  for (u64 i = 0; i < 7; i++) {
+    mem_PoolArenaFree(arena, entries[i]);
+  }
+  CHECK(mem_PoolArenaLiveCount(arena) == 3);
+  mem_PoolArenaReset(arena);
+  CHECK(mem_PoolArenaLiveCount(arena) == 0);
+
+  mem_PoolArenaDelete(arena);
+  CHECK(mem_StatsGet(MEM_CATEGORY_ECS).live_bytes == before.live_bytes);
+}
+
+static void TestBumpArenaCategory(void) {
+  MemStats before = mem_StatsGet(MEM_CATEGORY_ECS);
+  BumpArena *arena =
+      mem_BumpArenaCreateWCategory(64, MEM_BACKING_DEFAULT, MEM_CATEGORY_ECS);
+  CHECK(arena);
+  // Needs a second block.
+  CHECK(mem_BumpArenaAlloc(arena, 256));
+  CHECK(mem_StatsGet(MEM_CATEGORY_ECS).live_bytes > before.live_bytes + 256);
+
+  mem_BumpArenaDelete(arena);
+  CHECK(mem_StatsGet(MEM_CATEGORY_ECS).live_bytes == before.live_bytes);
+}
+
+static void TestBumpArenaMarkers(void) {
+  BumpArena *arena = mem_BumpArenaCreate(128);
+  CHECK(arena);
+
+  u8 *first = mem_BumpArenaAlloc(arena, 32);
+  CHECK(first && (uintptr_t)first % BUMP_ARENA_ALIGNMENT == 0);
+  BumpArenaMarker marker = mem_BumpArenaSave(arena);
+  u8 *scratch = mem_BumpArenaAlloc(arena, 32);
+  // Past the first block, so a second one is chained on.
+  u8 *big = mem_BumpArenaAlloc(arena, 512);
+  CHECK(scratch && big);
+  memset(big, 0xab, 512);
+  u8 *aligned = mem_BumpArenaAllocAligned(arena, 8, 256);
+  CHECK(aligned && (uintptr_t)aligned % 256 == 0);
+
+  // Everything after the marker is handed out again, in the same order.
+  CHECK(mem_BumpArenaRestore(arena, marker) == SUCCESS);
+  CHECK(mem_BumpArenaAlloc(arena, 32) == scratch);
+
+  // A zeroing reset clears what was handed out, other blocks included.
+  CHECK(mem_BumpArenaReset(arena, BUMP_ARENA_RESET_ZERO) == SUCCESS);
+  CHECK(mem_BumpArenaAlloc(arena, 32) == first);
+  mem_BumpArenaAlloc(arena, 32);
+  u8 *reused = mem_BumpArenaAlloc(arena, 512);
+  CHECK(reused);
+  bool zeroed = true;
+  for (u64 i = 0; reused && i < 512; i++) {
+    zeroed &= !reused[i];
+  }
+  CHECK(zeroed);
+
+  mem_BumpArenaDelete(arena);
+}
+
+// Records what the main thread frees, without ever flushing on its own.
+static void *RecordStatsThread(void *arg) {
+  (void)arg;
+  for (u64 i = 0; i < STATS_RECORD_COUNT; i++) {
+    mem_StatsRecordAlloc(MEM_CATEGORY_GENERAL, 24);
+  }
+  mem_StatsRecordAlloc(MEM_CATEGORY_GENERAL, 8);
+
+  return NULL;
+}
+
+/*
+ * Counts made by threads still running and by exited ones add up, and frees
+ * recorded on another thread than the allocations cancel them out.
+ */
+static void TestStatsAcrossThreads(void) {
+  MemStats before = mem_StatsGet(MEM_CATEGORY_GENERAL);
+  pthread_t threads[STATS_THREAD_COUNT];
+  for (u64 i = 0; i < STATS_THREAD_COUNT; i++) {
+    CHECK(pthread_create(&threads[i], NULL, RecordStatsThread, NULL) == 0);
+  }
+  for (u64 i = 0; i < STATS_THREAD_COUNT; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  mem_StatsRecordAlloc(MEM_CATEGORY_GENERAL, 40);
+
+  u64 thread_bytes = STATS_RECORD_COUNT * 24 + 8;
+  MemStats stats = mem_StatsGet(MEM_CATEGORY_GENERAL);
+  CHECK(stats.live_bytes ==
+        before.live_bytes + STATS_THREAD_COUNT * thread_bytes + 40);
+  CHECK(stats.live_count == before.live_count +
+                                STATS_THREAD_COUNT * (STATS_RECORD_COUNT + 1) +
+                                1);
+  CHECK(stats.peak_bytes >= stats.live_bytes);
+
+  for (u64 i = 0; i < STATS_THREAD_COUNT; i++) {
+    for (u64 j = 0; j < STATS_RECORD_COUNT; j++) {
+      mem_StatsRecordFree(MEM_CATEGORY_GENERAL, 24);
+    }
+    mem_StatsRecordFree(MEM_CATEGORY_GENERAL, 8);
+  }
+  mem_StatsRecordResize(MEM_CATEGORY_GENERAL, 40, 16);
+  stats = mem_StatsGet(MEM_CATEGORY_GENERAL);
+  CHECK(stats.live_bytes == before.live_bytes + 16);
+  CHECK(stats.live_count == before.live_count + 1);
+  CHECK(stats.total_count == before.total_count +
+                                 STATS_THREAD_COUNT * (STATS_RECORD_COUNT + 1) +
+                                 1);
+
+  CHECK(mem_StatsResetPeak(MEM_CATEGORY_GENERAL) == SUCCESS);
+  CHECK(mem_StatsGet(MEM_CATEGORY_GENERAL).peak_bytes == stats.live_bytes);
+  mem_StatsRecordFree(MEM_CATEGORY_GENERAL, 16);
+}
+
+int main(void) {
+  TestPoolArenaCategory();
+  TestBumpArenaCategory();
+  TestBumpArenaMarkers();
+  TestStatsAcrossThreads();
+
+  return TEST_RESULT();
+}
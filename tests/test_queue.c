@@ -0,0 +1,61 @@
+#include "../types/queue.h"
+#include "test.h"
+
+static void TestSpscBatch(void) {
+  SpscQueue *queue = queue_SpscCreate(sizeof(u64), 16);
+  CHECK(queue);
+
+  u64 in[20], out[20];
+  for (u64 i = 0; i < 20; i++) {
+    in[i] = i;
+  }
+
+  CHECK(queue_SpscPushBatch(queue, in, 0) == 0);
+  CHECK(queue_SpscPopBatch(queue, out, 0) == 0);
+  // Only as many as fit are pushed.
+  CHECK(queue_SpscPushBatch(queue, in, 20) == 16);
+  CHECK(queue_SpscPushBatch(queue, in, 0) == 0);
+  CHECK(queue_SpscPopBatch(queue, out, 20) == 16);
+  for (u64 i = 0; i < 16; i++) {
+    CHECK(out[i] == i);
+  }
+  CHECK(queue_SpscPopBatch(queue, out, 1) == 0);
+
+  queue_SpscDelete(queue);
+}
+
+static void TestMpmcBatch(void) {
+  MpmcQueue *queue = queue_MpmcCreate(sizeof(u64), 16);
+  CHECK(queue);
+
+  u64 in[20], out[20];
+  for (u64 i = 0; i < 20; i++) {
+    in[i] = i;
+  }
+
+  // A count of 0 returns right away on an empty, partial and full queue.
+  CHECK(queue_MpmcPushBatch(queue, in, 0) == 0);
+  CHECK(queue_MpmcPopBatch(queue, out, 0) == 0);
+  CHECK(queue_MpmcPushBatch(queue, in, 4) == 4);
+  CHECK(queue_MpmcPushBatch(queue, in, 0) == 0);
+  CHECK(queue_MpmcPopBatch(queue, out, 0) == 0);
+  CHECK(queue_MpmcPushBatch(queue, in + 4, 20) == 12);
+  CHECK(queue_MpmcPushBatch(queue, in, 0) == 0);
+  CHECK(queue_MpmcPush(queue, in) == FAILURE);
+
+  CHECK(queue_MpmcPopBatch(queue, out, 20) == 16);
+  for (u64 i = 0; i < 16; i++) {
+    CHECK(out[i] == i);
+  }
+  CHECK(queue_MpmcPopBatch(queue, out, 0) == 0);
+  CHECK(queue_MpmcPop(queue, out) == FAILURE);
+
+  queue_MpmcDelete(queue);
+}
+
+int main(void) {
+  TestSpscBatch();
+  TestMpmcBatch();
+
+  return TEST_RESULT();
+}
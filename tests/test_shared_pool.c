@@ -0,0 +1,125 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../utils/shared_pool.h"
+#include "test.h"
+#include <pthread.h>
+
+#define THREAD_COUNT (8)
+#define ENTRIES_PER_THREAD (1000)
+
+typedef struct {
+  SharedPoolArena *arena;
+  u64 thread;
+  // Every thread's entries, each thread fills in its own part.
+  u64 **entries;
+} Worker;
+
+static void *AllocWorker(void *arg) {
+  Worker *worker = arg;
+  u64 **entries = worker->entries + worker->thread * ENTRIES_PER_THREAD;
+  for (u64 i = 0; i < ENTRIES_PER_THREAD; i++) {
+    entries[i] = mem_SharedPoolArenaAlloc(worker->arena);
+    if (entries[i]) {
+      *entries[i] = worker->thread * ENTRIES_PER_THREAD + i;
+    }
+    // Some churn through the thread's own magazines on the way.
+    if (i % 3 == 0) {
+      mem_SharedPoolArenaFree(worker->arena,
+                              mem_SharedPoolArenaAlloc(worker->arena));
+    }
+  }
+
+  // Exits without flushing, so whatever it cached has to come back on exit.
+  return NULL;
+}
+
+// Frees the entries of the next thread over, none of which it allocated.
+static void *FreeWorker(void *arg) {
+  Worker *worker = arg;
+  u64 other = (worker->thread + 1) % THREAD_COUNT;
+  u64 **entries = worker->entries + other * ENTRIES_PER_THREAD;
+  for (u64 i = 0; i < ENTRIES_PER_THREAD; i++) {
+    mem_SharedPoolArenaFree(worker->arena, entries[i]);
+  }
+
+  return NULL;
+}
+
+static void RunWorkers(Worker *workers, void *(*func)(void *)) {
+  pthread_t threads[THREAD_COUNT];
+  for (u64 i = 0; i < THREAD_COUNT; i++) {
+    CHECK(pthread_create(&threads[i], NULL, func, &workers[i]) == 0);
+  }
+  for (u64 i = 0; i < THREAD_COUNT; i++) {
+    pthread_join(threads[i], NULL);
+  }
+}
+
+static void TestThreadsAllocFree(void) {
+  SharedPoolArena *arena = mem_SharedPoolArenaCreate(sizeof(u64));
+  static u64 *entries[THREAD_COUNT * ENTRIES_PER_THREAD];
+  Worker workers[THREAD_COUNT];
+  for (u64 i = 0; i < THREAD_COUNT; i++) {
+    workers[i] = (Worker){.arena = arena, .thread = i, .entries = entries};
+  }
+
+  RunWorkers(workers, AllocWorker);
+  // No entry was handed out twice, or it would have been overwritten.
+  for (u64 i = 0; i < THREAD_COUNT * ENTRIES_PER_THREAD; i++) {
+    CHECK(entries[i] && *entries[i] == i);
+  }
+  // The exited threads' caches went back to the arena, the depot's with trim.
+  mem_SharedPoolArenaTrim(arena);
+  CHECK(mem_SharedPoolArenaLiveCount(arena) ==
+        THREAD_COUNT * ENTRIES_PER_THREAD);
+
+  RunWorkers(workers, FreeWorker);
+  mem_SharedPoolArenaTrim(arena);
+  CHECK(mem_SharedPoolArenaLiveCount(arena) == 0);
+
+  mem_SharedPoolArenaDelete(arena);
+}
+
+// A thread exiting flushes into every arena it used, skipping deleted ones.
+static void *UseArenasWorker(void *arg) {
+  SharedPoolArena **arenas = arg;
+  mem_SharedPoolArenaFree(arenas[0], mem_SharedPoolArenaAlloc(arenas[0]));
+  mem_SharedPoolArenaFree(arenas[1], mem_SharedPoolArenaAlloc(arenas[1]));
+
+  return NULL;
+}
+
+static void TestThreadExitFlush(void) {
+  SharedPoolArena *arenas[] = {mem_SharedPoolArenaCreate(sizeof(u64)),
+                               mem_SharedPoolArenaCreate(64)};
+  // Used, then deleted before the thread exits. Its slot gets reused.
+  SharedPoolArena *deleted = mem_SharedPoolArenaCreate(sizeof(u64));
+  mem_SharedPoolArenaFree(deleted, mem_SharedPoolArenaAlloc(deleted));
+  mem_SharedPoolArenaDelete(deleted);
+
+  pthread_t thread;
+  CHECK(pthread_create(&thread, NULL, UseArenasWorker, arenas) == 0);
+  pthread_join(thread, NULL);
+  mem_SharedPoolArenaTrim(arenas[0]);
+  mem_SharedPoolArenaTrim(arenas[1]);
+  CHECK(mem_SharedPoolArenaLiveCount(arenas[0]) == 0);
+  CHECK(mem_SharedPoolArenaLiveCount(arenas[1]) == 0);
+
+  // The calling thread's cache only goes back once flushed.
+  mem_SharedPoolArenaFree(arenas[0], mem_SharedPoolArenaAlloc(arenas[0]));
+  mem_SharedPoolArenaTrim(arenas[0]);
+  CHECK(mem_SharedPoolArenaLiveCount(arenas[0]) > 0);
+  mem_SharedPoolArenaFlushThreadCache(arenas[0]);
+  mem_SharedPoolArenaTrim(arenas[0]);
+  CHECK(mem_SharedPoolArenaLiveCount(arenas[0]) == 0);
+
+  mem_SharedPoolArenaDelete(arenas[0]);
+  mem_SharedPoolArenaDelete(arenas[1]);
+}
+
+int main(void) {
+  TestThreadsAllocFree();
+  TestThreadExitFlush();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,136 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../ecs/ecs.h"
+#include "test.h"
+#include <unistd.h>
+
+#define ENTITY_COUNT (40)
+#define RING_SNAPSHOT_SIZE (1 << 16)
+
+typedef struct {
+  u8 bytes[13];
+} OddProp;
+
+static PropsSignature *CreateSignature(EcsWorld *world, PropId first,
+                                       PropId second) {
+  PropsSignature *signature = ecs_WorldPropSignatureCreate(world);
+  ecs_HandlePropIdToPropSignatures(signature, first, PROP_SIGNATURE_ATTACH);
+  if (second != INVALID_PROP_ID) {
+    ecs_HandlePropIdToPropSignatures(signature, second, PROP_SIGNATURE_ATTACH);
+  }
+
+  return signature;
+}
+
+static Layout *CreateLayout(EcsWorld *world, PropId first, PropId second) {
+  return ecs_LayoutCreate(CreateSignature(world, first, second),
+                          DUPLICATE_PROPS_SIGNATURE_FREE);
+}
+
+/*
+ * Streams a world to a file and replays it into a world created separately,
+ * which only shares the registered props, as a replay or spectator would.
+ */
+static void TestRestoreIntoOtherWorld(void) {
+  EcsWorld *world = ecs_WorldCreate(&(EcsConfig){0});
+  PropId num = ecs_WorldPropIdCreate(world, sizeof(u64));
+  PropId odd = ecs_WorldPropIdCreate(world, sizeof(OddProp));
+  Layout *both = CreateLayout(world, num, odd);
+  Layout *num_only = CreateLayout(world, num, INVALID_PROP_ID);
+  CHECK(both && num_only);
+
+  Entity *entities[ENTITY_COUNT];
+  for (u64 i = 0; i < ENTITY_COUNT; i++) {
+    entities[i] = ecs_CreateEntityFromLayout((i % 3) ? both : num_only);
+    CHECK(ecs_EntityId(entities[i]) == i);
+    *(u64 *)ecs_GetPropDataFromEntity(entities[i], num) = i * 7;
+  }
+  for (u64 i = 0; i < ENTITY_COUNT; i += 5) {
+    ecs_DeleteEntity(entities[i]);
+  }
+
+  EcsSnapshotRing *ring = ecs_SnapshotRingCreate(4, RING_SNAPSHOT_SIZE);
+  u64 delta_cap = ecs_SnapshotDeltaMaxSize(ring);
+  u8 *delta = malloc(delta_cap);
+  FILE *file = tmpfile();
+  CHECK(ring && delta && file);
+  int fd = fileno(file);
+
+  CHECK(ecs_WorldSnapshot(world, ring, 0) == SUCCESS);
+  u64 size = ecs_SnapshotDeltaEncode(ring, ECS_SNAPSHOT_DELTA_KEYFRAME, 0,
+                                     delta, delta_cap);
+  CHECK(size && ecs_SnapshotDeltaWrite(fd, delta, size) == SUCCESS);
+  for (u64 i = 1; i < ENTITY_COUNT; i += 5) {
+    *(u64 *)ecs_GetPropDataFromEntity(entities[i], num) += 1000;
+  }
+  ecs_DeleteEntity(entities[2]);
+  CHECK(ecs_WorldSnapshot(world, ring, 1) == SUCCESS);
+  size = ecs_SnapshotDeltaEncode(ring, 0, 1, delta, delta_cap);
+  CHECK(size && ecs_SnapshotDeltaWrite(fd, delta, size) == SUCCESS);
+
+  // More props than the sender, so its signatures are of another size.
+  EcsWorld *replay = ecs_WorldCreate(&(EcsConfig){0});
+  CHECK(ecs_WorldPropIdCreate(replay, sizeof(u64)) == num);
+  CHECK(ecs_WorldPropIdCreate(replay, sizeof(OddProp)) == odd);
+  for (u64 i = 0; i < 100; i++) {
+    ecs_WorldPropIdCreate(replay, 1);
+  }
+  EcsSnapshotRing *replay_ring =
+      ecs_SnapshotRingCreate(4, RING_SNAPSHOT_SIZE);
+  CHECK(replay_ring);
+
+  lseek(fd, 0, SEEK_SET);
+  for (u64 tick = 0; tick < 2; tick++) {
+    CHECK(ecs_SnapshotDeltaRead(fd, delta, delta_cap, &size) == SUCCESS);
+    CHECK(ecs_SnapshotDeltaApply(replay_ring, delta, size) == SUCCESS);
+    CHECK(ecs_WorldRestore(replay, replay_ring, tick) == SUCCESS);
+
+    for (u64 i = 0; i < ENTITY_COUNT; i++) {
+      Entity *entity = ecs_WorldEntityFromId(replay, i);
+      bool deleted = !(i % 5) || (tick && i == 2);
+      CHECK(!deleted == !!entity);
+      if (entity) {
+        u64 *val = ecs_GetPropDataFromEntity(entity, num);
+        CHECK(*val == i * 7 + ((tick && i % 5 == 1) ? 1000 : 0));
+        // Landed in the layout of the same props.
+        CHECK(!!ecs_GetPropDataFromEntity(entity, odd) == !!(i % 3));
+      }
+    }
+  }
+  CHECK(ecs_SnapshotDeltaRead(fd, delta, delta_cap, &size) == WARNING);
+  // Restoring again finds the layouts it created.
+  CHECK(ecs_WorldRestore(replay, replay_ring, 0) == SUCCESS);
+  CHECK(*(u64 *)ecs_GetPropDataFromEntity(ecs_WorldEntityFromId(replay, 2),
+                                          num) == 14);
+
+  // Both ends hand out the same ids from here on, reusing deleted indices.
+  CHECK(ecs_WorldRestore(world, ring, 1) == SUCCESS);
+  CHECK(ecs_WorldRestore(replay, replay_ring, 1) == SUCCESS);
+  for (u64 i = 0; i < 4; i++) {
+    u64 id = ecs_EntityId(ecs_CreateEntityFromLayout(both));
+    Layout *replay_both = ecs_LayoutCreate(
+        CreateSignature(replay, num, odd), DUPLICATE_PROPS_SIGNATURE_FREE);
+    CHECK(id == ecs_EntityId(ecs_CreateEntityFromLayout(replay_both)));
+    CHECK(id >> 32);
+  }
+
+  // Props of other sizes can't take the snapshot.
+  EcsWorld *other = ecs_WorldCreate(&(EcsConfig){0});
+  ecs_WorldPropIdCreate(other, sizeof(u32));
+  ecs_WorldPropIdCreate(other, sizeof(OddProp));
+  CHECK(ecs_WorldRestore(other, replay_ring, 0) != SUCCESS);
+
+  fclose(file);
+  free(delta);
+  ecs_SnapshotRingDelete(replay_ring);
+  ecs_SnapshotRingDelete(ring);
+  ecs_WorldDelete(other);
+  ecs_WorldDelete(replay);
+  ecs_WorldDelete(world);
+}
+
+int main(void) {
+  TestRestoreIntoOtherWorld();
+
+  return TEST_RESULT();
+}
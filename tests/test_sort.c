@@ -0,0 +1,130 @@
+#include "../types/sort.h"
+#include "test.h"
+#include <stdlib.h>
+
+#define SMALL_LEN (1000)
+// Enough keys for the parallel sorts to actually use 4 threads.
+#define LARGE_LEN ((u64)1 << 18)
+#define THREAD_COUNT (4)
+
+// Not a multiple of 8 bytes, so it takes the index and gather path.
+typedef struct {
+  u32 key;
+  u32 index;
+  u32 check;
+} Record;
+
+static u64 rng_state = 0x9e3779b97f4a7c15;
+
+static u64 NextRandom(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+static void TestU32Keys(void) {
+  u32 keys[SMALL_LEN];
+  Record records[SMALL_LEN];
+  for (u32 i = 0; i < SMALL_LEN; i++) {
+    // Plenty of duplicates, to see the equal keys keep their order.
+    keys[i] = (u32)(NextRandom() % 64) << 20;
+    records[i] = (Record){keys[i], i, ~keys[i]};
+  }
+
+  CHECK(sort_RadixU32WPayload(keys, records, sizeof(Record), SMALL_LEN) ==
+        SUCCESS);
+  bool sorted = true;
+  for (u32 i = 0; i < SMALL_LEN; i++) {
+    sorted &= records[i].key == keys[i] && records[i].check == ~keys[i];
+    if (i) {
+      sorted &= keys[i - 1] < keys[i] ||
+                (keys[i - 1] == keys[i] &&
+                 records[i - 1].index < records[i].index);
+    }
+  }
+  CHECK(sorted);
+
+  u32 only_keys[3] = {3, 1, 2};
+  CHECK(sort_RadixU32(only_keys, 3) == SUCCESS);
+  CHECK(only_keys[0] == 1 && only_keys[1] == 2 && only_keys[2] == 3);
+}
+
+/*
+ * A u64 payload is sorted in place of the index array, it has to come out the
+ * same as the gathered one. 24 bit keys take 3 passes, so it ends up in the
+ * scratch array and has to be copied back.
+ */
+static void TestU64KeysWIndices(void) {
+  static u64 keys[SMALL_LEN], original[SMALL_LEN], indices[SMALL_LEN];
+  for (u64 i = 0; i < SMALL_LEN; i++) {
+    keys[i] = original[i] = (i % 7) ? NextRandom() >> 40 : NextRandom() % 4;
+    indices[i] = i;
+  }
+
+  CHECK(sort_RadixU64WPayload(keys, indices, sizeof(u64), SMALL_LEN) ==
+        SUCCESS);
+  bool sorted = true;
+  for (u64 i = 0; i < SMALL_LEN; i++) {
+    sorted &= original[indices[i]] == keys[i];
+    if (i) {
+      sorted &= keys[i - 1] < keys[i] ||
+                (keys[i - 1] == keys[i] && indices[i - 1] < indices[i]);
+    }
+  }
+  CHECK(sorted);
+}
+
+// Every thread scatters its own part, the barriers keep the passes in step.
+static void TestParallel(void) {
+  u64 *keys = malloc(sizeof(u64) * LARGE_LEN);
+  u64 *original = malloc(sizeof(u64) * LARGE_LEN);
+  u64 *indices = malloc(sizeof(u64) * LARGE_LEN);
+  u32 *small_keys = malloc(sizeof(u32) * LARGE_LEN);
+  Record *records = malloc(sizeof(Record) * LARGE_LEN);
+  CHECK(keys && original && indices && small_keys && records);
+  for (u64 i = 0; i < LARGE_LEN; i++) {
+    keys[i] = original[i] = NextRandom() >> (i % 3) * 20;
+    indices[i] = i;
+    small_keys[i] = (u32)(NextRandom() % 1000);
+    records[i] = (Record){small_keys[i], (u32)i, ~small_keys[i]};
+  }
+
+  // The scratch space comes from the allocator, and all goes back to it.
+  Allocator allocator = mem_HeapAllocatorWCategory(MEM_CATEGORY_ARENA);
+  MemStats before = mem_StatsGet(MEM_CATEGORY_ARENA);
+  CHECK(sort_RadixU64Parallel(keys, indices, sizeof(u64), LARGE_LEN,
+                              THREAD_COUNT, &allocator) == SUCCESS);
+  CHECK(sort_RadixU32Parallel(small_keys, records, sizeof(Record), LARGE_LEN,
+                              THREAD_COUNT, &allocator) == SUCCESS);
+  MemStats after = mem_StatsGet(MEM_CATEGORY_ARENA);
+  CHECK(after.total_count > before.total_count);
+  CHECK(after.live_bytes == before.live_bytes);
+
+  bool sorted = true;
+  for (u64 i = 0; i < LARGE_LEN; i++) {
+    sorted &= original[indices[i]] == keys[i];
+    sorted &= records[i].key == small_keys[i];
+    if (i) {
+      sorted &= keys[i - 1] <= keys[i];
+      sorted &= small_keys[i - 1] < small_keys[i] ||
+                (small_keys[i - 1] == small_keys[i] &&
+                 records[i - 1].index < records[i].index);
+    }
+  }
+  CHECK(sorted);
+
+  free(records);
+  free(small_keys);
+  free(indices);
+  free(original);
+  free(keys);
+}
+
+int main(void) {
+  TestU32Keys();
+  TestU64KeysWIndices();
+  TestParallel();
+
+  return TEST_RESULT();
+}
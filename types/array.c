@@ -9,24 +9,93 @@ struct __Vector {
   u64 len;
   u64 elem_size;
   void *mem;
+  // Both the vector itself and mem come from this.
+  Allocator allocator;
+  /*
+   * Only set for virtual vectors. mem is then a reservation of max_cap elements
+   * and only the first committed bytes of it are backed by memory, growth
+   * commits more pages in place instead of reallocating.
+   */
+  u64 max_cap;
+  u64 committed;
+  // What the committed memory of a virtual vector is accounted as.
+  MemCategories category;
 };
 
+static StatusCode ResizeVectorMem(Vector *arr, u64 new_cap);
+static StatusCode ResizeVirtualVectorMem(Vector *arr, u64 new_cap);
+
 Vector *arr_VectorCreate(u64 elem_size) {
   return arr_VectorCustomCreate(elem_size, STD_ARR_SIZE);
 }
 
 Vector *arr_VectorCustomCreate(u64 elem_size, u64 cap) {
-  Vector *arr = malloc(sizeof(Vector));
+  return arr_VectorCreateWAllocator(elem_size, cap, NULL);
+}
+
+Vector *arr_VectorCreateWAllocator(u64 elem_size, u64 cap,
+                                   const Allocator *allocator) {
+  Allocator alloc =
+      (allocator) ? *allocator : mem_HeapAllocatorWCategory(MEM_CATEGORY_ARRAY);
+
+  Vector *arr = mem_Alloc(&alloc, sizeof(Vector));
   MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(arr, NULL);
 
-  arr->mem = malloc(elem_size * cap);
+  arr->allocator = alloc;
+  arr->len = 0;
+  arr->elem_size = elem_size;
+  arr->cap = cap;
+  arr->max_cap = 0;
+  arr->committed = 0;
+  arr->category = MEM_CATEGORY_ARRAY;
+  arr->mem = mem_Alloc(&arr->allocator, elem_size * cap);
   IF_NULL(arr->mem) {
     arr_VectorDelete(arr);
     MEM_ALLOC_FAILURE_SUB_ROUTINE(arr->mem, NULL);
   }
+
+  return arr;
+}
+
+Vector *arr_VectorVirtualCreate(u64 elem_size, u64 max_cap) {
+  return arr_VectorVirtualCreateWBacking(elem_size, max_cap,
+                                         MEM_BACKING_DEFAULT,
+                                         MEM_CATEGORY_ARRAY);
+}
+
+Vector *arr_VectorVirtualCreateWBacking(u64 elem_size, u64 max_cap,
+                                        MemBacking backing,
+                                        MemCategories category) {
+  if (!elem_size || !max_cap) {
+    STATUS_LOG(FAILURE, "Cannot create a virtual vector of no size.");
+    return NULL;
+  }
+
+  Allocator alloc = mem_HeapAllocatorWCategory(category);
+
+  Vector *arr = mem_Alloc(&alloc, sizeof(Vector));
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(arr, NULL);
+
+  arr->allocator = alloc;
   arr->len = 0;
+  arr->cap = 0;
   arr->elem_size = elem_size;
-  arr->cap = cap;
+  arr->max_cap = max_cap;
+  arr->committed = 0;
+  arr->category = category;
+  arr->mem = mem_VirtualReserve(ALIGN_UP(elem_size * max_cap, mem_PageSize()));
+  IF_NULL(arr->mem) {
+    arr_VectorDelete(arr);
+    STATUS_LOG(CREATION_FAILURE, "Cannot reserve memory for virtual vector.");
+    return NULL;
+  }
+  mem_VirtualSetBacking(arr->mem,
+                        ALIGN_UP(elem_size * max_cap, mem_PageSize()), backing);
+  IF_FUNC_FAILED(ResizeVirtualVectorMem(arr, MIN(STD_ARR_SIZE, max_cap))) {
+    arr_VectorDelete(arr);
+    STATUS_LOG(CREATION_FAILURE, "Cannot commit memory for virtual vector.");
+    return NULL;
+  }
 
   return arr;
 }
@@ -34,10 +103,18 @@ Vector *arr_VectorCustomCreate(u64 elem_size, u64 cap) {
 StatusCode arr_VectorDelete(Vector *arr) {
   NULL_FUNC_ARG_ROUTINE(arr, NULL_EXCEPTION);
 
-  if (arr->mem) {
-    free(arr->mem);
+  // Copied out, as the vector itself is freed with it.
+  Allocator allocator = arr->allocator;
+  if (arr->mem && arr->max_cap) {
+    mem_VirtualRelease(arr->mem,
+                       ALIGN_UP(arr->max_cap * arr->elem_size, mem_PageSize()));
+    if (arr->committed) {
+      mem_StatsRecordFree(arr->category, arr->committed);
+    }
+  } else if (arr->mem) {
+    mem_Free(&allocator, arr->mem, arr->cap * arr->elem_size);
   }
-  free(arr);
+  mem_Free(&allocator, arr, sizeof(Vector));
 
   return SUCCESS;
 }
@@ -79,16 +156,12 @@ StatusCode arr_VectorPush(Vector *arr, const void *data,
 
   if (arr->len == arr->cap) {
     u64 new_cap = (grow_callback) ? grow_callback(arr->cap) : arr->cap * 2;
-    if (new_cap < arr->cap) {
+    if (new_cap <= arr->cap) {
       STATUS_LOG(WARNING, "Cannot grow vector, faulty grow callback. Default "
                           "grow strategy to be used.");
-      new_cap = arr->cap * 2;
+      new_cap = MAX(arr->cap * 2, 1);
     }
-    void *new_mem = realloc(arr->mem, new_cap * arr->elem_size);
-    MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(new_mem, CREATION_FAILURE);
-
-    arr->mem = new_mem;
-    arr->cap = new_cap;
+    IF_FUNC_FAILED(ResizeVectorMem(arr, new_cap)) { return CREATION_FAILURE; }
   }
 
   memcpy(MEM_OFFSET(arr->mem, (arr->len++) * arr->elem_size), data,
@@ -103,16 +176,12 @@ StatusCode arr_VectorPushEmpty(Vector *arr, u64 (*grow_callback)(u64 old_cap),
 
   if (arr->len == arr->cap) {
     u64 new_cap = (grow_callback) ? grow_callback(arr->cap) : arr->cap * 2;
-    if (new_cap < arr->cap) {
+    if (new_cap <= arr->cap) {
       STATUS_LOG(WARNING, "Cannot grow vector, faulty grow callback. Default "
                           "grow strategy to be used.");
-      new_cap = arr->cap * 2;
+      new_cap = MAX(arr->cap * 2, 1);
     }
-    void *new_mem = realloc(arr->mem, new_cap * arr->elem_size);
-    MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(new_mem, CREATION_FAILURE);
-
-    arr->mem = new_mem;
-    arr->cap = new_cap;
+    IF_FUNC_FAILED(ResizeVectorMem(arr, new_cap)) { return CREATION_FAILURE; }
   }
 
   if (memset_zero) {
@@ -148,14 +217,39 @@ u64 arr_VectorLen(const Vector *arr) {
   return arr->len;
 }
 
+u64 arr_VectorCap(const Vector *arr) {
+  NULL_FUNC_ARG_ROUTINE(arr, INVALID_INDEX);
+
+  return arr->cap;
+}
+
+// For virtual vectors this hands the pages past len back to the OS.
 StatusCode arr_VectorFit(Vector *arr) {
   NULL_FUNC_ARG_ROUTINE(arr, NULL_EXCEPTION);
 
-  void *new_mem = realloc(arr->mem, arr->len * arr->elem_size);
-  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(new_mem, CREATION_FAILURE);
+  return ResizeVectorMem(arr, arr->len);
+}
 
-  arr->cap = arr->len;
-  arr->mem = new_mem;
+// Grows the capacity to at least cap, never shrinks.
+StatusCode arr_VectorReserve(Vector *arr, u64 cap) {
+  NULL_FUNC_ARG_ROUTINE(arr, NULL_EXCEPTION);
+
+  if (cap <= arr->cap) {
+    return SUCCESS;
+  }
+
+  return ResizeVectorMem(arr, cap);
+}
+
+StatusCode arr_VectorSetLen(Vector *arr, u64 len) {
+  NULL_FUNC_ARG_ROUTINE(arr, NULL_EXCEPTION);
+
+  if (len > arr->cap) {
+    STATUS_LOG(OUT_OF_BOUNDS_ACCESS,
+               "Cannot set vector len: %zu past its cap: %zu.", len, arr->cap);
+    return OUT_OF_BOUNDS_ACCESS;
+  }
+  arr->len = len;
 
   return SUCCESS;
 }
@@ -187,40 +281,116 @@ StatusCode arr_VectorForEach(Vector *arr,
   return SUCCESS;
 }
 
+static StatusCode ResizeVectorMem(Vector *arr, u64 new_cap) {
+  if (arr->max_cap) {
+    return ResizeVirtualVectorMem(arr, new_cap);
+  }
+
+  void *new_mem =
+      mem_Realloc(&arr->allocator, arr->mem, arr->cap * arr->elem_size,
+                  new_cap * arr->elem_size);
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(new_mem, CREATION_FAILURE);
+
+  arr->mem = new_mem;
+  arr->cap = new_cap;
+
+  return SUCCESS;
+}
+
+/*
+ * Commits or decommits whole pages at the end of the reservation, so mem never
+ * moves. The cap ends up as many elements as fit in the committed pages, which
+ * can be a bit more than asked for.
+ */
+static StatusCode ResizeVirtualVectorMem(Vector *arr, u64 new_cap) {
+  if (new_cap > arr->max_cap) {
+    if (arr->cap == arr->max_cap) {
+      STATUS_LOG(CREATION_FAILURE,
+                 "Cannot grow virtual vector beyond its max cap: %zu.",
+                 arr->max_cap);
+      return CREATION_FAILURE;
+    }
+    new_cap = arr->max_cap;
+  }
+
+  u64 page_size = mem_PageSize();
+  u64 reserved = ALIGN_UP(arr->max_cap * arr->elem_size, page_size);
+  u64 new_committed = MIN(ALIGN_UP(new_cap * arr->elem_size, page_size),
+                          reserved);
+
+  if (new_committed > arr->committed) {
+    IF_FUNC_FAILED(mem_VirtualCommit(MEM_OFFSET(arr->mem, arr->committed),
+                                     new_committed - arr->committed)) {
+      return CREATION_FAILURE;
+    }
+  } else if (new_committed < arr->committed) {
+    IF_FUNC_FAILED(mem_VirtualDecommit(MEM_OFFSET(arr->mem, new_committed),
+                                       arr->committed - new_committed)) {
+      return FAILURE;
+    }
+  }
+
+  // The whole commit counts as a single allocation, that grows and shrinks.
+  if (!arr->committed) {
+    mem_StatsRecordAlloc(arr->category, new_committed);
+  } else if (!new_committed) {
+    mem_StatsRecordFree(arr->category, arr->committed);
+  } else {
+    mem_StatsRecordResize(arr->category, arr->committed, new_committed);
+  }
+  arr->committed = new_committed;
+  arr->cap = MIN(new_committed / arr->elem_size, arr->max_cap);
+
+  return SUCCESS;
+}
+
 /* ----  BUFFER ARRAY  ---- */
 
 struct __BuffArr {
   u64 cap;
   u64 elem_size;
   void *mem;
+  // Both the buff array itself and mem come from this.
+  Allocator allocator;
 };
 
 BuffArr *arr_BuffArrCreate(u64 elem_size, u64 cap) {
-  BuffArr *arr = malloc(sizeof(BuffArr));
+  return arr_BuffArrCreateWAllocator(elem_size, cap, NULL);
+}
+
+BuffArr *arr_BuffArrCreateWAllocator(u64 elem_size, u64 cap,
+                                     const Allocator *allocator) {
+  Allocator alloc =
+      (allocator) ? *allocator : mem_HeapAllocatorWCategory(MEM_CATEGORY_ARRAY);
+
+  BuffArr *arr = mem_Alloc(&alloc, sizeof(BuffArr));
   MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(arr, NULL);
 
-  arr->mem = malloc(elem_size * cap);
+  arr->allocator = alloc;
+  arr->elem_size = elem_size;
+  arr->cap = cap;
+  /*
+   * zeroes out the array. calloc over malloc + memset, as big allocations come
+   * zeroed from the OS and don't need to be touched up front.
+   */
+  arr->mem = mem_Calloc(&arr->allocator, elem_size * cap);
   IF_NULL(arr->mem) {
     arr_BuffArrDelete(arr);
     MEM_ALLOC_FAILURE_SUB_ROUTINE(arr->mem, NULL);
   }
 
-  // zeroes out the array.
-  memset(arr->mem, 0, elem_size * cap);
-
-  arr->elem_size = elem_size;
-  arr->cap = cap;
-
   return arr;
 }
 
 StatusCode arr_BuffArrDelete(BuffArr *arr) {
   NULL_FUNC_ARG_ROUTINE(arr, NULL_EXCEPTION);
 
+  // Copied out, as the buff array itself is freed with it.
+  Allocator allocator = arr->allocator;
   if (arr->mem) {
-    free(arr->mem);
+    mem_Free(&allocator, arr->mem, arr->cap * arr->elem_size);
   }
-  free(arr);
+  mem_Free(&allocator, arr, sizeof(BuffArr));
 
   return SUCCESS;
 }
@@ -270,7 +440,9 @@ StatusCode arr_BuffArrGrow(BuffArr *arr, u64 new_cap) {
     return FAILURE;
   }
 
-  void *new_mem = realloc(arr->mem, new_cap * arr->elem_size);
+  void *new_mem =
+      mem_Realloc(&arr->allocator, arr->mem, arr->cap * arr->elem_size,
+                  new_cap * arr->elem_size);
   MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(new_mem, CREATION_FAILURE);
 
   arr->mem = new_mem;
@@ -291,7 +463,9 @@ StatusCode arr_BuffArrGrowWCallback(BuffArr *arr,
                         "grow strategy to be used.");
     new_cap = arr->cap * 2;
   }
-  void *new_mem = realloc(arr->mem, new_cap * arr->elem_size);
+  void *new_mem =
+      mem_Realloc(&arr->allocator, arr->mem, arr->cap * arr->elem_size,
+                  new_cap * arr->elem_size);
   MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(new_mem, CREATION_FAILURE);
 
   arr->mem = new_mem;
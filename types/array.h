@@ -5,6 +5,7 @@ extern "C" {
 #endif
 
 #include "../utils/common.h"
+#include "../utils/mem.h"
 #include "../utils/status.h"
 
 /* ----  VECTOR  ---- */
@@ -13,6 +14,22 @@ typedef struct __Vector Vector;
 
 Vector *arr_VectorCreate(u64 elem_size);
 Vector *arr_VectorCustomCreate(u64 elem_size, u64 cap);
+// The allocator is copied, a NULL allocator means the heap.
+Vector *arr_VectorCreateWAllocator(u64 elem_size, u64 cap,
+                                   const Allocator *allocator);
+/*
+ * Reserves address space for max_cap elements up front and commits pages as
+ * the vector grows, so growing never copies and pointers into it stay valid
+ * for its whole life. Linux only, returns NULL elsewhere.
+ */
+Vector *arr_VectorVirtualCreate(u64 elem_size, u64 max_cap);
+/*
+ * Same as above, with backing applied to the reserved memory, and everything
+ * accounted as category (MEM_CATEGORY_ARRAY above).
+ */
+Vector *arr_VectorVirtualCreateWBacking(u64 elem_size, u64 max_cap,
+                                        MemBacking backing,
+                                        MemCategories category);
 StatusCode arr_VectorDelete(Vector *arr);
 StatusCode arr_VectorGet(const Vector *arr, u64 i, void *dest);
 StatusCode arr_VectorSet(Vector *arr, u64 i, const void *data);
@@ -22,7 +39,14 @@ StatusCode arr_VectorPushEmpty(Vector *arr, u64 (*grow_callback)(u64 old_cap),
                                bool memset_zero);
 StatusCode arr_VectorPop(Vector *arr, void *dest);
 u64 arr_VectorLen(const Vector *arr);
+u64 arr_VectorCap(const Vector *arr);
 StatusCode arr_VectorFit(Vector *arr);
+StatusCode arr_VectorReserve(Vector *arr, u64 cap);
+/*
+ * Sets the len to anything up to the current cap, never allocates. Elements
+ * past the old len are left as they were.
+ */
+StatusCode arr_VectorSetLen(Vector *arr, u64 len);
 StatusCode arr_VectorReset(Vector *arr);
 void *arr_VectorRaw(const Vector *arr);
 StatusCode arr_VectorForEach(Vector *arr,
@@ -33,6 +57,9 @@ StatusCode arr_VectorForEach(Vector *arr,
 typedef struct __BuffArr BuffArr;
 
 BuffArr *arr_BuffArrCreate(u64 elem_size, u64 cap);
+// The allocator is copied, a NULL allocator means the heap.
+BuffArr *arr_BuffArrCreateWAllocator(u64 elem_size, u64 cap,
+                                     const Allocator *allocator);
 StatusCode arr_BuffArrDelete(BuffArr *arr);
 StatusCode arr_BuffArrGet(const BuffArr *arr, u64 i, void *dest);
 StatusCode arr_BuffArrSet(BuffArr *arr, u64 i, const void *data);
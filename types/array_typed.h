@@ -0,0 +1,324 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../utils/common.h"
+#include "../utils/mem.h"
+#include "../utils/status.h"
+
+/*
+ * Type specialized, header only versions of Vector and BuffArr. The struct is
+ * not opaque and every accessor is static inline, so hot loops over them
+ * compile down to plain array accesses.
+ *
+ * The accessors do no NULL/bounds checks of their own, those are REQUIREs that
+ * only exist in debug builds. Use the opaque Vector/BuffArr where checked
+ * accesses are wanted.
+ *
+ * Usage:
+ *   VEC_DEFINE(U64Vec, u64)
+ *   U64Vec vec;
+ *   U64Vec_Init(&vec, 16, NULL);
+ *   U64Vec_Push(&vec, 42);
+ *   u64 val = U64Vec_Get(&vec, 0);
+ *   U64Vec_Deinit(&vec);
+ */
+
+// Memory of containers made without an allocator counts as MEM_CATEGORY_ARRAY.
+#define TYPED_ARR_ALLOCATOR(allocator)                                         \
+  ((allocator) ? *(allocator) : mem_HeapAllocatorWCategory(MEM_CATEGORY_ARRAY))
+
+/* ----  VECTOR  ---- */
+
+#define VEC_DEFINE(Name, Type)                                                 \
+  typedef struct {                                                             \
+    Type *mem;                                                                 \
+    u64 len;                                                                   \
+    u64 cap;                                                                   \
+    Allocator allocator;                                                       \
+  } Name;                                                                      \
+                                                                               \
+  /* The allocator is copied, a NULL allocator means the heap. */              \
+  static inline StatusCode Name##_Init(Name *arr, u64 cap,                     \
+                                       const Allocator *allocator) {           \
+    NULL_FUNC_ARG_ROUTINE(arr, NULL_EXCEPTION);                                \
+                                                                               \
+    arr->allocator = TYPED_ARR_ALLOCATOR(allocator);                           \
+    arr->len = 0;                                                              \
+    arr->cap = MAX(cap, 1);                                                    \
+    arr->mem = mem_Alloc(&arr->allocator, sizeof(Type) * arr->cap);            \
+    MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(arr->mem, CREATION_FAILURE);          \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  static inline StatusCode Name##_Deinit(Name *arr) {                          \
+    NULL_FUNC_ARG_ROUTINE(arr, NULL_EXCEPTION);                                \
+                                                                               \
+    /* Allows deiniting a zeroed, never initialized vector. */                 \
+    if (arr->mem) {                                                            \
+      mem_Free(&arr->allocator, arr->mem, sizeof(Type) * arr->cap);            \
+    }                                                                          \
+    arr->mem = NULL;                                                           \
+    arr->len = arr->cap = 0;                                                   \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  /* Grows the capacity to at least cap, never shrinks. */                     \
+  static inline StatusCode Name##_Reserve(Name *arr, u64 cap) {                \
+    if (cap <= arr->cap) {                                                     \
+      return SUCCESS;                                                          \
+    }                                                                          \
+                                                                               \
+    Type *new_mem = mem_Realloc(&arr->allocator, arr->mem,                     \
+                                sizeof(Type) * arr->cap, sizeof(Type) * cap);  \
+    MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(new_mem, CREATION_FAILURE);           \
+    arr->mem = new_mem;                                                        \
+    arr->cap = cap;                                                            \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  static inline StatusCode Name##_Push(Name *arr, Type val) {                  \
+    REQUIRE(arr && arr->mem);                                                  \
+                                                                               \
+    if (arr->len == arr->cap) {                                                \
+      IF_FUNC_FAILED(Name##_Reserve(arr, arr->cap * 2)) {                      \
+        return CREATION_FAILURE;                                               \
+      }                                                                        \
+    }                                                                          \
+    arr->mem[arr->len++] = val;                                                \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  static inline Type Name##_Pop(Name *arr) {                                   \
+    REQUIRE(arr && arr->len);                                                  \
+                                                                               \
+    return arr->mem[--arr->len];                                               \
+  }                                                                            \
+                                                                               \
+  static inline Type Name##_Get(const Name *arr, u64 i) {                      \
+    REQUIRE(arr && i < arr->len);                                              \
+                                                                               \
+    return arr->mem[i];                                                        \
+  }                                                                            \
+                                                                               \
+  static inline void Name##_Set(Name *arr, u64 i, Type val) {                  \
+    REQUIRE(arr && i < arr->len);                                              \
+                                                                               \
+    arr->mem[i] = val;                                                         \
+  }                                                                            \
+                                                                               \
+  static inline Type *Name##_At(const Name *arr, u64 i) {                      \
+    REQUIRE(arr && i < arr->len);                                              \
+                                                                               \
+    return &arr->mem[i];                                                       \
+  }                                                                            \
+                                                                               \
+  static inline u64 Name##_Len(const Name *arr) { return arr->len; }           \
+                                                                               \
+  static inline void Name##_Clear(Name *arr) { arr->len = 0; }
+
+/* ----  SMALL VECTOR  ---- */
+
+/*
+ * Same as VEC_DEFINE, but the first InlineCap elements live inside the struct
+ * and it only goes to the allocator once it outgrows them. Meant for the many
+ * vectors that stay tiny, where the malloc would cost more than the data.
+ *
+ * There is no pointer into the struct itself, so it can be memcpy'd around
+ * like any other value. The inline buffer and the heap pointer share storage,
+ * cap > InlineCap is what tells which one is in use. Use _Data for the raw
+ * elements, as the address changes when it spills.
+ */
+#define SVEC_DEFINE(Name, Type, InlineCap)                                     \
+  typedef struct {                                                             \
+    union {                                                                    \
+      Type inline_mem[InlineCap];                                              \
+      Type *heap_mem;                                                          \
+    };                                                                         \
+    u64 len;                                                                   \
+    u64 cap;                                                                   \
+    Allocator allocator;                                                       \
+  } Name;                                                                      \
+                                                                               \
+  /* The allocator is copied, a NULL allocator means the heap. */              \
+  static inline StatusCode Name##_Init(Name *arr,                              \
+                                       const Allocator *allocator) {           \
+    NULL_FUNC_ARG_ROUTINE(arr, NULL_EXCEPTION);                                \
+                                                                               \
+    arr->allocator = TYPED_ARR_ALLOCATOR(allocator);                           \
+    arr->len = 0;                                                              \
+    arr->cap = (InlineCap);                                                    \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  static inline bool Name##_IsInline(const Name *arr) {                        \
+    return arr->cap <= (InlineCap);                                            \
+  }                                                                            \
+                                                                               \
+  static inline Type *Name##_Data(Name *arr) {                                 \
+    return (Name##_IsInline(arr)) ? arr->inline_mem : arr->heap_mem;           \
+  }                                                                            \
+                                                                               \
+  static inline StatusCode Name##_Deinit(Name *arr) {                          \
+    NULL_FUNC_ARG_ROUTINE(arr, NULL_EXCEPTION);                                \
+                                                                               \
+    if (!Name##_IsInline(arr)) {                                               \
+      mem_Free(&arr->allocator, arr->heap_mem, sizeof(Type) * arr->cap);       \
+    }                                                                          \
+    arr->len = 0;                                                              \
+    arr->cap = (InlineCap);                                                    \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  /* Grows the capacity to at least cap, never shrinks or goes back inline. */ \
+  static inline StatusCode Name##_Reserve(Name *arr, u64 cap) {                \
+    if (cap <= arr->cap) {                                                     \
+      return SUCCESS;                                                          \
+    }                                                                          \
+                                                                               \
+    Type *new_mem;                                                             \
+    if (Name##_IsInline(arr)) {                                                \
+      new_mem = mem_Alloc(&arr->allocator, sizeof(Type) * cap);                \
+      MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(new_mem, CREATION_FAILURE);         \
+      memcpy(new_mem, arr->inline_mem, sizeof(Type) * arr->len);               \
+    } else {                                                                   \
+      new_mem = mem_Realloc(&arr->allocator, arr->heap_mem,                    \
+                            sizeof(Type) * arr->cap, sizeof(Type) * cap);      \
+      MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(new_mem, CREATION_FAILURE);         \
+    }                                                                          \
+    arr->heap_mem = new_mem;                                                   \
+    arr->cap = cap;                                                            \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  static inline StatusCode Name##_Push(Name *arr, Type val) {                  \
+    REQUIRE(arr);                                                              \
+                                                                               \
+    if (arr->len == arr->cap) {                                                \
+      IF_FUNC_FAILED(Name##_Reserve(arr, arr->cap * 2)) {                      \
+        return CREATION_FAILURE;                                               \
+      }                                                                        \
+    }                                                                          \
+    Name##_Data(arr)[arr->len++] = val;                                        \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  static inline Type Name##_Pop(Name *arr) {                                   \
+    REQUIRE(arr && arr->len);                                                  \
+                                                                               \
+    return Name##_Data(arr)[--arr->len];                                       \
+  }                                                                            \
+                                                                               \
+  static inline Type Name##_Get(Name *arr, u64 i) {                            \
+    REQUIRE(arr && i < arr->len);                                              \
+                                                                               \
+    return Name##_Data(arr)[i];                                                \
+  }                                                                            \
+                                                                               \
+  static inline void Name##_Set(Name *arr, u64 i, Type val) {                  \
+    REQUIRE(arr && i < arr->len);                                              \
+                                                                               \
+    Name##_Data(arr)[i] = val;                                                 \
+  }                                                                            \
+                                                                               \
+  static inline Type *Name##_At(Name *arr, u64 i) {                            \
+    REQUIRE(arr && i < arr->len);                                              \
+                                                                               \
+    return &Name##_Data(arr)[i];                                               \
+  }                                                                            \
+                                                                               \
+  static inline u64 Name##_Len(const Name *arr) { return arr->len; }           \
+                                                                               \
+  static inline void Name##_Clear(Name *arr) { arr->len = 0; }
+
+/* ----  BUFFER ARRAY  ---- */
+
+#define BUFF_ARR_DEFINE(Name, Type)                                            \
+  typedef struct {                                                             \
+    Type *mem;                                                                 \
+    u64 cap;                                                                   \
+    Allocator allocator;                                                       \
+  } Name;                                                                      \
+                                                                               \
+  /* Zeroed on creation, same as BuffArr. */                                   \
+  static inline StatusCode Name##_Init(Name *arr, u64 cap,                     \
+                                       const Allocator *allocator) {           \
+    NULL_FUNC_ARG_ROUTINE(arr, NULL_EXCEPTION);                                \
+                                                                               \
+    arr->allocator = TYPED_ARR_ALLOCATOR(allocator);                           \
+    arr->cap = cap;                                                            \
+    arr->mem = mem_Calloc(&arr->allocator, sizeof(Type) * cap);                \
+    MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(arr->mem, CREATION_FAILURE);          \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  static inline StatusCode Name##_Deinit(Name *arr) {                          \
+    NULL_FUNC_ARG_ROUTINE(arr, NULL_EXCEPTION);                                \
+                                                                               \
+    if (arr->mem) {                                                            \
+      mem_Free(&arr->allocator, arr->mem, sizeof(Type) * arr->cap);            \
+    }                                                                          \
+    arr->mem = NULL;                                                           \
+    arr->cap = 0;                                                              \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  /* The new elements are zeroed. */                                           \
+  static inline StatusCode Name##_Grow(Name *arr, u64 new_cap) {               \
+    if (new_cap <= arr->cap) {                                                 \
+      return SUCCESS;                                                          \
+    }                                                                          \
+                                                                               \
+    Type *new_mem =                                                            \
+        mem_Realloc(&arr->allocator, arr->mem, sizeof(Type) * arr->cap,        \
+                    sizeof(Type) * new_cap);                                   \
+    MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(new_mem, CREATION_FAILURE);           \
+    memset(new_mem + arr->cap, 0, sizeof(Type) * (new_cap - arr->cap));        \
+    arr->mem = new_mem;                                                        \
+    arr->cap = new_cap;                                                        \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  static inline Type Name##_Get(const Name *arr, u64 i) {                      \
+    REQUIRE(arr && i < arr->cap);                                              \
+                                                                               \
+    return arr->mem[i];                                                        \
+  }                                                                            \
+                                                                               \
+  static inline void Name##_Set(Name *arr, u64 i, Type val) {                  \
+    REQUIRE(arr && i < arr->cap);                                              \
+                                                                               \
+    arr->mem[i] = val;                                                         \
+  }                                                                            \
+                                                                               \
+  static inline Type *Name##_At(const Name *arr, u64 i) {                      \
+    REQUIRE(arr && i < arr->cap);                                              \
+                                                                               \
+    return &arr->mem[i];                                                       \
+  }                                                                            \
+                                                                               \
+  static inline u64 Name##_Cap(const Name *arr) { return arr->cap; }           \
+                                                                               \
+  static inline void Name##_Reset(Name *arr) {                                 \
+    memset(arr->mem, 0, sizeof(Type) * arr->cap);                              \
+  }
+
+// Commonly used instantiations.
+VEC_DEFINE(U64Vec, u64)
+
+#ifdef __cplusplus
+}
+#endif
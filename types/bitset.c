@@ -0,0 +1,161 @@
+#include "bitset.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BITSET_SIMD_WORDS (4)
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BITSET_SIMD_WORDS (2)
+#else
+#define BITSET_SIMD_WORDS (0)
+#endif
+
+/*
+ * Generates the binary set ops. The vector loop handles whole registers and the
+ * scalar loop the remaining words, or all of them when there is no SIMD.
+ */
+#if BITSET_SIMD_WORDS == 4
+#define BITSET_BINARY_OP(Name, simd_op, scalar_op)                             \
+  void bitset_##Name(u64 *dest, const u64 *a, const u64 *b, u64 word_count) {  \
+    u64 i = 0;                                                                 \
+    for (; i + 4 <= word_count; i += 4) {                                      \
+      __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));               \
+      __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));               \
+      _mm256_storeu_si256((__m256i *)(dest + i), simd_op);                     \
+    }                                                                          \
+    for (; i < word_count; i++) {                                              \
+      dest[i] = scalar_op;                                                     \
+    }                                                                          \
+  }
+#define SIMD_AND _mm256_and_si256(va, vb)
+#define SIMD_OR _mm256_or_si256(va, vb)
+#define SIMD_ANDNOT _mm256_andnot_si256(vb, va)
+#define SIMD_XOR _mm256_xor_si256(va, vb)
+#elif BITSET_SIMD_WORDS == 2
+#define BITSET_BINARY_OP(Name, simd_op, scalar_op)                             \
+  void bitset_##Name(u64 *dest, const u64 *a, const u64 *b, u64 word_count) {  \
+    u64 i = 0;                                                                 \
+    for (; i + 2 <= word_count; i += 2) {                                      \
+      __m128i va = _mm_loadu_si128((const __m128i *)(a + i));                  \
+      __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));                  \
+      _mm_storeu_si128((__m128i *)(dest + i), simd_op);                        \
+    }                                                                          \
+    for (; i < word_count; i++) {                                              \
+      dest[i] = scalar_op;                                                     \
+    }                                                                          \
+  }
+#define SIMD_AND _mm_and_si128(va, vb)
+#define SIMD_OR _mm_or_si128(va, vb)
+#define SIMD_ANDNOT _mm_andnot_si128(vb, va)
+#define SIMD_XOR _mm_xor_si128(va, vb)
+#else
+#define BITSET_BINARY_OP(Name, simd_op, scalar_op)                             \
+  void bitset_##Name(u64 *dest, const u64 *a, const u64 *b, u64 word_count) {  \
+    for (u64 i = 0; i < word_count; i++) {                                     \
+      dest[i] = scalar_op;                                                     \
+    }                                                                          \
+  }
+#endif
+
+BITSET_BINARY_OP(And, SIMD_AND, a[i] & b[i])
+BITSET_BINARY_OP(Or, SIMD_OR, a[i] | b[i])
+BITSET_BINARY_OP(AndNot, SIMD_ANDNOT, a[i] & ~b[i])
+BITSET_BINARY_OP(Xor, SIMD_XOR, a[i] ^ b[i])
+
+bool bitset_IsSubset(const u64 *sub, const u64 *super, u64 word_count) {
+  u64 i = 0;
+
+#if BITSET_SIMD_WORDS == 4
+  for (; i + 4 <= word_count; i += 4) {
+    __m256i vsub = _mm256_loadu_si256((const __m256i *)(sub + i));
+    __m256i vsuper = _mm256_loadu_si256((const __m256i *)(super + i));
+    // Carry flag is set when (~vsuper & vsub) == 0.
+    if (!_mm256_testc_si256(vsuper, vsub)) {
+      return false;
+    }
+  }
+#elif BITSET_SIMD_WORDS == 2
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 2 <= word_count; i += 2) {
+    __m128i vsub = _mm_loadu_si128((const __m128i *)(sub + i));
+    __m128i vsuper = _mm_loadu_si128((const __m128i *)(super + i));
+    __m128i missing = _mm_andnot_si128(vsuper, vsub);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(missing, zero)) != 0xFFFF) {
+      return false;
+    }
+  }
+#endif
+
+  for (; i < word_count; i++) {
+    if (sub[i] & ~super[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool bitset_IsEmpty(const u64 *words, u64 word_count) {
+  u64 i = 0;
+
+#if BITSET_SIMD_WORDS == 4
+  for (; i + 4 <= word_count; i += 4) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(words + i));
+    if (!_mm256_testz_si256(v, v)) {
+      return false;
+    }
+  }
+#elif BITSET_SIMD_WORDS == 2
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 2 <= word_count; i += 2) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(words + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xFFFF) {
+      return false;
+    }
+  }
+#endif
+
+  for (; i < word_count; i++) {
+    if (words[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+u64 bitset_PopCount(const u64 *words, u64 word_count) {
+  /*
+   * Left to popcnt per word, which the compiler unrolls and vectorizes where
+   * the target has it. A pshufb lookup only wins on much longer sets than
+   * what we keep.
+   */
+  u64 count = 0;
+  for (u64 i = 0; i < word_count; i++) {
+    count += bitset_WordPopCount(words[i]);
+  }
+
+  return count;
+}
+
+u64 bitset_FindFirst(const u64 *words, u64 word_count) {
+  return bitset_FindNext(words, word_count, 0);
+}
+
+u64 bitset_FindNext(const u64 *words, u64 word_count, u64 from_bit) {
+  u64 word_i = from_bit / BITSET_WORD_BITS;
+  if (word_i >= word_count) {
+    return INVALID_INDEX;
+  }
+
+  // Masking off the bits below from_bit in its own word.
+  u64 word = words[word_i] & (~(u64)0 << (from_bit % BITSET_WORD_BITS));
+  while (!word) {
+    if (++word_i >= word_count) {
+      return INVALID_INDEX;
+    }
+    word = words[word_i];
+  }
+
+  return word_i * BITSET_WORD_BITS + bitset_WordCountTrailingZeros(word);
+}
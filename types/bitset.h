@@ -0,0 +1,132 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../utils/common.h"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#pragma intrinsic(_BitScanForward64)
+#endif // defined(_MSC_VER) && !defined(__clang__)
+
+/*
+ * A bitset here is just a raw array of u64 words, bit i living in word i / 64.
+ * That way it can sit inside a BuffArr, a typed array or on the stack, and
+ * these functions only need the words and how many of them there are.
+ *
+ * The set operations take the word count of the smallest of the operands, dest
+ * may alias either of them. They are vectorized with AVX2/SSE2 when the build
+ * targets them, and scalar otherwise.
+ */
+
+#define BITSET_WORD_BITS (64)
+#define BITSET_WORD_COUNT(bit_count)                                           \
+  (((bit_count) + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS)
+
+/* ----  WORD HELPERS  ---- */
+
+// Undefined for zero, same as the builtins.
+static inline u64 bitset_WordCountTrailingZeros(u64 word) {
+#if defined(__GNUC__) || defined(__clang__)
+  return (u64)__builtin_ctzll(word);
+#elif defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, word);
+  return (u64)index;
+#else
+  u64 n = 0;
+  while ((word & 1) == 0) {
+    word >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+static inline u64 bitset_WordPopCount(u64 word) {
+#if defined(__GNUC__) || defined(__clang__)
+  return (u64)__builtin_popcountll(word);
+#else
+  // SWAR popcount.
+  word = word - ((word >> 1) & 0x5555555555555555ULL);
+  word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+  word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (word * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+/* ----  SINGLE BIT  ---- */
+
+static inline void bitset_Set(u64 *words, u64 bit) {
+  words[bit / BITSET_WORD_BITS] |= (u64)1 << (bit % BITSET_WORD_BITS);
+}
+
+static inline void bitset_Clear(u64 *words, u64 bit) {
+  words[bit / BITSET_WORD_BITS] &= ~((u64)1 << (bit % BITSET_WORD_BITS));
+}
+
+static inline bool bitset_Test(const u64 *words, u64 bit) {
+  return HAS_FLAG(words[bit / BITSET_WORD_BITS],
+                  (u64)1 << (bit % BITSET_WORD_BITS));
+}
+
+/* ----  SET OPERATIONS  ---- */
+
+void bitset_And(u64 *dest, const u64 *a, const u64 *b, u64 word_count);
+void bitset_Or(u64 *dest, const u64 *a, const u64 *b, u64 word_count);
+// dest = a & ~b
+void bitset_AndNot(u64 *dest, const u64 *a, const u64 *b, u64 word_count);
+void bitset_Xor(u64 *dest, const u64 *a, const u64 *b, u64 word_count);
+// True if every bit set in sub is also set in super.
+bool bitset_IsSubset(const u64 *sub, const u64 *super, u64 word_count);
+bool bitset_IsEmpty(const u64 *words, u64 word_count);
+u64 bitset_PopCount(const u64 *words, u64 word_count);
+// Both return INVALID_INDEX when there is no set bit left.
+u64 bitset_FindFirst(const u64 *words, u64 word_count);
+u64 bitset_FindNext(const u64 *words, u64 word_count, u64 from_bit);
+
+/* ----  ITERATION  ---- */
+
+/*
+ * Walks the set bits in increasing order:
+ *   BitsetIter iter = bitset_IterCreate(words, word_count);
+ *   for (u64 bit; (bit = bitset_IterNext(&iter)) != INVALID_INDEX;) { ... }
+ *
+ * The words must not change while iterating.
+ */
+typedef struct {
+  const u64 *words;
+  u64 word_count;
+  u64 word_i;
+  // What is left of words[word_i], bits already returned are cleared.
+  u64 curr;
+} BitsetIter;
+
+static inline BitsetIter bitset_IterCreate(const u64 *words, u64 word_count) {
+  BitsetIter iter = {words, word_count, 0, (word_count) ? words[0] : 0};
+
+  return iter;
+}
+
+static inline u64 bitset_IterNext(BitsetIter *iter) {
+  while (!iter->curr) {
+    if (++iter->word_i >= iter->word_count) {
+      // Keeps returning INVALID_INDEX if called again.
+      iter->word_i = iter->word_count;
+      return INVALID_INDEX;
+    }
+    iter->curr = iter->words[iter->word_i];
+  }
+
+  u64 bit = bitset_WordCountTrailingZeros(iter->curr);
+  // Clearing the lowest set bit.
+  iter->curr &= iter->curr - 1;
+
+  return iter->word_i * BITSET_WORD_BITS + bit;
+}
+
+#ifdef __cplusplus
+}
+#endif
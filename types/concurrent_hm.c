@@ -0,0 +1,195 @@
+// For pthread_rwlock_t, which is hidden by -std=c17 otherwise.
+#define _POSIX_C_SOURCE 200809L
+
+#include "concurrent_hm.h"
+#include <pthread.h>
+
+/*
+ * Please make sure SHARD_COUNT is a power of 2. 64 shards keep the chance of
+ * two threads hitting the same shard low up to a few dozen cores.
+ */
+#define SHARD_COUNT (64)
+#define SHARD_SHIFT (58) // 64 - log2(SHARD_COUNT)
+/*
+ * The top bits of the hash pick the shard, as the shard's Hm uses the low bits
+ * for its own bucket index. The hash is mixed first, since identity hashes of
+ * small integer keys have no top bits at all.
+ */
+#define HASH_TO_SHARD(hash) (MixShardHash(hash) >> SHARD_SHIFT)
+
+typedef struct {
+  // Each shard sits in its own cache lines so the locks don't false share.
+  _Alignas(CACHE_LINE_SIZE) pthread_rwlock_t lock;
+  Hm *hm;
+} ChmShard;
+
+// 64-bit finalizer (from MurmurHash3)
+static inline u64 MixShardHash(u64 x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+
+  return x;
+}
+
+struct __ConcurrentHm {
+  ChmShard shards[SHARD_COUNT];
+  // Same as the one each shard has, but needed to pick the shard.
+  u64 (*hash_func)(const void *key);
+};
+
+ConcurrentHm *chm_Create(u64 (*hash_func)(const void *key),
+                         bool (*cmp_func)(const void *key,
+                                          const void *compare_key),
+                         StatusCode (*key_delete_callback)(void *key),
+                         StatusCode (*val_delete_callback)(void *val)) {
+  NULL_FUNC_ARG_ROUTINE(hash_func, NULL);
+  NULL_FUNC_ARG_ROUTINE(cmp_func, NULL);
+
+  // sizeof is already a multiple of the alignment due to the _Alignas.
+  ConcurrentHm *chm = aligned_alloc(CACHE_LINE_SIZE, sizeof(ConcurrentHm));
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(chm, NULL);
+  memset(chm, 0, sizeof(ConcurrentHm));
+
+  chm->hash_func = hash_func;
+
+  for (u64 i = 0; i < SHARD_COUNT; i++) {
+    chm->shards[i].hm = hm_Create(hash_func, cmp_func, key_delete_callback,
+                                  val_delete_callback);
+    IF_NULL(chm->shards[i].hm) {
+      chm_Delete(chm);
+      MEM_ALLOC_FAILURE_SUB_ROUTINE(chm->shards[i].hm, NULL);
+    }
+    pthread_rwlock_init(&chm->shards[i].lock, NULL);
+  }
+
+  return chm;
+}
+
+StatusCode chm_Delete(ConcurrentHm *chm) {
+  NULL_FUNC_ARG_ROUTINE(chm, NULL_EXCEPTION);
+
+  // Caller guarantees no other thread is using the hashmap anymore.
+  for (u64 i = 0; i < SHARD_COUNT; i++) {
+    if (chm->shards[i].hm) {
+      hm_Delete(chm->shards[i].hm);
+      pthread_rwlock_destroy(&chm->shards[i].lock);
+    }
+  }
+  free(chm);
+
+  return SUCCESS;
+}
+
+StatusCode chm_SetResizeMode(ConcurrentHm *chm, HmResizeModes mode) {
+  NULL_FUNC_ARG_ROUTINE(chm, NULL_EXCEPTION);
+
+  for (u64 i = 0; i < SHARD_COUNT; i++) {
+    pthread_rwlock_wrlock(&chm->shards[i].lock);
+    StatusCode code = hm_SetResizeMode(chm->shards[i].hm, mode);
+    pthread_rwlock_unlock(&chm->shards[i].lock);
+    IF_FUNC_FAILED(code) { return code; }
+  }
+
+  return SUCCESS;
+}
+
+StatusCode chm_AddEntry(ConcurrentHm *chm, void *key, void *val,
+                        HmAddModes mode) {
+  NULL_FUNC_ARG_ROUTINE(chm, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(key, NULL_EXCEPTION);
+
+  u64 hash = chm->hash_func(key);
+  ChmShard *shard = &chm->shards[HASH_TO_SHARD(hash)];
+
+  pthread_rwlock_wrlock(&shard->lock);
+  StatusCode code = hm_AddEntryWHash(shard->hm, key, hash, val, mode);
+  pthread_rwlock_unlock(&shard->lock);
+
+  return code;
+}
+
+void *chm_GetEntry(ConcurrentHm *chm, void *key) {
+  NULL_FUNC_ARG_ROUTINE(chm, NULL);
+  NULL_FUNC_ARG_ROUTINE(key, NULL);
+
+  u64 hash = chm->hash_func(key);
+  ChmShard *shard = &chm->shards[HASH_TO_SHARD(hash)];
+
+  pthread_rwlock_rdlock(&shard->lock);
+  void *val = hm_GetEntryWHash(shard->hm, key, hash);
+  pthread_rwlock_unlock(&shard->lock);
+
+  return val;
+}
+
+StatusCode chm_ViewEntry(ConcurrentHm *chm, void *key,
+                         void (*view_callback)(void *val, void *ctx),
+                         void *ctx) {
+  NULL_FUNC_ARG_ROUTINE(chm, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(key, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(view_callback, NULL_EXCEPTION);
+
+  u64 hash = chm->hash_func(key);
+  ChmShard *shard = &chm->shards[HASH_TO_SHARD(hash)];
+  StatusCode code = SUCCESS;
+
+  pthread_rwlock_rdlock(&shard->lock);
+  void *val = hm_GetEntryWHash(shard->hm, key, hash);
+  if (val) {
+    view_callback(val, ctx);
+  } else {
+    code = OUT_OF_BOUNDS_ACCESS;
+  }
+  pthread_rwlock_unlock(&shard->lock);
+
+  return code;
+}
+
+StatusCode chm_DeleteEntry(ConcurrentHm *chm, void *key) {
+  NULL_FUNC_ARG_ROUTINE(chm, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(key, NULL_EXCEPTION);
+
+  u64 hash = chm->hash_func(key);
+  ChmShard *shard = &chm->shards[HASH_TO_SHARD(hash)];
+
+  pthread_rwlock_wrlock(&shard->lock);
+  StatusCode code = hm_DeleteEntryWHash(shard->hm, key, hash);
+  pthread_rwlock_unlock(&shard->lock);
+
+  return code;
+}
+
+u64 chm_GetLen(ConcurrentHm *chm) {
+  NULL_FUNC_ARG_ROUTINE(chm, INVALID_INDEX);
+
+  /*
+   * Each shard is read under its lock, but the total is not a snapshot of the
+   * whole hashmap if other threads are writing at the same time.
+   */
+  u64 len = 0;
+  for (u64 i = 0; i < SHARD_COUNT; i++) {
+    pthread_rwlock_rdlock(&chm->shards[i].lock);
+    len += hm_GetLen(chm->shards[i].hm);
+    pthread_rwlock_unlock(&chm->shards[i].lock);
+  }
+
+  return len;
+}
+
+StatusCode chm_ForEach(ConcurrentHm *chm,
+                       void (*foreach_callback)(void *key, void *val)) {
+  NULL_FUNC_ARG_ROUTINE(chm, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(foreach_callback, NULL_EXCEPTION);
+
+  // The callback runs under the shard's read lock, so it must not write to chm.
+  for (u64 i = 0; i < SHARD_COUNT; i++) {
+    pthread_rwlock_rdlock(&chm->shards[i].lock);
+    hm_ForEach(chm->shards[i].hm, foreach_callback);
+    pthread_rwlock_unlock(&chm->shards[i].lock);
+  }
+
+  return SUCCESS;
+}
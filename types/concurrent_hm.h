@@ -0,0 +1,43 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../utils/common.h"
+#include "../utils/status.h"
+#include "hm.h"
+
+/*
+ * A thread safe Hm. The keys are spread over a fixed number of shards by their
+ * hash, and each shard is a normal Hm behind its own reader-writer lock. So
+ * every operation is linearizable, readers never block each other and writers
+ * only block the operations landing in the same shard.
+ *
+ * NOTE: The pointer returned by chm_GetEntry is only safe to use as long as no
+ * other thread deletes that entry. Use chm_ViewEntry to read the value while
+ * still holding the shard lock.
+ */
+typedef struct __ConcurrentHm ConcurrentHm;
+
+ConcurrentHm *chm_Create(u64 (*hash_func)(const void *key),
+                         bool (*cmp_func)(const void *key,
+                                          const void *compare_key),
+                         StatusCode (*key_delete_callback)(void *key),
+                         StatusCode (*val_delete_callback)(void *val));
+StatusCode chm_Delete(ConcurrentHm *chm);
+StatusCode chm_SetResizeMode(ConcurrentHm *chm, HmResizeModes mode);
+StatusCode chm_AddEntry(ConcurrentHm *chm, void *key, void *val,
+                        HmAddModes mode);
+void *chm_GetEntry(ConcurrentHm *chm, void *key);
+StatusCode chm_ViewEntry(ConcurrentHm *chm, void *key,
+                         void (*view_callback)(void *val, void *ctx),
+                         void *ctx);
+StatusCode chm_DeleteEntry(ConcurrentHm *chm, void *key);
+u64 chm_GetLen(ConcurrentHm *chm);
+StatusCode chm_ForEach(ConcurrentHm *chm,
+                       void (*foreach_callback)(void *key, void *val));
+
+#ifdef __cplusplus
+}
+#endif
@@ -10,13 +10,38 @@
 #define PERTURB_CONST (5)
 #define PERTURB_SHIFT (5)
 #define LOAD_FACTOR (0.66)
+/*
+ * The structure is shrunk once the live entries fall below this fraction of its
+ * capacity. Kept well below LOAD_FACTOR / 2 so that a shrunk structure doesn't
+ * immediately grow back on the next few adds.
+ */
+#define SHRINK_FACTOR (0.125)
+/*
+ * Number of old structure buckets moved to the new structure per mutating
+ * operation in HM_RESIZE_INCREMENTAL mode. Anything >= 2 finishes a migration
+ * before the new structure can fill up, this just bounds the per op cost.
+ */
+#define MIGRATE_BUCKETS_PER_OP (32)
+/*
+ * Number of keys hm_GetEntries has in flight at once. Enough to cover DRAM
+ * latency with the entries/structure prefetches, while the hashes still fit in
+ * a couple of cache lines on the stack.
+ */
+#define GET_ENTRIES_BATCH_SIZE (16)
 
-#define EMPTY_INDEX (UINT64_MAX)
+/*
+ * Values stored in the structure. Empty is 0 so that a freshly created (zeroed)
+ * structure needs no extra initialization pass, which matters for big resizes.
+ */
+#define EMPTY_SLOT (0)
 /*
  * This will be used in the probing algorithm to not stop searching early giving
  * false negatives.
  */
-#define TOMBSTONE_INDEX (UINT64_MAX - 1)
+#define TOMBSTONE_SLOT (1)
+// Entry index i is stored as i + 2 to make space for the 2 values above.
+#define ENTRY_INDEX_TO_SLOT(i) ((i) + 2)
+#define SLOT_TO_ENTRY_INDEX(slot) ((slot) - 2)
 
 #define PROBER(i, perturb, mask)                                               \
   i = (PERTURB_CONST * i + 1 + perturb) & mask;                                \
@@ -45,6 +70,21 @@ struct __Hm {
    * save memory.
    */
   Vector *entries;
+  /*
+   * Number of TOMBSTONE_SLOT slots in the structure. They count towards the
+   * load factor, as they lengthen the probe chains just like live entries.
+   */
+  u64 tombstones;
+  /*
+   * Only non NULL while an incremental resize is in progress. Buckets below
+   * migrate_pos have already been moved to structure and are marked as
+   * tombstones here, so the probe chains of the rest still hold up.
+   */
+  BuffArr *old_structure;
+  u64 migrate_pos;
+  HmResizeModes resize_mode;
+  // The hm itself, its structures and its entries come from this.
+  Allocator allocator;
   /*
    * User defined hash function so that the hashmap can be a general hashmap
    * that can store even things like structs and compound types.
@@ -59,17 +99,24 @@ struct __Hm {
    * duplicate.
    */
   bool (*cmp_func)(const void *key, const void *compare_key);
-  // Frees the memory of the key during the entry/hashmap deletion.
+  /*
+   * Frees the memory of the key during the entry/hashmap deletion. Can be NULL
+   * if the hashmap doesn't own its keys.
+   */
   StatusCode (*key_delete_callback)(void *key);
-  // Frees the memory of the val during the entry/hashmap deletion.
+  // Same as above but for the val.
   StatusCode (*val_delete_callback)(void *val);
 };
 
 // static inline u64 SplitMixU64Hash(u64 x);
-static u64 GrowHmStructureCallback(u64 old_cap);
 static u64 GrowHmEntriesCallback(u64 old_cap);
-static StatusCode GrowHmStructure(Hm *hm);
-static StatusCode FetchHmStructureEntryIndices(Hm *hm, void *key,
+static StatusCode ResizeHmStructure(Hm *hm, u64 new_cap, bool incremental);
+static StatusCode ShrinkHmStructure(Hm *hm);
+static void MigrateHmBuckets(Hm *hm, u64 count);
+static u64 ProbeHmStructure(const Hm *hm, const BuffArr *structure_arr,
+                            const void *key, u64 hash);
+static StatusCode FetchHmStructureEntryIndices(Hm *hm, const void *key,
+                                               u64 hash, u64 **pStructure,
                                                u64 *pStructure_i,
                                                u64 *pEntry_i);
 
@@ -85,35 +132,51 @@ Hm *hm_Create(u64 (*hash_func)(const void *key),
               bool (*cmp_func)(const void *key, const void *compare_key),
               StatusCode (*key_delete_callback)(void *key),
               StatusCode (*val_delete_callback)(void *val)) {
+  return hm_CreateWAllocator(hash_func, cmp_func, key_delete_callback,
+                             val_delete_callback, NULL);
+}
+
+Hm *hm_CreateWAllocator(
+    u64 (*hash_func)(const void *key),
+    bool (*cmp_func)(const void *key, const void *compare_key),
+    StatusCode (*key_delete_callback)(void *key),
+    StatusCode (*val_delete_callback)(void *val), const Allocator *allocator) {
   NULL_FUNC_ARG_ROUTINE(hash_func, NULL);
   NULL_FUNC_ARG_ROUTINE(cmp_func, NULL);
-  NULL_FUNC_ARG_ROUTINE(key_delete_callback, NULL);
-  NULL_FUNC_ARG_ROUTINE(val_delete_callback, NULL);
+  // Delete callbacks can be NULL for non-owning maps.
+
+  Allocator alloc = (allocator)
+                        ? *allocator
+                        : mem_HeapAllocatorWCategory(MEM_CATEGORY_HASHMAP);
 
-  Hm *hm = malloc(sizeof(Hm));
+  Hm *hm = mem_Alloc(&alloc, sizeof(Hm));
   MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(hm, NULL);
 
+  hm->allocator = alloc;
   hm->hash_func = hash_func;
   hm->cmp_func = cmp_func;
   hm->key_delete_callback = key_delete_callback;
   hm->val_delete_callback = val_delete_callback;
+  hm->tombstones = 0;
+  hm->old_structure = NULL;
+  hm->migrate_pos = 0;
+  hm->resize_mode = HM_RESIZE_IMMEDIATE;
 
-  hm->structure = arr_BuffArrCreate(sizeof(u64), MIN_HASH_BUCKET_SIZE);
+  hm->structure = arr_BuffArrCreateWAllocator(
+      sizeof(u64), MIN_HASH_BUCKET_SIZE, &hm->allocator);
   IF_NULL(hm->structure) {
-    free(hm);
+    mem_Free(&alloc, hm, sizeof(Hm));
     MEM_ALLOC_FAILURE_SUB_ROUTINE(hm->mem, NULL);
   }
 
-  hm->entries = arr_VectorCreate(sizeof(HmEntries));
+  hm->entries = arr_VectorCreateWAllocator(
+      sizeof(HmEntries), MIN_HASH_BUCKET_SIZE, &hm->allocator);
   IF_NULL(hm->entries) {
     arr_BuffArrDelete(hm->structure);
-    free(hm);
+    mem_Free(&alloc, hm, sizeof(Hm));
     MEM_ALLOC_FAILURE_SUB_ROUTINE(hm->mem, NULL);
   }
-
-  HmEntries *structure = arr_BuffArrRaw(hm->structure);
-  // This will set each index to EMPTY, as memset works per byte.
-  memset(structure, 0xFF, sizeof(u64) * MIN_HASH_BUCKET_SIZE);
+  // The BuffArr is created zeroed, so every slot already is EMPTY_SLOT.
 
   return hm;
 }
@@ -124,78 +187,209 @@ StatusCode hm_Delete(Hm *hm) {
   if (hm->structure) {
     arr_BuffArrDelete(hm->structure);
   }
+  if (hm->old_structure) {
+    arr_BuffArrDelete(hm->old_structure);
+  }
   if (hm->entries) {
     HmEntries *entries = arr_VectorRaw(hm->entries);
     u64 len = arr_VectorLen(hm->entries);
     for (u64 i = 0; i < len; i++) {
-      hm->key_delete_callback(entries[i].key);
-      hm->val_delete_callback(entries[i].val);
+      if (hm->key_delete_callback) {
+        hm->key_delete_callback(entries[i].key);
+      }
+      if (hm->val_delete_callback) {
+        hm->val_delete_callback(entries[i].val);
+      }
     }
     arr_VectorDelete(hm->entries);
   }
-  free(hm);
+  Allocator allocator = hm->allocator;
+  mem_Free(&allocator, hm, sizeof(Hm));
 
   return SUCCESS;
 }
 
-static u64 GrowHmStructureCallback(u64 old_cap) { return old_cap * 2; }
+StatusCode hm_SetResizeMode(Hm *hm, HmResizeModes mode) {
+  NULL_FUNC_ARG_ROUTINE(hm, NULL_EXCEPTION);
+  if (mode != HM_RESIZE_IMMEDIATE && mode != HM_RESIZE_INCREMENTAL) {
+    STATUS_LOG(FAILURE, "Invalid mode provided to set hashmap resize mode.");
+    return FAILURE;
+  }
+
+  if (mode == HM_RESIZE_IMMEDIATE && hm->old_structure) {
+    // Finishing any in progress migration, as immediate mode never has one.
+    MigrateHmBuckets(hm, arr_BuffArrCap(hm->old_structure));
+  }
+  hm->resize_mode = mode;
 
-static u64 GrowHmEntriesCallback(u64 old_cap) {
-  return old_cap + MIN_HASH_BUCKET_SIZE;
+  return SUCCESS;
 }
 
-static StatusCode GrowHmStructure(Hm *hm) {
-  IF_FUNC_FAILED(
-      arr_BuffArrGrowWCallback(hm->structure, GrowHmStructureCallback)) {
-    STATUS_LOG(FAILURE, "Cannot grow hashmap.");
+// Geometric growth, to keep the amortized cost of the reallocs O(1) per add.
+static u64 GrowHmEntriesCallback(u64 old_cap) { return old_cap * 2; }
+
+/*
+ * Rebuilds the structure with new_cap buckets, which can be bigger, smaller or
+ * the same as the current cap. All the tombstones are dropped in the process.
+ *
+ * If incremental this only swaps in the new empty structure, and the entries
+ * are moved over by MigrateHmBuckets during the later operations. Otherwise
+ * it rehashes the entries array, which drops any old structure as is.
+ */
+static StatusCode ResizeHmStructure(Hm *hm, u64 new_cap, bool incremental) {
+  if (incremental && hm->old_structure) {
+    /*
+     * Should be rare, as the migration rate finishes it way before the new
+     * structure fills up. Only one old structure is kept at a time.
+     */
+    MigrateHmBuckets(hm, arr_BuffArrCap(hm->old_structure));
+  }
+
+  BuffArr *new_structure =
+      arr_BuffArrCreateWAllocator(sizeof(u64), new_cap, &hm->allocator);
+  IF_NULL(new_structure) {
+    STATUS_LOG(FAILURE, "Cannot resize hashmap.");
     return FAILURE;
   }
+  u64 *structure = arr_BuffArrRaw(new_structure);
+
+  if (incremental) {
+    hm->old_structure = hm->structure;
+    hm->migrate_pos = 0;
+    hm->structure = new_structure;
+    hm->tombstones = 0;
+    return SUCCESS;
+  }
 
-  u64 mask = arr_BuffArrCap(hm->structure) - 1;
+  u64 mask = new_cap - 1;
   HmEntries *entries = arr_VectorRaw(hm->entries);
-  u64 *structure = arr_BuffArrRaw(hm->structure);
+  u64 len = hm_GetLen(hm);
 
-  // First setting each index to empty for proper hashing.
-  memset(structure, 0xFF, sizeof(u64) * arr_BuffArrCap(hm->structure));
-  // Rehashing due to size increase.
-  for (u64 i = 0; i < hm_GetLen(hm); i++) {
+  for (u64 i = 0; i < len; i++) {
     u64 perturb = entries[i].hash, j = perturb & mask;
-    while (structure[j] != EMPTY_INDEX) {
+    while (structure[j] != EMPTY_SLOT) {
       PROBER(j, perturb, mask);
     }
-    structure[j] = i;
+    structure[j] = ENTRY_INDEX_TO_SLOT(i);
   }
 
+  if (hm->old_structure) {
+    arr_BuffArrDelete(hm->old_structure);
+    hm->old_structure = NULL;
+    hm->migrate_pos = 0;
+  }
+  arr_BuffArrDelete(hm->structure);
+  hm->structure = new_structure;
+  hm->tombstones = 0;
+
   return SUCCESS;
 }
 
+static StatusCode ShrinkHmStructure(Hm *hm) {
+  u64 len = hm_GetLen(hm);
+  u64 new_cap = arr_BuffArrCap(hm->structure);
+
+  // Halve until the live entries take about a third of the structure.
+  while (new_cap / 2 >= MIN_HASH_BUCKET_SIZE &&
+         len < (new_cap / 2) * LOAD_FACTOR / 2) {
+    new_cap /= 2;
+  }
+  if (new_cap == arr_BuffArrCap(hm->structure)) {
+    return SUCCESS;
+  }
+
+  /*
+   * Never incremental, as migrating a big old structure at a few buckets per op
+   * would keep it around long enough for a grow to have to finish it at once.
+   * Rehashing the few live entries is cheap anyway, it's what shrinks them.
+   */
+  return ResizeHmStructure(hm, new_cap, false);
+}
+
+static void MigrateHmBuckets(Hm *hm, u64 count) {
+  IF_NULL(hm->old_structure) { return; }
+
+  u64 old_cap = arr_BuffArrCap(hm->old_structure);
+  u64 *old_structure = arr_BuffArrRaw(hm->old_structure);
+  u64 *structure = arr_BuffArrRaw(hm->structure);
+  u64 mask = arr_BuffArrCap(hm->structure) - 1;
+  HmEntries *entries = arr_VectorRaw(hm->entries);
+  u64 end = MIN(hm->migrate_pos + count, old_cap);
+
+  for (u64 i = hm->migrate_pos; i < end; i++) {
+    u64 slot = old_structure[i];
+    if (slot == EMPTY_SLOT || slot == TOMBSTONE_SLOT) {
+      continue;
+    }
+
+    /*
+     * The key can't be in the new structure yet, so any free slot on the probe
+     * chain will do.
+     */
+    u64 perturb = entries[SLOT_TO_ENTRY_INDEX(slot)].hash, j = perturb & mask;
+    while (structure[j] != EMPTY_SLOT && structure[j] != TOMBSTONE_SLOT) {
+      PROBER(j, perturb, mask);
+    }
+    if (structure[j] == TOMBSTONE_SLOT) {
+      hm->tombstones--;
+    }
+    structure[j] = slot;
+    old_structure[i] = TOMBSTONE_SLOT;
+  }
+  hm->migrate_pos = end;
+
+  if (hm->migrate_pos == old_cap) {
+    arr_BuffArrDelete(hm->old_structure);
+    hm->old_structure = NULL;
+    hm->migrate_pos = 0;
+  }
+}
+
 StatusCode hm_AddEntry(Hm *hm, void *key, void *val, HmAddModes mode) {
   NULL_FUNC_ARG_ROUTINE(hm, NULL_EXCEPTION);
   NULL_FUNC_ARG_ROUTINE(key, NULL_EXCEPTION);
 
+  return hm_AddEntryWHash(hm, key, hm->hash_func(key), val, mode);
+}
+
+StatusCode hm_AddEntryWHash(Hm *hm, void *key, u64 hash, void *val,
+                            HmAddModes mode) {
+  NULL_FUNC_ARG_ROUTINE(hm, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(key, NULL_EXCEPTION);
+
+  MigrateHmBuckets(hm, MIGRATE_BUCKETS_PER_OP);
+
   u64 hm_len = hm_GetLen(hm);
   u64 structure_cap = arr_BuffArrCap(hm->structure);
 
-  if (hm_len == structure_cap) {
+  // Without any empty slot left, the probing would never terminate.
+  if (hm_len + hm->tombstones >= structure_cap) {
     STATUS_LOG(FAILURE, "Hashmap is filled completely, previous grow attempts "
                         "must have failed.");
     return FAILURE;
-  } else if (hm_len >= structure_cap * LOAD_FACTOR) {
-    // Not failing here as about 30% of slots still empty.
-    GrowHmStructure(hm);
+  } else if (hm_len + hm->tombstones >= structure_cap * LOAD_FACTOR) {
+    /*
+     * If the tombstones are what pushed us over the load factor, rehashing in
+     * place is enough to shorten the probe chains again.
+     *
+     * Not failing here as about 30% of slots still empty.
+     */
+    u64 new_cap = (hm_len >= structure_cap * LOAD_FACTOR / 2)
+                      ? structure_cap * 2
+                      : structure_cap;
+    ResizeHmStructure(hm, new_cap, hm->resize_mode == HM_RESIZE_INCREMENTAL);
     structure_cap = arr_BuffArrCap(hm->structure);
   }
 
   u64 mask = arr_BuffArrCap(hm->structure) - 1;
-  u64 hash = hm->hash_func(key);
   u64 perturb = hash;
-  u64 i = perturb & mask, j = EMPTY_INDEX;
+  u64 i = perturb & mask, j = INVALID_INDEX;
   HmEntries *entries = arr_VectorRaw(hm->entries);
   u64 *structure = arr_BuffArrRaw(hm->structure);
-  u64 entry_index;
+  u64 entry_index = INVALID_INDEX;
 
-  while (structure[i] != EMPTY_INDEX) {
-    if (structure[i] == TOMBSTONE_INDEX) {
+  while (structure[i] != EMPTY_SLOT) {
+    if (structure[i] == TOMBSTONE_SLOT) {
       /*
        * We store the tombstone index and then continue our search to check if
        * the entry exists or not.
@@ -204,24 +398,33 @@ StatusCode hm_AddEntry(Hm *hm, void *key, void *val, HmAddModes mode) {
        */
       j = i;
     } else {
-      entry_index = structure[i]; // Can never be invalid index.
-      // Key already exists in the hm.
-      if (hm->cmp_func(key, entries[entry_index].key)) {
-        if (mode == HM_ADD_FAIL) {
-          STATUS_LOG(FAILURE, "Duplicate key found in failover mode.");
-          return FAILURE;
-        } else if (mode == HM_ADD_OVERWRITE) {
-          entries[entry_index].val = val;
-        }
-        return SUCCESS;
+      entry_index = SLOT_TO_ENTRY_INDEX(structure[i]);
+      if (entries[entry_index].hash == hash &&
+          hm->cmp_func(key, entries[entry_index].key)) {
+        break;
       }
+      entry_index = INVALID_INDEX;
     }
     PROBER(i, perturb, mask);
   }
-  if (j != EMPTY_INDEX) {
-    i = j;
+  if (entry_index == INVALID_INDEX && hm->old_structure) {
+    // Not migrated yet keys still live in the old structure.
+    u64 *old_structure = arr_BuffArrRaw(hm->old_structure);
+    u64 old_i = ProbeHmStructure(hm, hm->old_structure, key, hash);
+    if (old_i != INVALID_INDEX) {
+      entry_index = SLOT_TO_ENTRY_INDEX(old_structure[old_i]);
+    }
+  }
+  // Key already exists in the hm.
+  if (entry_index != INVALID_INDEX) {
+    if (mode == HM_ADD_FAIL) {
+      STATUS_LOG(FAILURE, "Duplicate key found in failover mode.");
+      return FAILURE;
+    } else if (mode == HM_ADD_OVERWRITE) {
+      entries[entry_index].val = val;
+    }
+    return SUCCESS;
   }
-
   HmEntries new_entry = {.hash = hash, .val = val, .key = key};
   IF_FUNC_FAILED(
       arr_VectorPush(hm->entries, &new_entry, GrowHmEntriesCallback)) {
@@ -229,94 +432,228 @@ StatusCode hm_AddEntry(Hm *hm, void *key, void *val, HmAddModes mode) {
     return FAILURE;
   }
 
-  arr_BuffArrSet(hm->structure, i, &hm_len);
+  // Only reusing the tombstone once the entry is in.
+  if (j != INVALID_INDEX) {
+    i = j;
+    hm->tombstones--;
+  }
+
+  structure[i] = ENTRY_INDEX_TO_SLOT(hm_len);
 
   return SUCCESS;
 }
 
-void *hm_GetEntry(const Hm *hm, void *key) {
-  NULL_FUNC_ARG_ROUTINE(hm, NULL);
-  NULL_FUNC_ARG_ROUTINE(key, NULL);
-
-  u64 mask = arr_BuffArrCap(hm->structure) - 1;
-  u64 hash = hm->hash_func(key);
+static u64 ProbeHmStructure(const Hm *hm, const BuffArr *structure_arr,
+                            const void *key, u64 hash) {
+  u64 mask = arr_BuffArrCap(structure_arr) - 1;
   u64 perturb = hash;
   u64 i = perturb & mask;
   HmEntries *entries = arr_VectorRaw(hm->entries);
-  u64 *structure = arr_BuffArrRaw(hm->structure);
+  u64 *structure = arr_BuffArrRaw(structure_arr);
   u64 entry_index;
 
-  while (structure[i] != EMPTY_INDEX) {
-    if (structure[i] != TOMBSTONE_INDEX) {
-      entry_index = structure[i]; // Can never be invalid index.
-      if (hm->cmp_func(key, entries[entry_index].key)) {
-        return entries[entry_index].val;
+  while (structure[i] != EMPTY_SLOT) {
+    if (structure[i] != TOMBSTONE_SLOT) {
+      entry_index = SLOT_TO_ENTRY_INDEX(structure[i]);
+      if (entries[entry_index].hash == hash &&
+          hm->cmp_func(key, entries[entry_index].key)) {
+        return i;
       }
     }
     PROBER(i, perturb, mask);
   }
 
-  return NULL;
+  return INVALID_INDEX;
 }
 
-static StatusCode FetchHmStructureEntryIndices(Hm *hm, void *key,
-                                               u64 *pStructure_i,
-                                               u64 *pEntry_i) {
-  *pStructure_i = *pEntry_i = EMPTY_INDEX;
+void *hm_GetEntry(const Hm *hm, void *key) {
+  NULL_FUNC_ARG_ROUTINE(hm, NULL);
+  NULL_FUNC_ARG_ROUTINE(key, NULL);
 
-  u64 mask = arr_BuffArrCap(hm->structure) - 1;
-  u64 hash = hm->hash_func(key);
-  u64 perturb = hash;
-  u64 i = perturb & mask;
-  u64 entry_index;
+  return hm_GetEntryWHash(hm, key, hm->hash_func(key));
+}
+
+void *hm_GetEntryWHash(const Hm *hm, void *key, u64 hash) {
+  NULL_FUNC_ARG_ROUTINE(hm, NULL);
+  NULL_FUNC_ARG_ROUTINE(key, NULL);
 
   HmEntries *entries = arr_VectorRaw(hm->entries);
-  u64 *structure = arr_BuffArrRaw(hm->structure);
+  const BuffArr *structure_arr = hm->structure;
 
-  while (structure[i] != EMPTY_INDEX) {
-    if (structure[i] != TOMBSTONE_INDEX) {
-      entry_index = structure[i]; // Can never be invalid index.
-      if (hm->cmp_func(key, entries[entry_index].key)) {
-        *pStructure_i = i;
-        *pEntry_i = entry_index;
-        return SUCCESS;
-      }
-    }
-    PROBER(i, perturb, mask);
+  u64 i = ProbeHmStructure(hm, structure_arr, key, hash);
+  if (i == INVALID_INDEX && hm->old_structure) {
+    structure_arr = hm->old_structure;
+    i = ProbeHmStructure(hm, structure_arr, key, hash);
   }
+  if (i == INVALID_INDEX) {
+    return NULL;
+  }
+
+  u64 *structure = arr_BuffArrRaw(structure_arr);
 
-  return OUT_OF_BOUNDS_ACCESS;
+  return entries[SLOT_TO_ENTRY_INDEX(structure[i])].val;
+}
+
+static StatusCode FetchHmStructureEntryIndices(Hm *hm, const void *key,
+                                               u64 hash, u64 **pStructure,
+                                               u64 *pStructure_i,
+                                               u64 *pEntry_i) {
+  *pStructure_i = *pEntry_i = INVALID_INDEX;
+
+  BuffArr *structure_arr = hm->structure;
+  u64 i = ProbeHmStructure(hm, structure_arr, key, hash);
+  if (i == INVALID_INDEX && hm->old_structure) {
+    structure_arr = hm->old_structure;
+    i = ProbeHmStructure(hm, structure_arr, key, hash);
+  }
+  if (i == INVALID_INDEX) {
+    return OUT_OF_BOUNDS_ACCESS;
+  }
+
+  *pStructure = arr_BuffArrRaw(structure_arr);
+  *pStructure_i = i;
+  *pEntry_i = SLOT_TO_ENTRY_INDEX((*pStructure)[i]);
+
+  return SUCCESS;
 }
 
 StatusCode hm_DeleteEntry(Hm *hm, void *key) {
   NULL_FUNC_ARG_ROUTINE(hm, NULL_EXCEPTION);
   NULL_FUNC_ARG_ROUTINE(key, NULL_EXCEPTION);
 
+  return hm_DeleteEntryWHash(hm, key, hm->hash_func(key));
+}
+
+StatusCode hm_DeleteEntryWHash(Hm *hm, void *key, u64 hash) {
+  NULL_FUNC_ARG_ROUTINE(hm, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(key, NULL_EXCEPTION);
+
+  MigrateHmBuckets(hm, MIGRATE_BUCKETS_PER_OP);
+
   u64 hm_len = hm_GetLen(hm);
   HmEntries *entries = arr_VectorRaw(hm->entries);
-  u64 *structure = arr_BuffArrRaw(hm->structure);
 
+  u64 *key_structure, *last_entry_structure;
   u64 key_structure_i, key_entry_i;
   u64 last_entry_structure_i, last_entry_i;
 
-  FetchHmStructureEntryIndices(hm, key, &key_structure_i, &key_entry_i);
-  if (key_structure_i == EMPTY_INDEX) {
+  IF_FUNC_FAILED(FetchHmStructureEntryIndices(hm, key, hash, &key_structure,
+                                              &key_structure_i, &key_entry_i)) {
     STATUS_LOG(OUT_OF_BOUNDS_ACCESS,
                "Cannot delete a key that doesn't exist in the hm.");
     return OUT_OF_BOUNDS_ACCESS;
   }
-  FetchHmStructureEntryIndices(hm, entries[hm_len - 1].key,
-                               &last_entry_structure_i, &last_entry_i);
+  IF_FUNC_FAILED(FetchHmStructureEntryIndices(
+      hm, entries[hm_len - 1].key, entries[hm_len - 1].hash,
+      &last_entry_structure, &last_entry_structure_i, &last_entry_i)) {
+    STATUS_LOG(FAILURE, "Last entry of the hm is missing from its structure.");
+    return FAILURE;
+  }
 
   // Repacking the array as order of this array doesn't matter.
-  hm->key_delete_callback(entries[key_entry_i].key);
-  hm->val_delete_callback(entries[key_entry_i].val);
+  if (hm->key_delete_callback) {
+    hm->key_delete_callback(entries[key_entry_i].key);
+  }
+  if (hm->val_delete_callback) {
+    hm->val_delete_callback(entries[key_entry_i].val);
+  }
   entries[key_entry_i] = entries[last_entry_i];
   arr_VectorPop(hm->entries, NULL);
 
   // Updating the structure index, as the index of the last key was moved.
-  structure[last_entry_structure_i] = key_entry_i;
-  structure[key_structure_i] = TOMBSTONE_INDEX;
+  last_entry_structure[last_entry_structure_i] =
+      ENTRY_INDEX_TO_SLOT(key_entry_i);
+  key_structure[key_structure_i] = TOMBSTONE_SLOT;
+  if (key_structure == arr_BuffArrRaw(hm->structure)) {
+    // Tombstones of the old structure are dropped along with it.
+    hm->tombstones++;
+  }
+
+  if (hm_len - 1 < arr_BuffArrCap(hm->structure) * SHRINK_FACTOR) {
+    // Not failing here, as the hashmap is still in a valid state.
+    ShrinkHmStructure(hm);
+  }
+
+  return SUCCESS;
+}
+
+StatusCode hm_Reserve(Hm *hm, u64 n) {
+  NULL_FUNC_ARG_ROUTINE(hm, NULL_EXCEPTION);
+
+  u64 structure_cap = arr_BuffArrCap(hm->structure);
+  u64 new_cap = structure_cap;
+  while (n >= new_cap * LOAD_FACTOR) {
+    new_cap *= 2;
+  }
+
+  if (new_cap > structure_cap) {
+    // Reserving is an up front cost anyway, no point in migrating lazily.
+    IF_FUNC_FAILED(ResizeHmStructure(hm, new_cap, false)) {
+      STATUS_LOG(FAILURE, "Cannot reserve space in the hashmap structure.");
+      return FAILURE;
+    }
+  }
+
+  IF_FUNC_FAILED(arr_VectorReserve(hm->entries, n)) {
+    STATUS_LOG(FAILURE, "Cannot reserve space for the hashmap entries.");
+    return FAILURE;
+  }
+
+  return SUCCESS;
+}
+
+StatusCode hm_AddEntries(Hm *hm, void **keys, void **vals, u64 count,
+                         HmAddModes mode) {
+  NULL_FUNC_ARG_ROUTINE(hm, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(keys, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(vals, NULL_EXCEPTION);
+
+  IF_FUNC_FAILED(hm_Reserve(hm, hm_GetLen(hm) + count)) {
+    STATUS_LOG(FAILURE, "Cannot reserve space for %zu entries.", count);
+    return FAILURE;
+  }
+
+  for (u64 i = 0; i < count; i++) {
+    StatusCode code = hm_AddEntry(hm, keys[i], vals[i], mode);
+    IF_FUNC_FAILED(code) {
+      STATUS_LOG(FAILURE, "Bulk add stopped at entry: %zu.", i);
+      return code;
+    }
+  }
+
+  return SUCCESS;
+}
+
+StatusCode hm_GetEntries(const Hm *hm, void **keys, u64 count, void **dest) {
+  NULL_FUNC_ARG_ROUTINE(hm, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(keys, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(dest, NULL_EXCEPTION);
+
+  u64 hashes[GET_ENTRIES_BATCH_SIZE];
+  u64 mask = arr_BuffArrCap(hm->structure) - 1;
+  HmEntries *entries = arr_VectorRaw(hm->entries);
+  u64 *structure = arr_BuffArrRaw(hm->structure);
+
+  for (u64 batch = 0; batch < count; batch += GET_ENTRIES_BATCH_SIZE) {
+    u64 batch_len = MIN(GET_ENTRIES_BATCH_SIZE, count - batch);
+
+    // Stage 1: hash everything, and start loading the first probed buckets.
+    for (u64 i = 0; i < batch_len; i++) {
+      hashes[i] = hm->hash_func(keys[batch + i]);
+      PREFETCH(&structure[hashes[i] & mask]);
+    }
+    // Stage 2: buckets have (mostly) arrived, start loading their entries.
+    for (u64 i = 0; i < batch_len; i++) {
+      u64 slot = structure[hashes[i] & mask];
+      if (slot != EMPTY_SLOT && slot != TOMBSTONE_SLOT) {
+        PREFETCH(&entries[SLOT_TO_ENTRY_INDEX(slot)]);
+      }
+    }
+    // Stage 3: the normal lookup, which mostly hits the cache now.
+    for (u64 i = 0; i < batch_len; i++) {
+      dest[batch + i] = hm_GetEntryWHash(hm, keys[batch + i], hashes[i]);
+    }
+  }
 
   return SUCCESS;
 }
@@ -5,20 +5,61 @@ extern "C" {
 #endif
 
 #include "../utils/common.h"
+#include "../utils/mem.h"
 #include "../utils/status.h"
 
 typedef struct __Hm Hm;
 
 typedef enum { HM_ADD_OVERWRITE, HM_ADD_FAIL, HM_ADD_PRESERVE } HmAddModes;
+/*
+ * HM_RESIZE_IMMEDIATE rehashes every entry inside the operation that triggered
+ * the resize. HM_RESIZE_INCREMENTAL keeps the old structure around and moves a
+ * bounded number of its buckets per add/delete, trading a slightly slower
+ * lookup during the migration for no single op latency spikes. Shrinking
+ * rehashes immediately in both modes, it only touches the few live entries.
+ */
+typedef enum { HM_RESIZE_IMMEDIATE, HM_RESIZE_INCREMENTAL } HmResizeModes;
 
 Hm *hm_Create(u64 (*hash_func)(const void *key),
               bool (*cmp_func)(const void *key, const void *compare_key),
               StatusCode (*key_delete_callback)(void *key),
               StatusCode (*val_delete_callback)(void *val));
+// The allocator is copied, a NULL allocator means the heap.
+Hm *hm_CreateWAllocator(
+    u64 (*hash_func)(const void *key),
+    bool (*cmp_func)(const void *key, const void *compare_key),
+    StatusCode (*key_delete_callback)(void *key),
+    StatusCode (*val_delete_callback)(void *val), const Allocator *allocator);
 StatusCode hm_Delete(Hm *hm);
+StatusCode hm_SetResizeMode(Hm *hm, HmResizeModes mode);
 StatusCode hm_AddEntry(Hm *hm, void *key, void *val, HmAddModes mode);
 void *hm_GetEntry(const Hm *hm, void *key);
 StatusCode hm_DeleteEntry(Hm *hm, void *key);
+/*
+ * Same as above, but with the hash of the key already computed by the caller.
+ * The hash must be what the hm's hash_func would return for the key.
+ */
+StatusCode hm_AddEntryWHash(Hm *hm, void *key, u64 hash, void *val,
+                            HmAddModes mode);
+void *hm_GetEntryWHash(const Hm *hm, void *key, u64 hash);
+StatusCode hm_DeleteEntryWHash(Hm *hm, void *key, u64 hash);
+/*
+ * Presizes the hashmap so that n entries in total fit without any further
+ * grows or rehashes.
+ */
+StatusCode hm_Reserve(Hm *hm, u64 n);
+/*
+ * Adds count key/val pairs, reserving for all of them up front. Stops at the
+ * first failing add, keeping the pairs added before it.
+ */
+StatusCode hm_AddEntries(Hm *hm, void **keys, void **vals, u64 count,
+                         HmAddModes mode);
+/*
+ * Batched hm_GetEntry, dest[i] is set to the val of keys[i] or NULL. Hashes a
+ * group of keys and prefetches their buckets before resolving them, so the
+ * cache misses of the group overlap instead of being paid one by one.
+ */
+StatusCode hm_GetEntries(const Hm *hm, void **keys, u64 count, void **dest);
 u64 hm_GetLen(const Hm *hm);
 StatusCode hm_ForEach(Hm *hm, void (*foreach_callback)(void *key, void *val));
 
@@ -0,0 +1,310 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../utils/common.h"
+#include "../utils/mem.h"
+#include "../utils/status.h"
+#include "hm.h"
+
+/*
+ * Type specialized version of Hm. It uses the same python dict like layout
+ * (a structure of indices into a dense array of entries) and the same probing
+ * algorithm, but the keys and values are stored inline in the entries and the
+ * hash/cmp functions are known at compile time, so the whole lookup can be
+ * inlined into straight line code.
+ *
+ * Usage:
+ *   HM_DEFINE(U64Map, u64, Entity *)
+ *   U64Map map;
+ *   U64Map_Init(&map, NULL);
+ *   U64Map_AddEntry(&map, 42, entity, HM_ADD_FAIL);
+ *   Entity **pEntity = U64Map_GetEntry(&map, 42);
+ *   U64Map_Deinit(&map);
+ *
+ * HM_DEFINE hashes and compares the raw bytes of the key, so it is meant for
+ * integer and fixed size keys. Struct keys with padding must have the padding
+ * zeroed, or use HM_DEFINE_CUSTOM with their own hash and cmp.
+ *
+ * The map never owns anything pointed to by the keys/values, so there are no
+ * delete callbacks.
+ */
+
+// Please make sure this is a power of 2, same as MIN_HASH_BUCKET_SIZE.
+#define HM_TYPED_MIN_BUCKET_SIZE (16)
+#define HM_TYPED_PERTURB_CONST (5)
+#define HM_TYPED_PERTURB_SHIFT (5)
+// 2/3, kept as a fraction so the check stays integer only.
+#define HM_TYPED_LOAD_NUM (2)
+#define HM_TYPED_LOAD_DEN (3)
+
+#define HM_TYPED_EMPTY_INDEX (UINT64_MAX)
+#define HM_TYPED_TOMBSTONE_INDEX (UINT64_MAX - 1)
+
+#define HM_TYPED_ALLOCATOR(allocator)                                          \
+  ((allocator) ? *(allocator)                                                  \
+               : mem_HeapAllocatorWCategory(MEM_CATEGORY_HASHMAP))
+
+#define HM_TYPED_PROBER(i, perturb, mask)                                      \
+  i = (HM_TYPED_PERTURB_CONST * i + 1 + perturb) & mask;                       \
+  perturb >>= HM_TYPED_PERTURB_SHIFT;
+
+// 64-bit finalizer (from SplitMix64)
+static inline u64 hm_TypedMixU64(u64 x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+  return x ^ (x >> 31);
+}
+
+/*
+ * With size being a compile time constant the branches and the memcpys fold
+ * away, leaving just the mixing for integer keys.
+ */
+static inline u64 hm_TypedBytesHash(const void *key, u64 size) {
+  u64 hash = 0, word = 0;
+  const u8 *bytes = key;
+
+  if (size <= sizeof(u64)) {
+    memcpy(&word, bytes, size);
+    return hm_TypedMixU64(word ^ size);
+  }
+
+  for (u64 i = 0; i + sizeof(u64) <= size; i += sizeof(u64)) {
+    memcpy(&word, bytes + i, sizeof(u64));
+    hash = hm_TypedMixU64(hash ^ word);
+  }
+  if (size % sizeof(u64)) {
+    word = 0;
+    memcpy(&word, bytes + size - size % sizeof(u64), size % sizeof(u64));
+    hash = hm_TypedMixU64(hash ^ word);
+  }
+
+  return hm_TypedMixU64(hash ^ size);
+}
+
+#define HM_TYPED_BYTES_HASH(pKey) hm_TypedBytesHash((pKey), sizeof(*(pKey)))
+#define HM_TYPED_BYTES_CMP(pKey, pCompare_key)                                 \
+  (memcmp((pKey), (pCompare_key), sizeof(*(pKey))) == 0)
+
+#define HM_DEFINE(Name, KeyType, ValType)                                      \
+  HM_DEFINE_CUSTOM(Name, KeyType, ValType, HM_TYPED_BYTES_HASH,                \
+                   HM_TYPED_BYTES_CMP)
+
+/*
+ * hash_func(const KeyType *key) -> u64
+ * cmp_func(const KeyType *key, const KeyType *compare_key) -> bool
+ *
+ * Both can be either functions or macros.
+ */
+#define HM_DEFINE_CUSTOM(Name, KeyType, ValType, hash_func, cmp_func)          \
+  typedef struct {                                                             \
+    KeyType key;                                                               \
+    ValType val;                                                               \
+    u64 hash;                                                                  \
+  } Name##Entry;                                                               \
+                                                                               \
+  typedef struct {                                                             \
+    u64 *structure;                                                            \
+    u64 structure_cap;                                                         \
+    u64 tombstones;                                                            \
+    Name##Entry *entries;                                                      \
+    u64 len;                                                                   \
+    u64 entries_cap;                                                           \
+    Allocator allocator;                                                       \
+  } Name;                                                                      \
+                                                                               \
+  /* The allocator is copied, a NULL allocator means the heap. */              \
+  static inline StatusCode Name##_Init(Name *hm, const Allocator *allocator) { \
+    NULL_FUNC_ARG_ROUTINE(hm, NULL_EXCEPTION);                                 \
+                                                                               \
+    hm->allocator = HM_TYPED_ALLOCATOR(allocator);                             \
+    hm->structure =                                                            \
+        mem_Alloc(&hm->allocator, sizeof(u64) * HM_TYPED_MIN_BUCKET_SIZE);     \
+    MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(hm->structure, CREATION_FAILURE);     \
+    hm->entries = mem_Alloc(&hm->allocator,                                    \
+                            sizeof(Name##Entry) * HM_TYPED_MIN_BUCKET_SIZE);   \
+    IF_NULL(hm->entries) {                                                     \
+      mem_Free(&hm->allocator, hm->structure,                                  \
+               sizeof(u64) * HM_TYPED_MIN_BUCKET_SIZE);                        \
+      MEM_ALLOC_FAILURE_SUB_ROUTINE(hm->entries, CREATION_FAILURE);            \
+    }                                                                          \
+    /* This will set each index to EMPTY, as memset works per byte. */         \
+    memset(hm->structure, 0xFF, sizeof(u64) * HM_TYPED_MIN_BUCKET_SIZE);       \
+    hm->structure_cap = hm->entries_cap = HM_TYPED_MIN_BUCKET_SIZE;            \
+    hm->tombstones = hm->len = 0;                                              \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  static inline StatusCode Name##_Deinit(Name *hm) {                           \
+    NULL_FUNC_ARG_ROUTINE(hm, NULL_EXCEPTION);                                 \
+                                                                               \
+    /* Allows deiniting a zeroed, never initialized map. */                    \
+    if (hm->structure) {                                                       \
+      mem_Free(&hm->allocator, hm->structure,                                  \
+               sizeof(u64) * hm->structure_cap);                               \
+      mem_Free(&hm->allocator, hm->entries,                                    \
+               sizeof(Name##Entry) * hm->entries_cap);                         \
+    }                                                                          \
+    memset(hm, 0, sizeof(Name));                                               \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  static inline u64 Name##_GetLen(const Name *hm) { return hm->len; }          \
+                                                                               \
+  /* Rebuilds the structure with new_cap, dropping all the tombstones. */      \
+  static inline StatusCode Name##_Rehash(Name *hm, u64 new_cap) {              \
+    u64 *structure = mem_Alloc(&hm->allocator, sizeof(u64) * new_cap);         \
+    MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(structure, CREATION_FAILURE);         \
+    memset(structure, 0xFF, sizeof(u64) * new_cap);                            \
+                                                                               \
+    u64 mask = new_cap - 1;                                                    \
+    for (u64 i = 0; i < hm->len; i++) {                                        \
+      u64 perturb = hm->entries[i].hash, j = perturb & mask;                   \
+      while (structure[j] != HM_TYPED_EMPTY_INDEX) {                           \
+        HM_TYPED_PROBER(j, perturb, mask);                                     \
+      }                                                                        \
+      structure[j] = i;                                                        \
+    }                                                                          \
+                                                                               \
+    mem_Free(&hm->allocator, hm->structure, sizeof(u64) * hm->structure_cap);  \
+    hm->structure = structure;                                                 \
+    hm->structure_cap = new_cap;                                               \
+    hm->tombstones = 0;                                                        \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  /*                                                                           \
+   * Returns the structure index of the key, or HM_TYPED_EMPTY_INDEX if it     \
+   * doesn't exist.                                                            \
+   */                                                                          \
+  static inline u64 Name##_FindSlot(const Name *hm, const KeyType *pKey,       \
+                                    u64 hash) {                                \
+    u64 mask = hm->structure_cap - 1;                                          \
+    u64 perturb = hash, i = perturb & mask;                                    \
+                                                                               \
+    while (hm->structure[i] != HM_TYPED_EMPTY_INDEX) {                         \
+      u64 entry_index = hm->structure[i];                                      \
+      if (entry_index != HM_TYPED_TOMBSTONE_INDEX &&                           \
+          hm->entries[entry_index].hash == hash &&                             \
+          cmp_func(pKey, &hm->entries[entry_index].key)) {                     \
+        return i;                                                              \
+      }                                                                        \
+      HM_TYPED_PROBER(i, perturb, mask);                                       \
+    }                                                                          \
+                                                                               \
+    return HM_TYPED_EMPTY_INDEX;                                               \
+  }                                                                            \
+                                                                               \
+  static inline StatusCode Name##_AddEntry(Name *hm, KeyType key,              \
+                                           ValType val, HmAddModes mode) {     \
+    NULL_FUNC_ARG_ROUTINE(hm, NULL_EXCEPTION);                                 \
+                                                                               \
+    if ((hm->len + hm->tombstones + 1) * HM_TYPED_LOAD_DEN >=                  \
+        hm->structure_cap * HM_TYPED_LOAD_NUM) {                               \
+      /*                                                                       \
+       * If tombstones are the reason for crossing the load factor a rehash    \
+       * of the same size is enough to get the probe chains short again.       \
+       */                                                                      \
+      u64 new_cap = ((hm->len + 1) * HM_TYPED_LOAD_DEN * 2 >=                  \
+                     hm->structure_cap * HM_TYPED_LOAD_NUM)                    \
+                        ? hm->structure_cap * 2                                \
+                        : hm->structure_cap;                                   \
+      IF_FUNC_FAILED(Name##_Rehash(hm, new_cap)) {                             \
+        STATUS_LOG(FAILURE, "Cannot grow hashmap.");                           \
+        return FAILURE;                                                        \
+      }                                                                        \
+    }                                                                          \
+                                                                               \
+    u64 mask = hm->structure_cap - 1;                                          \
+    u64 hash = hash_func(&key);                                                \
+    u64 perturb = hash;                                                        \
+    u64 i = perturb & mask, j = HM_TYPED_EMPTY_INDEX;                          \
+                                                                               \
+    while (hm->structure[i] != HM_TYPED_EMPTY_INDEX) {                         \
+      u64 entry_index = hm->structure[i];                                      \
+      if (entry_index == HM_TYPED_TOMBSTONE_INDEX) {                           \
+        /* Reuse the first tombstone, but keep searching for the key. */       \
+        if (j == HM_TYPED_EMPTY_INDEX) {                                       \
+          j = i;                                                               \
+        }                                                                      \
+      } else if (hm->entries[entry_index].hash == hash &&                      \
+                 cmp_func(&key, &hm->entries[entry_index].key)) {              \
+        if (mode == HM_ADD_FAIL) {                                             \
+          STATUS_LOG(FAILURE, "Duplicate key found in failover mode.");        \
+          return FAILURE;                                                      \
+        } else if (mode == HM_ADD_OVERWRITE) {                                 \
+          hm->entries[entry_index].val = val;                                  \
+        }                                                                      \
+        return SUCCESS;                                                        \
+      }                                                                        \
+      HM_TYPED_PROBER(i, perturb, mask);                                       \
+    }                                                                          \
+    if (j != HM_TYPED_EMPTY_INDEX) {                                           \
+      i = j;                                                                   \
+    }                                                                          \
+                                                                               \
+    if (hm->len == hm->entries_cap) {                                          \
+      u64 new_cap = hm->entries_cap * 2;                                       \
+      Name##Entry *new_entries = mem_Realloc(                                  \
+          &hm->allocator, hm->entries, sizeof(Name##Entry) * hm->entries_cap,  \
+          sizeof(Name##Entry) * new_cap);                                      \
+      MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(new_entries, CREATION_FAILURE);     \
+      hm->entries = new_entries;                                               \
+      hm->entries_cap = new_cap;                                               \
+    }                                                                          \
+                                                                               \
+    /* Only counted out once the entry is surely in. */                        \
+    if (hm->structure[i] == HM_TYPED_TOMBSTONE_INDEX) {                        \
+      hm->tombstones--;                                                        \
+    }                                                                          \
+    hm->entries[hm->len] =                                                     \
+        (Name##Entry){.key = key, .val = val, .hash = hash};                   \
+    hm->structure[i] = hm->len++;                                              \
+                                                                               \
+    return SUCCESS;                                                            \
+  }                                                                            \
+                                                                               \
+  static inline ValType *Name##_GetEntry(const Name *hm, KeyType key) {        \
+    u64 i = Name##_FindSlot(hm, &key, hash_func(&key));                        \
+                                                                               \
+    return (i == HM_TYPED_EMPTY_INDEX)                                         \
+               ? NULL                                                          \
+               : &hm->entries[hm->structure[i]].val;                           \
+  }                                                                            \
+                                                                               \
+  static inline StatusCode Name##_DeleteEntry(Name *hm, KeyType key) {         \
+    NULL_FUNC_ARG_ROUTINE(hm, NULL_EXCEPTION);                                 \
+                                                                               \
+    u64 key_structure_i = Name##_FindSlot(hm, &key, hash_func(&key));          \
+    if (key_structure_i == HM_TYPED_EMPTY_INDEX) {                             \
+      STATUS_LOG(OUT_OF_BOUNDS_ACCESS,                                         \
+                 "Cannot delete a key that doesn't exist in the hm.");         \
+      return OUT_OF_BOUNDS_ACCESS;                                             \
+    }                                                                          \
+    u64 key_entry_i = hm->structure[key_structure_i];                          \
+    u64 last_entry_i = hm->len - 1;                                            \
+                                                                               \
+    if (key_entry_i != last_entry_i) {                                         \
+      /* Repacking the array as order of this array doesn't matter. */         \
+      Name##Entry *last = &hm->entries[last_entry_i];                          \
+      u64 last_structure_i = Name##_FindSlot(hm, &last->key, last->hash);      \
+      hm->entries[key_entry_i] = *last;                                        \
+      hm->structure[last_structure_i] = key_entry_i;                           \
+    }                                                                          \
+    hm->structure[key_structure_i] = HM_TYPED_TOMBSTONE_INDEX;                 \
+    hm->tombstones++;                                                          \
+    hm->len--;                                                                 \
+                                                                               \
+    return SUCCESS;                                                            \
+  }
+
+#ifdef __cplusplus
+}
+#endif
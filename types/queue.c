@@ -0,0 +1,389 @@
+#include "queue.h"
+#include <stdatomic.h>
+
+/*
+ * The indices only ever increase and are masked into the buffer, a u64 won't
+ * wrap in the lifetime of the program. So len is always tail - head.
+ */
+
+static u64 RoundUpToPowerOfTwo(u64 n);
+
+/* ----  SPSC QUEUE  ---- */
+
+struct __SpscQueue {
+  // Written by the producer.
+  _Alignas(CACHE_LINE_SIZE) _Atomic u64 tail;
+  u64 cached_head;
+  // Written by the consumer.
+  _Alignas(CACHE_LINE_SIZE) _Atomic u64 head;
+  u64 cached_tail;
+  // Read only after creation.
+  _Alignas(CACHE_LINE_SIZE) u64 mask;
+  u64 elem_size;
+  u8 *mem;
+};
+
+static void SpscCopyIn(SpscQueue *queue, u64 pos, const void *data, u64 count);
+static void SpscCopyOut(SpscQueue *queue, u64 pos, void *dest, u64 count);
+
+/* ----  MPMC QUEUE  ---- */
+
+/*
+ * Each cell is a sequence number followed by the element, the cell size is
+ * rounded up so every sequence stays 8 byte aligned.
+ */
+#define CELL_SEQUENCE(queue, pos)                                              \
+  ((_Atomic u64 *)MEM_OFFSET((queue)->cells,                                   \
+                             ((pos) & (queue)->mask) * (queue)->cell_size))
+#define CELL_DATA(queue, pos)                                                  \
+  MEM_OFFSET((queue)->cells,                                                   \
+             ((pos) & (queue)->mask) * (queue)->cell_size + sizeof(u64))
+
+struct __MpmcQueue {
+  _Alignas(CACHE_LINE_SIZE) _Atomic u64 enqueue_pos;
+  _Alignas(CACHE_LINE_SIZE) _Atomic u64 dequeue_pos;
+  // Read only after creation.
+  _Alignas(CACHE_LINE_SIZE) u64 mask;
+  u64 elem_size;
+  u64 cell_size;
+  u8 *cells;
+};
+
+/* ----  UTILITY FUNCTIONS   ---- */
+
+static u64 RoundUpToPowerOfTwo(u64 n) {
+  u64 pow = 1;
+  while (pow < n) {
+    pow <<= 1;
+  }
+
+  return pow;
+}
+
+/* ----  SPSC QUEUE  ---- */
+
+SpscQueue *queue_SpscCreate(u64 elem_size, u64 cap) {
+  if (!elem_size || !cap) {
+    STATUS_LOG(FAILURE, "Cannot create a queue of no size.");
+    return NULL;
+  }
+
+  // sizeof is already a multiple of the alignment due to the _Alignas.
+  SpscQueue *queue = aligned_alloc(CACHE_LINE_SIZE, sizeof(SpscQueue));
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(queue, NULL);
+  memset(queue, 0, sizeof(SpscQueue));
+
+  cap = RoundUpToPowerOfTwo(cap);
+  queue->mask = cap - 1;
+  queue->elem_size = elem_size;
+  queue->mem = malloc(elem_size * cap);
+  IF_NULL(queue->mem) {
+    queue_SpscDelete(queue);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(queue->mem, NULL);
+  }
+  atomic_init(&queue->head, 0);
+  atomic_init(&queue->tail, 0);
+
+  return queue;
+}
+
+StatusCode queue_SpscDelete(SpscQueue *queue) {
+  NULL_FUNC_ARG_ROUTINE(queue, NULL_EXCEPTION);
+
+  // Caller guarantees neither side is using the queue anymore.
+  free(queue->mem);
+  free(queue);
+
+  return SUCCESS;
+}
+
+StatusCode queue_SpscPush(SpscQueue *queue, const void *data) {
+  NULL_FUNC_ARG_ROUTINE(queue, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(data, NULL_EXCEPTION);
+
+  return (queue_SpscPushBatch(queue, data, 1)) ? SUCCESS : FAILURE;
+}
+
+StatusCode queue_SpscPop(SpscQueue *queue, void *dest) {
+  NULL_FUNC_ARG_ROUTINE(queue, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(dest, NULL_EXCEPTION);
+
+  return (queue_SpscPopBatch(queue, dest, 1)) ? SUCCESS : FAILURE;
+}
+
+u64 queue_SpscPushBatch(SpscQueue *queue, const void *data, u64 count) {
+  NULL_FUNC_ARG_ROUTINE(queue, 0);
+  NULL_FUNC_ARG_ROUTINE(data, 0);
+
+  u64 cap = queue->mask + 1;
+  u64 tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  u64 free_count = cap - (tail - queue->cached_head);
+  // Only going to the consumer's cache line if the cached head isn't enough.
+  if (free_count < count) {
+    queue->cached_head =
+        atomic_load_explicit(&queue->head, memory_order_acquire);
+    free_count = cap - (tail - queue->cached_head);
+  }
+
+  count = MIN(count, free_count);
+  if (!count) {
+    return 0;
+  }
+  SpscCopyIn(queue, tail, data, count);
+  atomic_store_explicit(&queue->tail, tail + count, memory_order_release);
+
+  return count;
+}
+
+u64 queue_SpscPopBatch(SpscQueue *queue, void *dest, u64 count) {
+  NULL_FUNC_ARG_ROUTINE(queue, 0);
+  NULL_FUNC_ARG_ROUTINE(dest, 0);
+
+  u64 head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  u64 ready_count = queue->cached_tail - head;
+  // Only going to the producer's cache line if the cached tail isn't enough.
+  if (ready_count < count) {
+    queue->cached_tail =
+        atomic_load_explicit(&queue->tail, memory_order_acquire);
+    ready_count = queue->cached_tail - head;
+  }
+
+  count = MIN(count, ready_count);
+  if (!count) {
+    return 0;
+  }
+  SpscCopyOut(queue, head, dest, count);
+  atomic_store_explicit(&queue->head, head + count, memory_order_release);
+
+  return count;
+}
+
+u64 queue_SpscLen(const SpscQueue *queue) {
+  NULL_FUNC_ARG_ROUTINE(queue, INVALID_INDEX);
+
+  // Casting away const as C11 atomic_load doesn't take const pointers.
+  SpscQueue *q = (SpscQueue *)queue;
+  u64 head = atomic_load_explicit(&q->head, memory_order_acquire);
+  u64 tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+  // The head can be loaded before a pop and the tail after it.
+  return (tail > head) ? tail - head : 0;
+}
+
+u64 queue_SpscCap(const SpscQueue *queue) {
+  NULL_FUNC_ARG_ROUTINE(queue, INVALID_INDEX);
+
+  return queue->mask + 1;
+}
+
+// A batch can wrap around the end of the buffer, so up to two copies.
+static void SpscCopyIn(SpscQueue *queue, u64 pos, const void *data,
+                       u64 count) {
+  u64 start = pos & queue->mask;
+  u64 first_count = MIN(count, queue->mask + 1 - start);
+
+  memcpy(MEM_OFFSET(queue->mem, start * queue->elem_size), data,
+         first_count * queue->elem_size);
+  if (first_count < count) {
+    memcpy(queue->mem, MEM_OFFSET(data, first_count * queue->elem_size),
+           (count - first_count) * queue->elem_size);
+  }
+}
+
+static void SpscCopyOut(SpscQueue *queue, u64 pos, void *dest, u64 count) {
+  u64 start = pos & queue->mask;
+  u64 first_count = MIN(count, queue->mask + 1 - start);
+
+  memcpy(dest, MEM_OFFSET(queue->mem, start * queue->elem_size),
+         first_count * queue->elem_size);
+  if (first_count < count) {
+    memcpy(MEM_OFFSET(dest, first_count * queue->elem_size), queue->mem,
+           (count - first_count) * queue->elem_size);
+  }
+}
+
+/* ----  MPMC QUEUE  ---- */
+
+MpmcQueue *queue_MpmcCreate(u64 elem_size, u64 cap) {
+  if (!elem_size || !cap) {
+    STATUS_LOG(FAILURE, "Cannot create a queue of no size.");
+    return NULL;
+  }
+
+  // sizeof is already a multiple of the alignment due to the _Alignas.
+  MpmcQueue *queue = aligned_alloc(CACHE_LINE_SIZE, sizeof(MpmcQueue));
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(queue, NULL);
+  memset(queue, 0, sizeof(MpmcQueue));
+
+  cap = RoundUpToPowerOfTwo(cap);
+  queue->mask = cap - 1;
+  queue->elem_size = elem_size;
+  queue->cell_size = ALIGN_UP(sizeof(u64) + elem_size, sizeof(u64));
+  queue->cells = malloc(queue->cell_size * cap);
+  IF_NULL(queue->cells) {
+    queue_MpmcDelete(queue);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(queue->cells, NULL);
+  }
+
+  // Cell i is free to be written for the lap where enqueue_pos == i.
+  for (u64 i = 0; i < cap; i++) {
+    atomic_init(CELL_SEQUENCE(queue, i), i);
+  }
+  atomic_init(&queue->enqueue_pos, 0);
+  atomic_init(&queue->dequeue_pos, 0);
+
+  return queue;
+}
+
+StatusCode queue_MpmcDelete(MpmcQueue *queue) {
+  NULL_FUNC_ARG_ROUTINE(queue, NULL_EXCEPTION);
+
+  // Caller guarantees no other thread is using the queue anymore.
+  free(queue->cells);
+  free(queue);
+
+  return SUCCESS;
+}
+
+StatusCode queue_MpmcPush(MpmcQueue *queue, const void *data) {
+  NULL_FUNC_ARG_ROUTINE(queue, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(data, NULL_EXCEPTION);
+
+  return (queue_MpmcPushBatch(queue, data, 1)) ? SUCCESS : FAILURE;
+}
+
+StatusCode queue_MpmcPop(MpmcQueue *queue, void *dest) {
+  NULL_FUNC_ARG_ROUTINE(queue, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(dest, NULL_EXCEPTION);
+
+  return (queue_MpmcPopBatch(queue, dest, 1)) ? SUCCESS : FAILURE;
+}
+
+u64 queue_MpmcPushBatch(MpmcQueue *queue, const void *data, u64 count) {
+  NULL_FUNC_ARG_ROUTINE(queue, 0);
+  NULL_FUNC_ARG_ROUTINE(data, 0);
+
+  // Nothing to claim, the retry loop below would never end.
+  if (!count) {
+    return 0;
+  }
+
+  u64 pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+  u64 claim_count = 0;
+  for (;;) {
+    /*
+     * Counting how many cells from pos on are free for this lap. A cell can
+     * only be claimed along with every cell before it, so the run stops at the
+     * first cell a consumer hasn't released yet.
+     */
+    claim_count = 0;
+    while (claim_count < count) {
+      u64 seq = atomic_load_explicit(CELL_SEQUENCE(queue, pos + claim_count),
+                                     memory_order_acquire);
+      if (seq != pos + claim_count) {
+        break;
+      }
+      claim_count++;
+    }
+
+    if (!claim_count) {
+      u64 seq = atomic_load_explicit(CELL_SEQUENCE(queue, pos),
+                                     memory_order_acquire);
+      // Behind pos means the cell still holds last lap's element, so full.
+      if ((i64)(seq - pos) < 0) {
+        return 0;
+      }
+      // Another producer already took pos, retry from where it left off.
+      pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+      continue;
+    }
+
+    // On failure pos is reloaded with the current enqueue_pos.
+    if (atomic_compare_exchange_weak_explicit(
+            &queue->enqueue_pos, &pos, pos + claim_count, memory_order_relaxed,
+            memory_order_relaxed)) {
+      break;
+    }
+  }
+
+  for (u64 i = 0; i < claim_count; i++) {
+    memcpy(CELL_DATA(queue, pos + i),
+           MEM_OFFSET(data, i * queue->elem_size), queue->elem_size);
+    // Publishes the cell to the consumers of this lap.
+    atomic_store_explicit(CELL_SEQUENCE(queue, pos + i), pos + i + 1,
+                          memory_order_release);
+  }
+
+  return claim_count;
+}
+
+u64 queue_MpmcPopBatch(MpmcQueue *queue, void *dest, u64 count) {
+  NULL_FUNC_ARG_ROUTINE(queue, 0);
+  NULL_FUNC_ARG_ROUTINE(dest, 0);
+
+  if (!count) {
+    return 0;
+  }
+
+  u64 pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+  u64 claim_count = 0;
+  for (;;) {
+    // Same as push, but a cell is ready to be read when its seq is pos + 1.
+    claim_count = 0;
+    while (claim_count < count) {
+      u64 seq = atomic_load_explicit(CELL_SEQUENCE(queue, pos + claim_count),
+                                     memory_order_acquire);
+      if (seq != pos + claim_count + 1) {
+        break;
+      }
+      claim_count++;
+    }
+
+    if (!claim_count) {
+      u64 seq = atomic_load_explicit(CELL_SEQUENCE(queue, pos),
+                                     memory_order_acquire);
+      // Not yet published for this lap, so empty.
+      if ((i64)(seq - (pos + 1)) < 0) {
+        return 0;
+      }
+      pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+      continue;
+    }
+
+    if (atomic_compare_exchange_weak_explicit(
+            &queue->dequeue_pos, &pos, pos + claim_count, memory_order_relaxed,
+            memory_order_relaxed)) {
+      break;
+    }
+  }
+
+  u64 cap = queue->mask + 1;
+  for (u64 i = 0; i < claim_count; i++) {
+    memcpy(MEM_OFFSET(dest, i * queue->elem_size),
+           CELL_DATA(queue, pos + i), queue->elem_size);
+    // Frees the cell for the producers of the next lap.
+    atomic_store_explicit(CELL_SEQUENCE(queue, pos + i), pos + i + cap,
+                          memory_order_release);
+  }
+
+  return claim_count;
+}
+
+u64 queue_MpmcLen(const MpmcQueue *queue) {
+  NULL_FUNC_ARG_ROUTINE(queue, INVALID_INDEX);
+
+  // Casting away const as C11 atomic_load doesn't take const pointers.
+  MpmcQueue *q = (MpmcQueue *)queue;
+  u64 dequeue_pos =
+      atomic_load_explicit(&q->dequeue_pos, memory_order_acquire);
+  u64 enqueue_pos =
+      atomic_load_explicit(&q->enqueue_pos, memory_order_acquire);
+
+  return (enqueue_pos > dequeue_pos) ? enqueue_pos - dequeue_pos : 0;
+}
+
+u64 queue_MpmcCap(const MpmcQueue *queue) {
+  NULL_FUNC_ARG_ROUTINE(queue, INVALID_INDEX);
+
+  return queue->mask + 1;
+}
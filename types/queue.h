@@ -0,0 +1,61 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../utils/common.h"
+#include "../utils/status.h"
+
+/*
+ * Bounded lock-free ring queues, elements are copied in and out by value like
+ * Vector. The cap is rounded up to a power of 2.
+ *
+ * A full queue on push and an empty one on pop are expected states, so they
+ * return FAILURE without logging. The batch versions move as many elements as
+ * they can, up to count, and return how many they moved.
+ */
+
+/* ----  SPSC QUEUE  ---- */
+
+/*
+ * Exactly one thread may push and exactly one thread may pop at a time. Each
+ * side keeps a cached copy of the other side's index, so the shared cache
+ * lines are only touched when the queue looks full/empty.
+ */
+typedef struct __SpscQueue SpscQueue;
+
+SpscQueue *queue_SpscCreate(u64 elem_size, u64 cap);
+StatusCode queue_SpscDelete(SpscQueue *queue);
+StatusCode queue_SpscPush(SpscQueue *queue, const void *data);
+StatusCode queue_SpscPop(SpscQueue *queue, void *dest);
+u64 queue_SpscPushBatch(SpscQueue *queue, const void *data, u64 count);
+u64 queue_SpscPopBatch(SpscQueue *queue, void *dest, u64 count);
+// Only a snapshot when the other side is running.
+u64 queue_SpscLen(const SpscQueue *queue);
+u64 queue_SpscCap(const SpscQueue *queue);
+
+/* ----  MPMC QUEUE  ---- */
+
+/*
+ * Any number of threads may push and pop. Dmitry Vyukov's bounded queue, every
+ * cell carries a sequence number telling whether it is free to write or ready
+ * to read for the current lap, so producers and consumers only contend on
+ * their own index.
+ */
+typedef struct __MpmcQueue MpmcQueue;
+
+MpmcQueue *queue_MpmcCreate(u64 elem_size, u64 cap);
+StatusCode queue_MpmcDelete(MpmcQueue *queue);
+StatusCode queue_MpmcPush(MpmcQueue *queue, const void *data);
+StatusCode queue_MpmcPop(MpmcQueue *queue, void *dest);
+// The batch is claimed as one contiguous run, so it stays in order.
+u64 queue_MpmcPushBatch(MpmcQueue *queue, const void *data, u64 count);
+u64 queue_MpmcPopBatch(MpmcQueue *queue, void *dest, u64 count);
+// Only a snapshot when other threads are running.
+u64 queue_MpmcLen(const MpmcQueue *queue);
+u64 queue_MpmcCap(const MpmcQueue *queue);
+
+#ifdef __cplusplus
+}
+#endif
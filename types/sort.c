@@ -0,0 +1,312 @@
+// For pthread_barrier_t, which is hidden by -std=c17 otherwise.
+#define _POSIX_C_SOURCE 200809L
+
+#include "sort.h"
+#include <pthread.h>
+#include <stdint.h>
+
+#define RADIX_BITS (8)
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_MASK (RADIX_BUCKETS - 1)
+/*
+ * Below this many keys per thread the extra threads cost more than they save,
+ * so the thread count gets lowered.
+ */
+#define MIN_KEYS_PER_THREAD (1 << 16)
+
+/*
+ * Shared by every thread of one sort. The keys are read through key_size so
+ * one implementation handles both u32 and u64 keys.
+ *
+ * Values aren't moved on every pass, instead an index array is sorted along
+ * with the keys and the values are gathered once at the end. Values of a u64
+ * are moved as the index array themselves, nothing to gather then.
+ */
+typedef struct {
+  void *keys;
+  void *keys_tmp;
+  u64 *indices;
+  u64 *indices_tmp;
+  void *vals;
+  void *vals_tmp;
+  bool vals_as_indices;
+  u64 val_size;
+  u64 len;
+  u32 key_size;
+  u32 thread_count;
+  // thread_count histograms of RADIX_BUCKETS each.
+  u64 *histograms;
+  pthread_barrier_t barrier;
+  /*
+   * Held while the threads get spawned, so they only start once thread_count
+   * and the barrier match the threads that actually exist.
+   */
+  pthread_mutex_t start_lock;
+} RadixSortCtx;
+
+typedef struct {
+  RadixSortCtx *ctx;
+  u32 thread_i;
+} RadixSortWorker;
+
+static StatusCode RadixSort(void *keys, u32 key_size, void *vals, u64 val_size,
+                            u64 len, u32 thread_count,
+                            const Allocator *allocator);
+static void *RadixSortWorkerFunc(void *worker);
+static inline u64 GetKey(const void *keys, u32 key_size, u64 i);
+static inline void SetKey(void *keys, u32 key_size, u64 i, u64 key);
+static inline void WaitForThreads(RadixSortCtx *ctx);
+
+/* ----  PUBLIC FUNCTIONS  ---- */
+
+StatusCode sort_RadixU32(u32 *keys, u64 len) {
+  return sort_RadixU32Parallel(keys, NULL, 0, len, 1, NULL);
+}
+
+StatusCode sort_RadixU64(u64 *keys, u64 len) {
+  return sort_RadixU64Parallel(keys, NULL, 0, len, 1, NULL);
+}
+
+StatusCode sort_RadixU32WPayload(u32 *keys, void *vals, u64 val_size,
+                                 u64 len) {
+  NULL_FUNC_ARG_ROUTINE(vals, NULL_EXCEPTION);
+
+  return sort_RadixU32Parallel(keys, vals, val_size, len, 1, NULL);
+}
+
+StatusCode sort_RadixU64WPayload(u64 *keys, void *vals, u64 val_size,
+                                 u64 len) {
+  NULL_FUNC_ARG_ROUTINE(vals, NULL_EXCEPTION);
+
+  return sort_RadixU64Parallel(keys, vals, val_size, len, 1, NULL);
+}
+
+StatusCode sort_RadixU32Parallel(u32 *keys, void *vals, u64 val_size, u64 len,
+                                 u32 thread_count, const Allocator *allocator) {
+  NULL_FUNC_ARG_ROUTINE(keys, NULL_EXCEPTION);
+
+  return RadixSort(keys, sizeof(u32), vals, val_size, len, thread_count,
+                   allocator);
+}
+
+StatusCode sort_RadixU64Parallel(u64 *keys, void *vals, u64 val_size, u64 len,
+                                 u32 thread_count, const Allocator *allocator) {
+  NULL_FUNC_ARG_ROUTINE(keys, NULL_EXCEPTION);
+
+  return RadixSort(keys, sizeof(u64), vals, val_size, len, thread_count,
+                   allocator);
+}
+
+/* ----  INTERNAL FUNCTIONS  ---- */
+
+static StatusCode RadixSort(void *keys, u32 key_size, void *vals, u64 val_size,
+                            u64 len, u32 thread_count,
+                            const Allocator *allocator) {
+  if (vals && !val_size) {
+    STATUS_LOG(FAILURE, "Cannot sort values of no size.");
+    return FAILURE;
+  }
+  if (len < 2) {
+    return SUCCESS;
+  }
+
+  thread_count = (u32)CLAMP(len / MIN_KEYS_PER_THREAD, 1, MAX(thread_count, 1));
+  Allocator alloc = (allocator) ? *allocator : mem_HeapAllocator();
+
+  RadixSortCtx ctx = {
+      .keys = keys,
+      .vals = vals,
+      .val_size = val_size,
+      .len = len,
+      .key_size = key_size,
+      .thread_count = thread_count,
+      .vals_as_indices = vals && val_size == sizeof(u64) &&
+                         (uintptr_t)vals % _Alignof(u64) == 0,
+  };
+  StatusCode code = SUCCESS;
+  RadixSortWorker *workers = NULL;
+  pthread_t *threads = NULL;
+
+  ctx.keys_tmp = mem_Alloc(&alloc, key_size * len);
+  ctx.histograms =
+      mem_Alloc(&alloc, sizeof(u64) * RADIX_BUCKETS * thread_count);
+  if (vals && ctx.vals_as_indices) {
+    ctx.indices = vals;
+    ctx.indices_tmp = mem_Alloc(&alloc, sizeof(u64) * len);
+  } else if (vals) {
+    ctx.indices = mem_Alloc(&alloc, sizeof(u64) * len);
+    ctx.indices_tmp = mem_Alloc(&alloc, sizeof(u64) * len);
+    ctx.vals_tmp = mem_Alloc(&alloc, val_size * len);
+  }
+  workers = mem_Alloc(&alloc, sizeof(RadixSortWorker) * thread_count);
+  threads = mem_Alloc(&alloc, sizeof(pthread_t) * thread_count);
+  if (!ctx.keys_tmp || !ctx.histograms || !workers || !threads ||
+      (vals && (!ctx.indices || !ctx.indices_tmp ||
+                (!ctx.vals_as_indices && !ctx.vals_tmp)))) {
+    STATUS_LOG(CREATION_FAILURE, "Cannot allocate scratch memory for sort.");
+    code = CREATION_FAILURE;
+    goto cleanup;
+  }
+
+  if (vals && !ctx.vals_as_indices) {
+    for (u64 i = 0; i < len; i++) {
+      ctx.indices[i] = i;
+    }
+  }
+  pthread_mutex_init(&ctx.start_lock, NULL);
+  pthread_mutex_lock(&ctx.start_lock);
+
+  // Thread 0 is the calling thread.
+  u32 spawned_count = 1;
+  for (u32 i = 0; i < thread_count; i++) {
+    workers[i] = (RadixSortWorker){&ctx, i};
+  }
+  for (; spawned_count < thread_count; spawned_count++) {
+    if (pthread_create(&threads[spawned_count], NULL, RadixSortWorkerFunc,
+                       &workers[spawned_count]) != 0) {
+      STATUS_LOG(WARNING, "Cannot spawn all sort threads, sorting with %u.",
+                 spawned_count);
+      break;
+    }
+  }
+  ctx.thread_count = spawned_count;
+  if (ctx.thread_count > 1) {
+    pthread_barrier_init(&ctx.barrier, NULL, ctx.thread_count);
+  }
+  pthread_mutex_unlock(&ctx.start_lock);
+
+  RadixSortWorkerFunc(&workers[0]);
+  for (u32 i = 1; i < spawned_count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  if (ctx.thread_count > 1) {
+    pthread_barrier_destroy(&ctx.barrier);
+  }
+  pthread_mutex_destroy(&ctx.start_lock);
+
+cleanup:
+  // In reverse, so a bump allocator gets all of it back.
+  mem_Free(&alloc, threads, sizeof(pthread_t) * thread_count);
+  mem_Free(&alloc, workers, sizeof(RadixSortWorker) * thread_count);
+  mem_Free(&alloc, ctx.vals_tmp, val_size * len);
+  mem_Free(&alloc, ctx.indices_tmp, sizeof(u64) * len);
+  if (!ctx.vals_as_indices) {
+    mem_Free(&alloc, ctx.indices, sizeof(u64) * len);
+  }
+  mem_Free(&alloc, ctx.histograms,
+           sizeof(u64) * RADIX_BUCKETS * thread_count);
+  mem_Free(&alloc, ctx.keys_tmp, key_size * len);
+
+  return code;
+}
+
+static void *RadixSortWorkerFunc(void *worker) {
+  RadixSortCtx *ctx = ((RadixSortWorker *)worker)->ctx;
+  u32 thread_i = ((RadixSortWorker *)worker)->thread_i;
+
+  pthread_mutex_lock(&ctx->start_lock);
+  pthread_mutex_unlock(&ctx->start_lock);
+
+  u64 begin = ctx->len * thread_i / ctx->thread_count;
+  u64 end = ctx->len * (thread_i + 1) / ctx->thread_count;
+  u64 *histogram = ctx->histograms + (u64)thread_i * RADIX_BUCKETS;
+
+  // Every thread swaps these the same way, so they always agree.
+  void *src = ctx->keys, *dst = ctx->keys_tmp;
+  u64 *src_indices = ctx->indices, *dst_indices = ctx->indices_tmp;
+
+  for (u32 pass = 0; pass < ctx->key_size; pass++) {
+    u32 shift = pass * RADIX_BITS;
+
+    memset(histogram, 0, sizeof(u64) * RADIX_BUCKETS);
+    for (u64 i = begin; i < end; i++) {
+      histogram[(GetKey(src, ctx->key_size, i) >> shift) & RADIX_MASK]++;
+    }
+    WaitForThreads(ctx);
+
+    /*
+     * This thread's first slot for a digit is after every smaller digit, and
+     * after the same digit from the threads before it, which keeps it stable.
+     */
+    u64 offsets[RADIX_BUCKETS];
+    u64 offset = 0;
+    bool skip_pass = false;
+    for (u64 digit = 0; digit < RADIX_BUCKETS; digit++) {
+      u64 digit_count = 0;
+      for (u32 t = 0; t < ctx->thread_count; t++) {
+        if (t == thread_i) {
+          offsets[digit] = offset + digit_count;
+        }
+        digit_count += ctx->histograms[(u64)t * RADIX_BUCKETS + digit];
+      }
+      // Every key has this digit, so the pass wouldn't move anything.
+      if (digit_count == ctx->len) {
+        skip_pass = true;
+        break;
+      }
+      offset += digit_count;
+    }
+
+    if (!skip_pass) {
+      for (u64 i = begin; i < end; i++) {
+        u64 key = GetKey(src, ctx->key_size, i);
+        u64 dst_i = offsets[(key >> shift) & RADIX_MASK]++;
+        SetKey(dst, ctx->key_size, dst_i, key);
+        if (src_indices) {
+          dst_indices[dst_i] = src_indices[i];
+        }
+      }
+    }
+    // Nobody can reuse the histograms or read dst before every scatter is done.
+    WaitForThreads(ctx);
+
+    if (!skip_pass) {
+      SWAP(void *, src, dst);
+      SWAP(u64 *, src_indices, dst_indices);
+    }
+  }
+
+  if (src != ctx->keys) {
+    memcpy(MEM_OFFSET(ctx->keys, begin * ctx->key_size),
+           MEM_OFFSET(src, begin * ctx->key_size),
+           (end - begin) * ctx->key_size);
+  }
+
+  if (ctx->vals_as_indices && src_indices != ctx->indices) {
+    memcpy(ctx->indices + begin, src_indices + begin,
+           (end - begin) * sizeof(u64));
+  } else if (ctx->vals && !ctx->vals_as_indices) {
+    for (u64 i = begin; i < end; i++) {
+      memcpy(MEM_OFFSET(ctx->vals_tmp, i * ctx->val_size),
+             MEM_OFFSET(ctx->vals, src_indices[i] * ctx->val_size),
+             ctx->val_size);
+    }
+    // Every gather has to read the original vals before they get overwritten.
+    WaitForThreads(ctx);
+    memcpy(MEM_OFFSET(ctx->vals, begin * ctx->val_size),
+           MEM_OFFSET(ctx->vals_tmp, begin * ctx->val_size),
+           (end - begin) * ctx->val_size);
+  }
+
+  return NULL;
+}
+
+static inline u64 GetKey(const void *keys, u32 key_size, u64 i) {
+  return (key_size == sizeof(u32)) ? ((const u32 *)keys)[i]
+                                   : ((const u64 *)keys)[i];
+}
+
+static inline void SetKey(void *keys, u32 key_size, u64 i, u64 key) {
+  if (key_size == sizeof(u32)) {
+    ((u32 *)keys)[i] = (u32)key;
+  } else {
+    ((u64 *)keys)[i] = key;
+  }
+}
+
+static inline void WaitForThreads(RadixSortCtx *ctx) {
+  if (ctx->thread_count > 1) {
+    pthread_barrier_wait(&ctx->barrier);
+  }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../utils/common.h"
+#include "../utils/mem.h"
+#include "../utils/status.h"
+
+/*
+ * LSD radix sorts over raw arrays (such as arr_VectorRaw), ascending and
+ * stable. One pass per key byte, and passes where every key has the same byte
+ * are skipped, so keys that only use their low bits sort in fewer passes.
+ *
+ * They allocate scratch space as big as what is sorted, from the heap unless
+ * an allocator is passed.
+ */
+
+StatusCode sort_RadixU32(u32 *keys, u64 len);
+StatusCode sort_RadixU64(u64 *keys, u64 len);
+/*
+ * vals is an array of len elements of val_size bytes each, that gets the same
+ * permutation as keys. Pass a u64 index array to get the permutation itself.
+ * Aligned 8 byte values get sorted in place of the internal index array, which
+ * saves both the index and the value scratch arrays.
+ */
+StatusCode sort_RadixU32WPayload(u32 *keys, void *vals, u64 val_size, u64 len);
+StatusCode sort_RadixU64WPayload(u64 *keys, void *vals, u64 val_size, u64 len);
+/*
+ * Same as the above, with the array split between thread_count threads (the
+ * calling one included). vals may be NULL. A thread_count of 0 or 1 runs on
+ * the calling thread only. The scratch space comes from allocator, a NULL
+ * allocator means the heap.
+ */
+StatusCode sort_RadixU32Parallel(u32 *keys, void *vals, u64 val_size, u64 len,
+                                 u32 thread_count, const Allocator *allocator);
+StatusCode sort_RadixU64Parallel(u64 *keys, void *vals, u64 val_size, u64 len,
+                                 u32 thread_count, const Allocator *allocator);
+
+#ifdef __cplusplus
+}
+#endif
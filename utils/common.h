@@ -35,6 +35,7 @@ typedef double f64;
   } while (0)
 #define MEM_OFFSET(mem, offset) ((u8 *)(mem) + (offset))
 #define IS_POWER_OF_TWO(n) (((n) != 0) && (((n) & ((n) - 1)) == 0))
+#define ALIGN_UP(x, align) (((x) + (align) - 1) / (align) * (align))
 
 #define SET_FLAG(var, flag) (var) |= (flag)
 #define CLEAR_FLAG(var, flag) (var) &= ~(flag)
@@ -54,6 +55,15 @@ typedef double f64;
 #define INVALID_INDEX ((u64)(-1))
 #define INVALID_OFFSET ((u64)(-1))
 
+// Used to pad data shared between threads, to avoid false sharing.
+#define CACHE_LINE_SIZE (64)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(addr) __builtin_prefetch((addr))
+#else
+#define PREFETCH(addr) ((void)(addr))
+#endif // defined(__GNUC__) || defined(__clang__)
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,53 +1,556 @@
+// For MAP_ANONYMOUS, MAP_NORESERVE, madvise, syscall and pthread_mutex_t,
+// hidden by -std=c17 otherwise.
+#define _DEFAULT_SOURCE
+
 #include "mem.h"
 #include "status.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// From linux/mempolicy.h and linux/mman.h, not every libc exposes them.
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED (1)
+#endif // MPOL_PREFERRED
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT (26)
+#endif // MAP_HUGE_SHIFT
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif // MAP_HUGE_2MB
+#endif // defined(__linux__)
+
+/* ----  MEMORY ACCOUNTING  ---- */
+
+/*
+ * Each thread counts into its own counters, and only adds them to the shared
+ * ones every STATS_FLUSH_COUNT records or STATS_FLUSH_BYTES of change, so the
+ * allocation fast paths don't contend on the shared cache lines.
+ */
+#define STATS_FLUSH_COUNT (64)
+#define STATS_FLUSH_BYTES ((i64)1 << 16)
+
+// One cache line per category, so threads flushing for different subsystems
+// don't contend.
+typedef struct {
+  _Alignas(CACHE_LINE_SIZE) _Atomic u64 live_bytes;
+  _Atomic u64 peak_bytes;
+  _Atomic u64 live_count;
+  _Atomic u64 total_count;
+} MemCategoryCounters;
+
+/*
+ * What a thread hasn't flushed yet. Only the owning thread writes it, atomics
+ * just so mem_StatsGet can read it. Frees of memory another thread allocated
+ * wrap the live counts below 0, the sums come out right anyway.
+ */
+typedef struct {
+  _Atomic u64 live_bytes;
+  _Atomic u64 live_count;
+  _Atomic u64 total_count;
+  u64 record_count;
+} ThreadCategoryCounters;
+
+typedef struct __ThreadMemCounters {
+  ThreadCategoryCounters categories[MEM_CATEGORY_COUNT];
+  bool listed;
+  struct __ThreadMemCounters *prev;
+  struct __ThreadMemCounters *next;
+} ThreadMemCounters;
+
+static MemCategoryCounters mem_counters[MEM_CATEGORY_COUNT];
+static _Thread_local ThreadMemCounters thread_mem_counters;
+
+// The counters of every thread that recorded something, guarded by the lock.
+static pthread_mutex_t thread_counters_lock = PTHREAD_MUTEX_INITIALIZER;
+static ThreadMemCounters *thread_counters_list;
+// Flushes and unlists the counters of exiting threads.
+static pthread_key_t thread_counters_key;
+static pthread_once_t thread_counters_key_once = PTHREAD_ONCE_INIT;
+
+static ThreadMemCounters *GetThreadMemCounters(void);
+static void CreateThreadCountersKey(void);
+static void ThreadCountersExitCallback(void *counters);
+static void FlushThreadCounters(MemCategoryCounters *counters,
+                                ThreadCategoryCounters *thread_counters);
+static inline void RaisePeak(MemCategoryCounters *counters, u64 live);
+static inline void RecordStats(MemCategories category, u64 bytes, u64 count,
+                               u64 total);
+
+static ThreadMemCounters *GetThreadMemCounters(void) {
+  ThreadMemCounters *counters = &thread_mem_counters;
+  if (counters->listed) {
+    return counters;
+  }
+
+  pthread_once(&thread_counters_key_once, CreateThreadCountersKey);
+  pthread_mutex_lock(&thread_counters_lock);
+  counters->prev = NULL;
+  counters->next = thread_counters_list;
+  if (thread_counters_list) {
+    thread_counters_list->prev = counters;
+  }
+  thread_counters_list = counters;
+  counters->listed = true;
+  pthread_mutex_unlock(&thread_counters_lock);
+  pthread_setspecific(thread_counters_key, counters);
+
+  return counters;
+}
+
+static void CreateThreadCountersKey(void) {
+  pthread_key_create(&thread_counters_key, ThreadCountersExitCallback);
+}
+
+// Runs on the exiting thread, its thread locals are still there.
+static void ThreadCountersExitCallback(void *counters) {
+  ThreadMemCounters *thread_counters = counters;
+
+  pthread_mutex_lock(&thread_counters_lock);
+  for (u64 i = 0; i < MEM_CATEGORY_COUNT; i++) {
+    FlushThreadCounters(&mem_counters[i], &thread_counters->categories[i]);
+  }
+  if (thread_counters->prev) {
+    thread_counters->prev->next = thread_counters->next;
+  } else {
+    thread_counters_list = thread_counters->next;
+  }
+  if (thread_counters->next) {
+    thread_counters->next->prev = thread_counters->prev;
+  }
+  thread_counters->listed = false;
+  pthread_mutex_unlock(&thread_counters_lock);
+}
+
+/*
+ * Only called by the owning thread, or with thread_counters_lock held while
+ * it exits. A concurrent mem_StatsGet may count the moved values twice or not
+ * at all, it's no consistent snapshot with other threads allocating anyway.
+ */
+static void FlushThreadCounters(MemCategoryCounters *counters,
+                                ThreadCategoryCounters *thread_counters) {
+  u64 bytes = atomic_exchange_explicit(&thread_counters->live_bytes, 0,
+                                       memory_order_relaxed);
+  u64 count = atomic_exchange_explicit(&thread_counters->live_count, 0,
+                                       memory_order_relaxed);
+  u64 total = atomic_exchange_explicit(&thread_counters->total_count, 0,
+                                       memory_order_relaxed);
+  thread_counters->record_count = 0;
+
+  u64 live = atomic_fetch_add_explicit(&counters->live_bytes, bytes,
+                                       memory_order_relaxed) +
+             bytes;
+  atomic_fetch_add_explicit(&counters->live_count, count, memory_order_relaxed);
+  atomic_fetch_add_explicit(&counters->total_count, total,
+                            memory_order_relaxed);
+  RaisePeak(counters, live);
+}
+
+static inline void RaisePeak(MemCategoryCounters *counters, u64 live) {
+  // Only loops while the peak is actually being raised.
+  u64 peak = atomic_load_explicit(&counters->peak_bytes, memory_order_relaxed);
+  while (live > peak &&
+         !atomic_compare_exchange_weak_explicit(&counters->peak_bytes, &peak,
+                                                live, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+}
+
+// bytes and count wrap around for decrements.
+static inline void RecordStats(MemCategories category, u64 bytes, u64 count,
+                               u64 total) {
+  REQUIRE(category < MEM_CATEGORY_COUNT);
+  ThreadCategoryCounters *thread_counters =
+      &GetThreadMemCounters()->categories[category];
+
+  // Plain load and store, nobody else writes these.
+  u64 live = atomic_load_explicit(&thread_counters->live_bytes,
+                                  memory_order_relaxed) +
+             bytes;
+  atomic_store_explicit(&thread_counters->live_bytes, live,
+                        memory_order_relaxed);
+  atomic_store_explicit(&thread_counters->live_count,
+                        atomic_load_explicit(&thread_counters->live_count,
+                                             memory_order_relaxed) +
+                            count,
+                        memory_order_relaxed);
+  atomic_store_explicit(&thread_counters->total_count,
+                        atomic_load_explicit(&thread_counters->total_count,
+                                             memory_order_relaxed) +
+                            total,
+                        memory_order_relaxed);
+
+  if (++thread_counters->record_count >= STATS_FLUSH_COUNT ||
+      (i64)live >= STATS_FLUSH_BYTES || (i64)live <= -STATS_FLUSH_BYTES) {
+    FlushThreadCounters(&mem_counters[category], thread_counters);
+  }
+}
+
+void mem_StatsRecordAlloc(MemCategories category, u64 size) {
+  RecordStats(category, size, 1, 1);
+}
+
+void mem_StatsRecordFree(MemCategories category, u64 size) {
+  RecordStats(category, -size, -(u64)1, 0);
+}
+
+void mem_StatsRecordResize(MemCategories category, u64 old_size, u64 new_size) {
+  RecordStats(category, new_size - old_size, 0, 0);
+}
+
+MemStats mem_StatsGet(MemCategories category) {
+  if (category >= MEM_CATEGORY_COUNT) {
+    STATUS_LOG(FAILURE, "Invalid memory category: %d.", category);
+    return (MemStats){0};
+  }
+  MemCategoryCounters *counters = &mem_counters[category];
+
+  // Not a consistent snapshot across the fields, if other threads allocate.
+  MemStats stats = {
+      .live_bytes = atomic_load_explicit(&counters->live_bytes,
+                                         memory_order_relaxed),
+      .live_count = atomic_load_explicit(&counters->live_count,
+                                         memory_order_relaxed),
+      .total_count = atomic_load_explicit(&counters->total_count,
+                                          memory_order_relaxed),
+  };
+  pthread_mutex_lock(&thread_counters_lock);
+  for (ThreadMemCounters *thread_counters = thread_counters_list;
+       thread_counters; thread_counters = thread_counters->next) {
+    ThreadCategoryCounters *unflushed = &thread_counters->categories[category];
+    stats.live_bytes +=
+        atomic_load_explicit(&unflushed->live_bytes, memory_order_relaxed);
+    stats.live_count +=
+        atomic_load_explicit(&unflushed->live_count, memory_order_relaxed);
+    stats.total_count +=
+        atomic_load_explicit(&unflushed->total_count, memory_order_relaxed);
+  }
+  pthread_mutex_unlock(&thread_counters_lock);
+
+  RaisePeak(counters, stats.live_bytes);
+  stats.peak_bytes =
+      atomic_load_explicit(&counters->peak_bytes, memory_order_relaxed);
+
+  return stats;
+}
+
+StatusCode mem_StatsResetPeak(MemCategories category) {
+  if (category >= MEM_CATEGORY_COUNT) {
+    STATUS_LOG(FAILURE, "Invalid memory category: %d.", category);
+    return FAILURE;
+  }
+
+  MemStats stats = mem_StatsGet(category);
+  atomic_store_explicit(&mem_counters[category].peak_bytes, stats.live_bytes,
+                        memory_order_relaxed);
+
+  return SUCCESS;
+}
+
+const char *mem_CategoryToStr(MemCategories category) {
+  switch (category) {
+  case MEM_CATEGORY_GENERAL:
+    return "GENERAL";
+  case MEM_CATEGORY_ARENA:
+    return "ARENA";
+  case MEM_CATEGORY_ARRAY:
+    return "ARRAY";
+  case MEM_CATEGORY_HASHMAP:
+    return "HASHMAP";
+  case MEM_CATEGORY_ECS:
+    return "ECS";
+  default:
+    return "UNKNOWN";
+  }
+}
+
+StatusCode mem_StatsReportLeaks(MemCategories category) {
+  if (category >= MEM_CATEGORY_COUNT) {
+    STATUS_LOG(FAILURE, "Invalid memory category: %d.", category);
+    return FAILURE;
+  }
+
+  MemStats stats = mem_StatsGet(category);
+  if (stats.live_count || stats.live_bytes) {
+    STATUS_LOG(WARNING,
+               "%s: %zu bytes in %zu allocations still live (peak: %zu bytes, "
+               "total allocations: %zu).",
+               mem_CategoryToStr(category), stats.live_bytes, stats.live_count,
+               stats.peak_bytes, stats.total_count);
+    return WARNING;
+  }
+
+  return SUCCESS;
+}
+
+/* ----  MEMORY BACKING  ---- */
+
+#define HUGE_PAGE_SIZE ((u64)1 << 21)
+
+static u64 GetBackingSize(MemBacking backing, u64 size);
+#if defined(__linux__)
+static void *MapAligned(u64 size, u64 alignment);
+static StatusCode ApplyBacking(void *mem, u64 size, MemBacking backing);
+#endif // defined(__linux__)
+
+// The size backing actually hands out for an allocation of size.
+static u64 GetBackingSize(MemBacking backing, u64 size) {
+#if defined(__linux__)
+  if (backing.mode != MEM_BACKING_HEAP) {
+    return ALIGN_UP(MAX(size, 1), HUGE_PAGE_SIZE);
+  }
+#endif // defined(__linux__)
+  (void)backing;
+  return size;
+}
+
+#if defined(__linux__)
+static void *MapAligned(u64 size, u64 alignment) {
+  // Mapping extra, and cutting off the unaligned head and the tail.
+  u8 *mem = mmap(NULL, size + alignment, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    return NULL;
+  }
+
+  u8 *aligned = (u8 *)ALIGN_UP((uintptr_t)mem, alignment);
+  if (aligned != mem) {
+    munmap(mem, aligned - mem);
+  }
+  munmap(aligned + size, (mem + size + alignment) - (aligned + size));
+
+  return aligned;
+}
+
+static StatusCode ApplyBacking(void *mem, u64 size, MemBacking backing) {
+  // Fails when transparent huge pages are disabled, which is not an error.
+  madvise(mem, size, MADV_HUGEPAGE);
+
+  i32 node = backing.numa_node;
+  if (node == MEM_NUMA_NODE_LOCAL) {
+    unsigned cpu = 0, local_node = 0;
+    node = syscall(SYS_getcpu, &cpu, &local_node, NULL) == 0
+               ? (i32)local_node
+               : MEM_NUMA_NODE_ANY;
+  }
+  if (node < 0) {
+    return SUCCESS;
+  }
+  if (node >= 64) {
+    STATUS_LOG(WARNING, "NUMA node: %d is out of the supported range.", node);
+    return WARNING;
+  }
+
+  /*
+   * Preferred rather than bound, so allocations spill to other nodes instead
+   * of failing when the node runs out of memory. The kernel drops the last
+   * bit of maxnode, hence the + 1.
+   */
+  unsigned long node_mask = 1UL << node;
+  if (syscall(SYS_mbind, mem, size, MPOL_PREFERRED, &node_mask,
+              sizeof(node_mask) * 8 + 1, 0) != 0) {
+    STATUS_LOG(WARNING, "Cannot bind memory to NUMA node: %d.", node);
+    return WARNING;
+  }
+
+  return SUCCESS;
+}
+#endif // defined(__linux__)
+
+void *mem_BackingAlloc(MemBacking backing, u64 size) {
+  return mem_BackingAllocWCategory(backing, size, MEM_CATEGORY_ARENA);
+}
+
+void *mem_BackingAllocWCategory(MemBacking backing, u64 size,
+                                MemCategories category) {
+#if defined(__linux__)
+  if (backing.mode != MEM_BACKING_HEAP) {
+    u64 mapped_size = GetBackingSize(backing, size);
+    void *mem = MAP_FAILED;
+    if (backing.mode == MEM_BACKING_HUGETLB) {
+      // Fails whenever the huge page pool doesn't have enough free pages.
+      mem = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1,
+                 0);
+    }
+    if (mem == MAP_FAILED) {
+      mem = MapAligned(mapped_size, HUGE_PAGE_SIZE);
+      MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(mem, NULL);
+    }
+    // Before anything touches it, so the pages get placed accordingly.
+    ApplyBacking(mem, mapped_size, backing);
+    mem_StatsRecordAlloc(category, mapped_size);
+
+    return mem;
+  }
+#endif // defined(__linux__)
+
+  void *mem = calloc(1, size);
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(mem, NULL);
+  mem_StatsRecordAlloc(category, size);
+
+  return mem;
+}
+
+StatusCode mem_BackingFree(MemBacking backing, void *mem, u64 size) {
+  return mem_BackingFreeWCategory(backing, mem, size, MEM_CATEGORY_ARENA);
+}
+
+StatusCode mem_BackingFreeWCategory(MemBacking backing, void *mem, u64 size,
+                                    MemCategories category) {
+  NULL_FUNC_ARG_ROUTINE(mem, NULL_EXCEPTION);
+
+#if defined(__linux__)
+  if (backing.mode != MEM_BACKING_HEAP) {
+    if (munmap(mem, GetBackingSize(backing, size)) != 0) {
+      STATUS_LOG(FAILURE, "Cannot unmap %zu bytes of backed memory.", size);
+      return FAILURE;
+    }
+    mem_StatsRecordFree(category, GetBackingSize(backing, size));
+    return SUCCESS;
+  }
+#endif // defined(__linux__)
+
+  free(mem);
+  mem_StatsRecordFree(category, size);
+
+  return SUCCESS;
+}
 
 /* ----  BUMP ARENA  ---- */
 
-struct __BumpArena {
-  void *mem;
+/*
+ * Blocks are chained, and never freed before the arena is. A reset or marker
+ * restore only moves curr back, the blocks after it are reused as is once the
+ * allocations get that far again.
+ */
+typedef struct __BumpBlock {
+  struct __BumpBlock *next;
   u64 size;
   u64 offset;
+  // Highest offset reached since the block was last zeroed.
+  u64 dirty;
+} BumpBlock;
+
+// The block's memory comes right after its header.
+#define BUMP_BLOCK_HEADER_SIZE                                                 \
+  ALIGN_UP(sizeof(BumpBlock), BUMP_ARENA_ALIGNMENT)
+#define BUMP_BLOCK_MEM(block) MEM_OFFSET((block), BUMP_BLOCK_HEADER_SIZE)
+
+struct __BumpArena {
+  BumpBlock *first;
+  // The block allocations are currently made from, every block after it is
+  // unused.
+  BumpBlock *curr;
+  // Size of every new block, unless an allocation needs a bigger one.
+  u64 block_size;
+  MemBacking backing;
+  MemCategories category;
 };
 
+static BumpBlock *CreateBumpBlock(const BumpArena *arena, u64 size);
+
+static BumpBlock *CreateBumpBlock(const BumpArena *arena, u64 size) {
+  // Zeroed, so a zeroing reset only has to clear what was handed out.
+  u64 backed_size =
+      GetBackingSize(arena->backing, BUMP_BLOCK_HEADER_SIZE + size);
+  BumpBlock *block =
+      mem_BackingAllocWCategory(arena->backing, backed_size, arena->category);
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(block, NULL);
+
+  block->next = NULL;
+  block->size = backed_size - BUMP_BLOCK_HEADER_SIZE;
+  block->offset = 0;
+  block->dirty = 0;
+
+  return block;
+}
+
 BumpArena *mem_BumpArenaCreate(u64 size) {
+  return mem_BumpArenaCreateWBacking(size, MEM_BACKING_DEFAULT);
+}
+
+BumpArena *mem_BumpArenaCreateWBacking(u64 size, MemBacking backing) {
+  return mem_BumpArenaCreateWCategory(size, backing, MEM_CATEGORY_ARENA);
+}
+
+BumpArena *mem_BumpArenaCreateWCategory(u64 size, MemBacking backing,
+                                        MemCategories category) {
+  REQUIRE(category < MEM_CATEGORY_COUNT);
   BumpArena *arena = malloc(sizeof(BumpArena));
   MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(arena, NULL);
+  mem_StatsRecordAlloc(category, sizeof(BumpArena));
 
-  arena->mem = malloc(size);
-  IF_NULL(arena->mem) {
-    mem_BumpArenaDelete(arena);
-    MEM_ALLOC_FAILURE_SUB_ROUTINE(arena->mem, NULL);
+  arena->block_size = size;
+  arena->backing = backing;
+  arena->category = category;
+  arena->first = arena->curr = CreateBumpBlock(arena, size);
+  IF_NULL(arena->first) {
+    free(arena);
+    mem_StatsRecordFree(category, sizeof(BumpArena));
+    return NULL;
   }
 
-  arena->offset = 0;
-  arena->size = size;
-
   return arena;
 }
 
 StatusCode mem_BumpArenaDelete(BumpArena *arena) {
   NULL_FUNC_ARG_ROUTINE(arena, NULL_EXCEPTION);
 
-  free(arena->mem);
+  BumpBlock *curr = arena->first, *next = NULL;
+  while (curr) {
+    next = curr->next;
+    mem_BackingFreeWCategory(arena->backing, curr,
+                             BUMP_BLOCK_HEADER_SIZE + curr->size,
+                             arena->category);
+    curr = next;
+  }
+  MemCategories category = arena->category;
   free(arena);
+  mem_StatsRecordFree(category, sizeof(BumpArena));
 
   return SUCCESS;
 }
 
 void *mem_BumpArenaAlloc(BumpArena *arena, u64 size) {
-  NULL_FUNC_ARG_ROUTINE(arena, NULL);
+  return mem_BumpArenaAllocAligned(arena, size, BUMP_ARENA_ALIGNMENT);
+}
 
-  if (arena->offset + size > arena->size) {
-    STATUS_LOG(FAILURE,
-               "Bump arena has: %zu, while allocation attempt of: %zu.",
-               arena->size - arena->offset, size);
+void *mem_BumpArenaAllocAligned(BumpArena *arena, u64 size, u64 alignment) {
+  NULL_FUNC_ARG_ROUTINE(arena, NULL);
+  if (!IS_POWER_OF_TWO(alignment)) {
+    STATUS_LOG(FAILURE, "Alignment: %zu is not a power of 2.", alignment);
     return NULL;
   }
 
-  void *ptr = MEM_OFFSET(arena->mem, arena->offset);
-  arena->offset += size;
+  BumpBlock *block = arena->curr;
+  for (;;) {
+    uintptr_t mem = (uintptr_t)BUMP_BLOCK_MEM(block);
+    u64 offset = ALIGN_UP(mem + block->offset, alignment) - mem;
+    if (offset + size <= block->size) {
+      block->offset = offset + size;
+      block->dirty = MAX(block->dirty, block->offset);
+      arena->curr = block;
+      return (void *)(mem + offset);
+    }
 
-  return ptr;
+    // Doesn't fit, moving on to the next block, which is unused.
+    if (!block->next) {
+      block->next =
+          CreateBumpBlock(arena, MAX(arena->block_size, size + alignment));
+      IF_NULL(block->next) {
+        STATUS_LOG(FAILURE, "Cannot grow bump arena for allocation of: %zu.",
+                   size);
+        return NULL;
+      }
+    }
+    block = block->next;
+    block->offset = 0;
+  }
 }
 
 void *mem_BumpArenaCalloc(BumpArena *arena, u64 size) {
@@ -59,11 +562,34 @@ void *mem_BumpArenaCalloc(BumpArena *arena, u64 size) {
   return ptr;
 }
 
-StatusCode mem_BumpArenaReset(BumpArena *arena) {
+StatusCode mem_BumpArenaReset(BumpArena *arena, BumpArenaResetModes mode) {
   NULL_FUNC_ARG_ROUTINE(arena, NULL_EXCEPTION);
 
-  memset(arena->mem, 0, arena->size);
-  arena->offset = 0;
+  if (mode == BUMP_ARENA_RESET_ZERO) {
+    // Only what was handed out since the last zeroing can be non zero.
+    for (BumpBlock *block = arena->first; block; block = block->next) {
+      memset(BUMP_BLOCK_MEM(block), 0, block->dirty);
+      block->dirty = 0;
+    }
+  }
+  arena->curr = arena->first;
+  arena->curr->offset = 0;
+
+  return SUCCESS;
+}
+
+BumpArenaMarker mem_BumpArenaSave(const BumpArena *arena) {
+  NULL_FUNC_ARG_ROUTINE(arena, ((BumpArenaMarker){NULL, 0}));
+
+  return (BumpArenaMarker){.block = arena->curr, .offset = arena->curr->offset};
+}
+
+StatusCode mem_BumpArenaRestore(BumpArena *arena, BumpArenaMarker marker) {
+  NULL_FUNC_ARG_ROUTINE(arena, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(marker.block, NULL_EXCEPTION);
+
+  arena->curr = marker.block;
+  arena->curr->offset = marker.offset;
 
   return SUCCESS;
 }
@@ -71,59 +597,154 @@ StatusCode mem_BumpArenaReset(BumpArena *arena) {
 /* ----  POOL ARENA  ---- */
 
 #define STD_POOL_SIZE (24)
+/*
+ * Each new block holds twice the entries of the last one, up to this. Keeps the
+ * block count logarithmic, while not overshooting by more than a block when a
+ * pool is very big.
+ */
+#define MAX_POOL_BLOCK_ENTRIES ((u64)1 << 16)
 
-typedef struct __MemBlock {
+typedef struct {
   void *mem;
   /*
-   * Using linked memory blocks rather than reallocing, because reallocing the
+   * Using separate memory blocks rather than reallocing, because reallocing the
    * memory will render the original free list structure invalid with no way to
    * replicate it to new mem block.
    */
-  struct __MemBlock *next;
+  u64 entry_count;
 } MemBlock;
 
 struct __PoolArena {
+  /*
+   * Sorted by mem address, so the block owning a pointer is found with a binary
+   * search on free.
+   */
   MemBlock *mem_blocks;
+  u64 mem_blocks_len;
+  u64 mem_blocks_cap;
+  // Entry count of the next block to be added.
+  u64 next_entry_count;
   // A singular free list tracks everything, for true O(1) alloc and dealloc.
   void *free_list;
   u64 block_size;
+  MemBacking backing;
+  MemCategories category;
+  // Entries handed out and not freed yet, reported on delete.
+  u64 live_count;
 };
 
 static StatusCode AddPoolMem(PoolArena *arena);
+static void AddPoolBlockToFreeList(PoolArena *arena, MemBlock *block);
+static MemBlock *FindPoolBlock(const PoolArena *arena, const void *entry);
 
 static StatusCode AddPoolMem(PoolArena *arena) {
-  MemBlock *block = malloc(sizeof(MemBlock));
-  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(block, CREATION_FAILURE);
+  if (arena->mem_blocks_len == arena->mem_blocks_cap) {
+    u64 new_cap = MAX(arena->mem_blocks_cap * 2, 8);
+    MemBlock *new_blocks =
+        realloc(arena->mem_blocks, sizeof(MemBlock) * new_cap);
+    MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(new_blocks, CREATION_FAILURE);
+    if (arena->mem_blocks) {
+      mem_StatsRecordResize(arena->category,
+                            sizeof(MemBlock) * arena->mem_blocks_cap,
+                            sizeof(MemBlock) * new_cap);
+    } else {
+      mem_StatsRecordAlloc(arena->category, sizeof(MemBlock) * new_cap);
+    }
+
+    arena->mem_blocks = new_blocks;
+    arena->mem_blocks_cap = new_cap;
+  }
+
+  // Filling up whatever the backing rounds the block up to.
+  u64 backed_size = GetBackingSize(
+      arena->backing, arena->block_size * arena->next_entry_count);
+  MemBlock block = {.entry_count = backed_size / arena->block_size};
+  block.mem = mem_BackingAllocWCategory(
+      arena->backing, arena->block_size * block.entry_count, arena->category);
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(block.mem, CREATION_FAILURE);
+  arena->next_entry_count =
+      MIN(arena->next_entry_count * 2, MAX_POOL_BLOCK_ENTRIES);
 
-  block->mem = malloc(arena->block_size * STD_POOL_SIZE);
-  IF_NULL(block->mem) {
-    free(block);
-    MEM_ALLOC_FAILURE_SUB_ROUTINE(block->mem, CREATION_FAILURE);
+  // Inserting in address order.
+  u64 i = arena->mem_blocks_len;
+  while (i > 0 && (uintptr_t)arena->mem_blocks[i - 1].mem >
+                      (uintptr_t)block.mem) {
+    arena->mem_blocks[i] = arena->mem_blocks[i - 1];
+    i--;
   }
+  arena->mem_blocks[i] = block;
+  arena->mem_blocks_len++;
+
+  AddPoolBlockToFreeList(arena, &arena->mem_blocks[i]);
 
-  // Adding the new block to the free list.
+  return SUCCESS;
+}
+
+static void AddPoolBlockToFreeList(PoolArena *arena, MemBlock *block) {
   u8 *curr = block->mem;
-  for (u64 i = 0; i < STD_POOL_SIZE - 1; i++) {
+  for (u64 i = 0; i < block->entry_count - 1; i++) {
     *(void **)curr = curr + arena->block_size;
     curr += arena->block_size;
   }
   *(void **)curr = arena->free_list;
   arena->free_list = block->mem;
+}
+
+static MemBlock *FindPoolBlock(const PoolArena *arena, const void *entry) {
+  // Finding the last block starting at or before entry.
+  u64 low = 0, high = arena->mem_blocks_len;
+  while (low < high) {
+    u64 mid = low + (high - low) / 2;
+    if ((uintptr_t)arena->mem_blocks[mid].mem <= (uintptr_t)entry) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (!low) {
+    return NULL;
+  }
 
-  block->next = arena->mem_blocks;
-  arena->mem_blocks = block;
+  MemBlock *block = &arena->mem_blocks[low - 1];
+  u64 offset = (uintptr_t)entry - (uintptr_t)block->mem;
+  if (offset % arena->block_size != 0 ||
+      offset >= arena->block_size * block->entry_count) {
+    return NULL;
+  }
 
-  return SUCCESS;
+  return block;
 }
 
 PoolArena *mem_PoolArenaCreate(u64 block_size) {
+  return mem_PoolArenaCustomCreate(block_size, STD_POOL_SIZE);
+}
+
+PoolArena *mem_PoolArenaCustomCreate(u64 block_size, u64 initial_count) {
+  return mem_PoolArenaCreateWBacking(block_size, initial_count,
+                                     MEM_BACKING_DEFAULT);
+}
+
+PoolArena *mem_PoolArenaCreateWBacking(u64 block_size, u64 initial_count,
+                                       MemBacking backing) {
+  return mem_PoolArenaCreateWCategory(block_size, initial_count, backing,
+                                      MEM_CATEGORY_ARENA);
+}
+
+PoolArena *mem_PoolArenaCreateWCategory(u64 block_size, u64 initial_count,
+                                        MemBacking backing,
+                                        MemCategories category) {
+  REQUIRE(category < MEM_CATEGORY_COUNT);
   PoolArena *arena = calloc(1, sizeof(PoolArena));
   MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(arena, NULL);
+  mem_StatsRecordAlloc(category, sizeof(PoolArena));
 
-  arena->block_size =
-      (block_size < sizeof(void *)) ? sizeof(void *) : block_size;
+  arena->backing = backing;
+  arena->category = category;
+  // Rounded up so that every entry stays pointer aligned.
+  arena->block_size = ALIGN_UP(MAX(block_size, sizeof(void *)), sizeof(void *));
+  arena->next_entry_count = MAX(initial_count, 1);
   IF_FUNC_FAILED(AddPoolMem(arena)) {
-    free(arena);
+    mem_PoolArenaDelete(arena);
     STATUS_LOG(CREATION_FAILURE,
                "Cannot create initial memory of the pool arena with size: %zu.",
                block_size);
@@ -136,15 +757,26 @@ PoolArena *mem_PoolArenaCreate(u64 block_size) {
 StatusCode mem_PoolArenaDelete(PoolArena *arena) {
   NULL_FUNC_ARG_ROUTINE(arena, NULL_EXCEPTION);
 
-  MemBlock *curr = arena->mem_blocks, *next = NULL;
-  while (curr) {
-    next = curr->next;
-    free(curr->mem);
-    free(curr);
-    curr = next;
+  if (arena->live_count) {
+    STATUS_LOG(WARNING,
+               "%s: %zu entries of %zu bytes still live on pool arena delete.",
+               mem_CategoryToStr(arena->category), arena->live_count,
+               arena->block_size);
   }
 
+  MemCategories category = arena->category;
+  for (u64 i = 0; i < arena->mem_blocks_len; i++) {
+    mem_BackingFreeWCategory(arena->backing, arena->mem_blocks[i].mem,
+                             arena->block_size *
+                                 arena->mem_blocks[i].entry_count,
+                             category);
+  }
+  if (arena->mem_blocks) {
+    free(arena->mem_blocks);
+    mem_StatsRecordFree(category, sizeof(MemBlock) * arena->mem_blocks_cap);
+  }
   free(arena);
+  mem_StatsRecordFree(category, sizeof(PoolArena));
 
   return SUCCESS;
 }
@@ -157,6 +789,7 @@ void *mem_PoolArenaAlloc(PoolArena *arena) {
   if (arena->free_list) {
     ptr = arena->free_list;
     arena->free_list = *(void **)arena->free_list;
+    arena->live_count++;
     return ptr;
   }
   IF_FUNC_FAILED(AddPoolMem(arena)) {
@@ -167,6 +800,7 @@ void *mem_PoolArenaAlloc(PoolArena *arena) {
 
   ptr = arena->free_list;
   arena->free_list = *(void **)arena->free_list;
+  arena->live_count++;
 
   return ptr;
 }
@@ -186,44 +820,383 @@ StatusCode mem_PoolArenaFree(PoolArena *arena, void *entry) {
   NULL_FUNC_ARG_ROUTINE(arena, NULL_EXCEPTION);
   NULL_FUNC_ARG_ROUTINE(entry, NULL_EXCEPTION);
 
-  MemBlock *curr = arena->mem_blocks;
-  while (curr) {
-    u64 offset = (u8 *)entry - (u8 *)curr->mem;
-    if (offset % arena->block_size == 0 &&
-        offset < arena->block_size * STD_POOL_SIZE) {
-      // Valid ptr of the pool arena.
-      *(void **)entry = arena->free_list;
-      arena->free_list = entry;
-      return SUCCESS;
-    }
-
-    curr = curr->next;
+  IF_NULL(FindPoolBlock(arena, entry)) {
+    STATUS_LOG(FAILURE,
+               "'entry' is not a valid memory of the pool arena to free.");
+    return FAILURE;
   }
 
-  STATUS_LOG(FAILURE,
-             "'entry' is not a valid memory of the pool arena to free.");
+  return mem_PoolArenaFreeUnchecked(arena, entry);
+}
 
-  return FAILURE;
+StatusCode mem_PoolArenaFreeUnchecked(PoolArena *arena, void *entry) {
+  NULL_FUNC_ARG_ROUTINE(arena, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(entry, NULL_EXCEPTION);
+
+  *(void **)entry = arena->free_list;
+  arena->free_list = entry;
+  arena->live_count--;
+
+  return SUCCESS;
 }
 
 StatusCode mem_PoolArenaReset(PoolArena *arena) {
   NULL_FUNC_ARG_ROUTINE(arena, NULL_EXCEPTION);
 
-  MemBlock *curr = arena->mem_blocks;
+  // Everything is free after this, so the free list is rebuilt from scratch.
+  arena->free_list = NULL;
+  arena->live_count = 0;
+  for (u64 i = 0; i < arena->mem_blocks_len; i++) {
+    MemBlock *block = &arena->mem_blocks[i];
+    memset(block->mem, 0, arena->block_size * block->entry_count);
+    AddPoolBlockToFreeList(arena, block);
+  }
 
-  while (curr) {
-    memset(curr->mem, 0, arena->block_size * STD_POOL_SIZE);
+  return SUCCESS;
+}
+
+u64 mem_PoolArenaLiveCount(const PoolArena *arena) {
+  NULL_FUNC_ARG_ROUTINE(arena, 0);
+
+  return arena->live_count;
+}
 
-    u8 *curr2 = curr->mem;
-    for (u64 i = 0; i < STD_POOL_SIZE - 1; i++) {
-      *(void **)curr2 = curr2 + arena->block_size;
-      curr2 += arena->block_size;
+StatusCode mem_PoolArenaTrim(PoolArena *arena) {
+  NULL_FUNC_ARG_ROUTINE(arena, NULL_EXCEPTION);
+  if (!arena->mem_blocks_len) {
+    return SUCCESS;
+  }
+
+  Allocator allocator = mem_HeapAllocatorWCategory(arena->category);
+  u64 counts_size = sizeof(u64) * arena->mem_blocks_len;
+  u64 *free_counts = mem_Calloc(&allocator, counts_size);
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(free_counts, CREATION_FAILURE);
+
+  for (void *entry = arena->free_list; entry; entry = *(void **)entry) {
+    free_counts[FindPoolBlock(arena, entry) - arena->mem_blocks]++;
+  }
+
+  // Unlinking the entries of every block that is entirely free.
+  void **tail = &arena->free_list;
+  for (void *entry = arena->free_list; entry; entry = *(void **)entry) {
+    MemBlock *block = FindPoolBlock(arena, entry);
+    if (free_counts[block - arena->mem_blocks] != block->entry_count) {
+      *tail = entry;
+      tail = entry;
     }
-    *(void **)curr2 = arena->free_list;
-    arena->free_list = curr->mem;
+  }
+  *tail = NULL;
+
+  // Compacting in place keeps the blocks sorted by address.
+  u64 kept_len = 0;
+  for (u64 i = 0; i < arena->mem_blocks_len; i++) {
+    MemBlock *block = &arena->mem_blocks[i];
+    if (free_counts[i] == block->entry_count) {
+      mem_BackingFreeWCategory(arena->backing, block->mem,
+                               arena->block_size * block->entry_count,
+                               arena->category);
+    } else {
+      arena->mem_blocks[kept_len++] = *block;
+    }
+  }
+  arena->mem_blocks_len = kept_len;
+
+  mem_Free(&allocator, free_counts, counts_size);
+
+  return SUCCESS;
+}
+
+/* ----  VIRTUAL MEMORY  ---- */
+
+u64 mem_PageSize(void) {
+#if defined(__linux__)
+  static u64 page_size = 0;
+  if (!page_size) {
+    page_size = (u64)sysconf(_SC_PAGESIZE);
+  }
+  return page_size;
+#else
+  return 4096;
+#endif // defined(__linux__)
+}
+
+void *mem_VirtualReserve(u64 size) {
+#if defined(__linux__)
+  // PROT_NONE + MAP_NORESERVE, so only address space is taken, not memory.
+  void *addr = mmap(NULL, size, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (addr == MAP_FAILED) {
+    STATUS_LOG(CREATION_FAILURE, "Cannot reserve %zu bytes of address space.",
+               size);
+    return NULL;
+  }
+  return addr;
+#else
+  (void)size;
+  STATUS_LOG(FAILURE, "Virtual memory reservation is only supported on Linux.");
+  return NULL;
+#endif // defined(__linux__)
+}
+
+StatusCode mem_VirtualCommit(void *addr, u64 size) {
+  NULL_FUNC_ARG_ROUTINE(addr, NULL_EXCEPTION);
+
+#if defined(__linux__)
+  if (mprotect(addr, size, PROT_READ | PROT_WRITE) != 0) {
+    STATUS_LOG(CREATION_FAILURE, "Cannot commit %zu bytes of memory.", size);
+    return CREATION_FAILURE;
+  }
+  return SUCCESS;
+#else
+  (void)size;
+  return FAILURE;
+#endif // defined(__linux__)
+}
+
+StatusCode mem_VirtualDecommit(void *addr, u64 size) {
+  NULL_FUNC_ARG_ROUTINE(addr, NULL_EXCEPTION);
+
+#if defined(__linux__)
+  if (madvise(addr, size, MADV_DONTNEED) != 0 ||
+      mprotect(addr, size, PROT_NONE) != 0) {
+    STATUS_LOG(FAILURE, "Cannot decommit %zu bytes of memory.", size);
+    return FAILURE;
+  }
+  return SUCCESS;
+#else
+  (void)size;
+  return FAILURE;
+#endif // defined(__linux__)
+}
+
+StatusCode mem_VirtualRelease(void *addr, u64 size) {
+  NULL_FUNC_ARG_ROUTINE(addr, NULL_EXCEPTION);
 
-    curr = curr->next;
+#if defined(__linux__)
+  if (munmap(addr, size) != 0) {
+    STATUS_LOG(FAILURE, "Cannot release %zu bytes of address space.", size);
+    return FAILURE;
   }
+  return SUCCESS;
+#else
+  (void)size;
+  return FAILURE;
+#endif // defined(__linux__)
+}
 
+StatusCode mem_VirtualSetBacking(void *addr, u64 size, MemBacking backing) {
+  NULL_FUNC_ARG_ROUTINE(addr, NULL_EXCEPTION);
+
+#if defined(__linux__)
+  if (backing.mode == MEM_BACKING_HEAP) {
+    return SUCCESS;
+  }
+  return ApplyBacking(addr, size, backing);
+#else
+  (void)size;
+  (void)backing;
   return SUCCESS;
+#endif // defined(__linux__)
+}
+
+/* ----  ALLOCATOR  ---- */
+
+static void *HeapAllocFunc(void *ctx, u64 size);
+static void *HeapCallocFunc(void *ctx, u64 size);
+static void *HeapReallocFunc(void *ctx, void *ptr, u64 old_size, u64 new_size);
+static void HeapFreeFunc(void *ctx, void *ptr, u64 size);
+static void *BumpAllocFunc(void *ctx, u64 size);
+static void *BumpCallocFunc(void *ctx, u64 size);
+static void *BumpReallocFunc(void *ctx, void *ptr, u64 old_size, u64 new_size);
+static void BumpFreeFunc(void *ctx, void *ptr, u64 size);
+static void *PoolAllocFunc(void *ctx, u64 size);
+static void *PoolCallocFunc(void *ctx, u64 size);
+static void *PoolReallocFunc(void *ctx, void *ptr, u64 old_size, u64 new_size);
+static void PoolFreeFunc(void *ctx, void *ptr, u64 size);
+
+// The heap allocators carry their MemCategories in ctx.
+#define HEAP_CATEGORY(ctx) ((MemCategories)(uintptr_t)(ctx))
+
+static void *HeapAllocFunc(void *ctx, u64 size) {
+  void *ptr = malloc(size);
+  if (ptr) {
+    mem_StatsRecordAlloc(HEAP_CATEGORY(ctx), size);
+  }
+  return ptr;
+}
+
+static void *HeapCallocFunc(void *ctx, u64 size) {
+  void *ptr = calloc(1, size);
+  if (ptr) {
+    mem_StatsRecordAlloc(HEAP_CATEGORY(ctx), size);
+  }
+  return ptr;
+}
+
+static void *HeapReallocFunc(void *ctx, void *ptr, u64 old_size,
+                             u64 new_size) {
+  void *new_ptr = realloc(ptr, new_size);
+  if (new_ptr && ptr) {
+    mem_StatsRecordResize(HEAP_CATEGORY(ctx), old_size, new_size);
+  } else if (new_ptr) {
+    mem_StatsRecordAlloc(HEAP_CATEGORY(ctx), new_size);
+  }
+  return new_ptr;
+}
+
+static void HeapFreeFunc(void *ctx, void *ptr, u64 size) {
+  if (ptr) {
+    free(ptr);
+    mem_StatsRecordFree(HEAP_CATEGORY(ctx), size);
+  }
+}
+
+Allocator mem_HeapAllocator(void) {
+  return mem_HeapAllocatorWCategory(MEM_CATEGORY_GENERAL);
+}
+
+Allocator mem_HeapAllocatorWCategory(MemCategories category) {
+  REQUIRE(category < MEM_CATEGORY_COUNT);
+
+  return (Allocator){.alloc_func = HeapAllocFunc,
+                     .calloc_func = HeapCallocFunc,
+                     .realloc_func = HeapReallocFunc,
+                     .free_func = HeapFreeFunc,
+                     .ctx = (void *)(uintptr_t)category};
+}
+
+static void *BumpAllocFunc(void *ctx, u64 size) {
+  return mem_BumpArenaAlloc(ctx, size);
+}
+
+static void *BumpCallocFunc(void *ctx, u64 size) {
+  return mem_BumpArenaCalloc(ctx, size);
+}
+
+static void *BumpReallocFunc(void *ctx, void *ptr, u64 old_size,
+                             u64 new_size) {
+  BumpArena *arena = ctx;
+  BumpBlock *block = arena->curr;
+
+  IF_NULL(ptr) { return mem_BumpArenaAlloc(arena, new_size); }
+  // The latest allocation can just be resized in place.
+  u8 *block_mem = BUMP_BLOCK_MEM(block);
+  if (MEM_OFFSET(ptr, old_size) == block_mem + block->offset &&
+      (u8 *)ptr - block_mem + new_size <= block->size) {
+    block->offset = (u8 *)ptr - block_mem + new_size;
+    block->dirty = MAX(block->dirty, block->offset);
+    return ptr;
+  }
+
+  void *new_ptr = mem_BumpArenaAlloc(arena, new_size);
+  IF_NULL(new_ptr) { return NULL; }
+  memcpy(new_ptr, ptr, MIN(old_size, new_size));
+
+  return new_ptr;
+}
+
+static void BumpFreeFunc(void *ctx, void *ptr, u64 size) {
+  BumpArena *arena = ctx;
+  BumpBlock *block = arena->curr;
+
+  // Only the latest allocation can be given back before a reset.
+  u8 *block_top = MEM_OFFSET(BUMP_BLOCK_MEM(block), block->offset);
+  if (ptr && MEM_OFFSET(ptr, size) == block_top) {
+    block->offset -= size;
+  }
+}
+
+Allocator mem_BumpArenaAllocator(BumpArena *arena) {
+  return (Allocator){.alloc_func = BumpAllocFunc,
+                     .calloc_func = BumpCallocFunc,
+                     .realloc_func = BumpReallocFunc,
+                     .free_func = BumpFreeFunc,
+                     .ctx = arena};
+}
+
+static void *PoolAllocFunc(void *ctx, u64 size) {
+  PoolArena *arena = ctx;
+
+  if (size > arena->block_size) {
+    STATUS_LOG(FAILURE, "Pool arena blocks are: %zu, while allocation attempt "
+                        "of: %zu.",
+               arena->block_size, size);
+    return NULL;
+  }
+
+  return mem_PoolArenaAlloc(arena);
+}
+
+static void *PoolCallocFunc(void *ctx, u64 size) {
+  void *ptr = PoolAllocFunc(ctx, size);
+  IF_NULL(ptr) { return NULL; }
+  memset(ptr, 0, size);
+
+  return ptr;
+}
+
+static void *PoolReallocFunc(void *ctx, void *ptr, u64 old_size,
+                             u64 new_size) {
+  PoolArena *arena = ctx;
+  (void)old_size;
+
+  IF_NULL(ptr) { return PoolAllocFunc(arena, new_size); }
+  if (new_size > arena->block_size) {
+    STATUS_LOG(FAILURE, "Cannot realloc beyond the pool arena block size.");
+    return NULL;
+  }
+
+  return ptr;
+}
+
+static void PoolFreeFunc(void *ctx, void *ptr, u64 size) {
+  (void)size;
+  if (ptr) {
+    mem_PoolArenaFree(ctx, ptr);
+  }
+}
+
+Allocator mem_PoolArenaAllocator(PoolArena *arena) {
+  return (Allocator){.alloc_func = PoolAllocFunc,
+                     .calloc_func = PoolCallocFunc,
+                     .realloc_func = PoolReallocFunc,
+                     .free_func = PoolFreeFunc,
+                     .ctx = arena};
+}
+
+void *mem_Alloc(const Allocator *allocator, u64 size) {
+  // A NULL ctx is MEM_CATEGORY_GENERAL.
+  IF_NULL(allocator) { return HeapAllocFunc(NULL, size); }
+
+  return allocator->alloc_func(allocator->ctx, size);
+}
+
+void *mem_Calloc(const Allocator *allocator, u64 size) {
+  IF_NULL(allocator) { return HeapCallocFunc(NULL, size); }
+
+  if (allocator->calloc_func) {
+    return allocator->calloc_func(allocator->ctx, size);
+  }
+  void *ptr = allocator->alloc_func(allocator->ctx, size);
+  if (ptr) {
+    memset(ptr, 0, size);
+  }
+
+  return ptr;
+}
+
+void *mem_Realloc(const Allocator *allocator, void *ptr, u64 old_size,
+                  u64 new_size) {
+  IF_NULL(allocator) { return HeapReallocFunc(NULL, ptr, old_size, new_size); }
+
+  return allocator->realloc_func(allocator->ctx, ptr, old_size, new_size);
+}
+
+void mem_Free(const Allocator *allocator, void *ptr, u64 size) {
+  IF_NULL(allocator) {
+    HeapFreeFunc(NULL, ptr, size);
+    return;
+  }
+
+  allocator->free_func(allocator->ctx, ptr, size);
 }
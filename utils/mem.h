@@ -7,26 +7,252 @@ extern "C" {
 #include "common.h"
 #include "status.h"
 
+/* ----  MEMORY ACCOUNTING  ---- */
+
+/*
+ * Every allocation made through the heap allocators, arenas and containers is
+ * counted under the category of the subsystem that owns it. Arenas count the
+ * blocks they take from the backing, not the entries they hand out, under
+ * MEM_CATEGORY_ARENA unless created WCategory.
+ */
+typedef enum {
+  MEM_CATEGORY_GENERAL,
+  MEM_CATEGORY_ARENA,
+  MEM_CATEGORY_ARRAY,
+  MEM_CATEGORY_HASHMAP,
+  MEM_CATEGORY_ECS,
+  MEM_CATEGORY_COUNT
+} MemCategories;
+
+typedef struct {
+  u64 live_bytes;
+  /*
+   * Highest live_bytes reached, since the start or mem_StatsResetPeak. Only
+   * checked when a thread flushes its counts and on mem_StatsGet, so it can
+   * miss spikes of up to 64 KiB per thread.
+   */
+  u64 peak_bytes;
+  u64 live_count;
+  // Allocations ever made, including the freed ones.
+  u64 total_count;
+} MemStats;
+
+/*
+ * Thread safe, and cheap enough to call on every allocation: each thread counts
+ * on its own and adds to the shared counts in batches, which mem_StatsGet sums
+ * up. Only needed for memory that doesn't come from an allocator below.
+ */
+void mem_StatsRecordAlloc(MemCategories category, u64 size);
+void mem_StatsRecordFree(MemCategories category, u64 size);
+// For in place growth/shrinking, which doesn't count as a new allocation.
+void mem_StatsRecordResize(MemCategories category, u64 old_size, u64 new_size);
+MemStats mem_StatsGet(MemCategories category);
+StatusCode mem_StatsResetPeak(MemCategories category);
+const char *mem_CategoryToStr(MemCategories category);
+// Logs whatever is still allocated under category, WARNING if anything is.
+StatusCode mem_StatsReportLeaks(MemCategories category);
+
+/* ----  MEMORY BACKING  ---- */
+
+/*
+ * Where the arenas and layout chunks get their memory from.
+ *
+ * MEM_BACKING_HUGE_PAGES maps the memory directly, 2MB aligned, and asks for
+ * transparent huge pages on it (MADV_HUGEPAGE), cutting down on TLB misses for
+ * big arenas. MEM_BACKING_HUGETLB first tries the explicit huge page pool
+ * (MAP_HUGETLB, needs pages reserved through /proc/sys/vm/nr_hugepages), and
+ * falls back to the above when it is empty. Both round every mapping up to 2MB,
+ * so they are only worth it for arenas that get that big. They fall back to
+ * the heap outside of Linux.
+ */
+typedef enum {
+  MEM_BACKING_HEAP,
+  MEM_BACKING_HUGE_PAGES,
+  MEM_BACKING_HUGETLB
+} MemBackingModes;
+
+// Leaves the placement to the kernel, i.e. the node of the first thread to
+// touch each page.
+#define MEM_NUMA_NODE_ANY (-1)
+// The node the creating thread runs on when the memory gets mapped.
+#define MEM_NUMA_NODE_LOCAL (-2)
+
+typedef struct {
+  MemBackingModes mode;
+  /*
+   * NUMA node mapped memory prefers to be placed on (through mbind), can also
+   * be MEM_NUMA_NODE_ANY/LOCAL. Ignored for MEM_BACKING_HEAP.
+   */
+  i32 numa_node;
+} MemBacking;
+
+#define MEM_BACKING_DEFAULT                                                    \
+  ((MemBacking){.mode = MEM_BACKING_HEAP, .numa_node = MEM_NUMA_NODE_ANY})
+
+/*
+ * Returns zeroed memory, which has to be freed with the same backing and size.
+ * Counted as MEM_CATEGORY_ARENA.
+ */
+void *mem_BackingAlloc(MemBacking backing, u64 size);
+StatusCode mem_BackingFree(MemBacking backing, void *mem, u64 size);
+// Same as above, counted under category, which the free has to match.
+void *mem_BackingAllocWCategory(MemBacking backing, u64 size,
+                                MemCategories category);
+StatusCode mem_BackingFreeWCategory(MemBacking backing, void *mem, u64 size,
+                                    MemCategories category);
+
 /* ----  BUMP ARENA  ---- */
 
+/*
+ * Grows by chaining new blocks of the size given at creation (or bigger, for
+ * allocations that don't fit one), so allocations never move and only fail
+ * when the heap does.
+ */
 typedef struct __BumpArena BumpArena;
 
+// Alignment of mem_BumpArenaAlloc, same guarantee as malloc.
+#define BUMP_ARENA_ALIGNMENT (_Alignof(max_align_t))
+
+/*
+ * BUMP_ARENA_RESET_REWIND only moves the offsets back, so a reset costs nothing
+ * no matter the arena size. BUMP_ARENA_RESET_ZERO also zeroes the memory that
+ * was handed out since the last zeroing reset, so every allocation until the
+ * next reset is zeroed like mem_BumpArenaCalloc.
+ */
+typedef enum {
+  BUMP_ARENA_RESET_REWIND,
+  BUMP_ARENA_RESET_ZERO
+} BumpArenaResetModes;
+
+/*
+ * A position in the arena, restoring it frees everything allocated after the
+ * save in one go. For nested scratch allocations:
+ *   BumpArenaMarker marker = mem_BumpArenaSave(arena);
+ *   ... scratch allocations ...
+ *   mem_BumpArenaRestore(arena, marker);
+ *
+ * A marker is invalidated by a reset, or by restoring an older marker.
+ */
+typedef struct {
+  void *block;
+  u64 offset;
+} BumpArenaMarker;
+
 BumpArena *mem_BumpArenaCreate(u64 size);
+// Every block is taken from backing, and uses all of it after rounding.
+BumpArena *mem_BumpArenaCreateWBacking(u64 size, MemBacking backing);
+// Counts the arena and its blocks under category, e.g. that of its owner.
+BumpArena *mem_BumpArenaCreateWCategory(u64 size, MemBacking backing,
+                                        MemCategories category);
 StatusCode mem_BumpArenaDelete(BumpArena *arena);
 void *mem_BumpArenaAlloc(BumpArena *arena, u64 size);
+// alignment must be a power of 2.
+void *mem_BumpArenaAllocAligned(BumpArena *arena, u64 size, u64 alignment);
 void *mem_BumpArenaCalloc(BumpArena *arena, u64 size);
-StatusCode mem_BumpArenaReset(BumpArena *arena);
+StatusCode mem_BumpArenaReset(BumpArena *arena, BumpArenaResetModes mode);
+BumpArenaMarker mem_BumpArenaSave(const BumpArena *arena);
+StatusCode mem_BumpArenaRestore(BumpArena *arena, BumpArenaMarker marker);
 
 /* ----  POOL ARENA  ---- */
 
 typedef struct __PoolArena PoolArena;
 
 PoolArena *mem_PoolArenaCreate(u64 block_size);
+/*
+ * initial_count is how many entries the first internal block holds, every block
+ * after that holds twice the last one's, up to a cap.
+ */
+PoolArena *mem_PoolArenaCustomCreate(u64 block_size, u64 initial_count);
+/*
+ * Every internal block is taken from backing, and holds as many entries as fit
+ * it after rounding, so with huge pages even the first block holds 2MB worth.
+ */
+PoolArena *mem_PoolArenaCreateWBacking(u64 block_size, u64 initial_count,
+                                       MemBacking backing);
+// Counts the arena and its blocks under category, e.g. that of its owner.
+PoolArena *mem_PoolArenaCreateWCategory(u64 block_size, u64 initial_count,
+                                        MemBacking backing,
+                                        MemCategories category);
+// Logs a WARNING with the count if any entry is still live.
 StatusCode mem_PoolArenaDelete(PoolArena *arena);
 void *mem_PoolArenaAlloc(PoolArena *arena);
 void *mem_PoolArenaCalloc(PoolArena *arena);
+// Checks that entry belongs to the arena, O(log blocks).
 StatusCode mem_PoolArenaFree(PoolArena *arena, void *entry);
+// Skips the check, for callers that know where entry came from.
+StatusCode mem_PoolArenaFreeUnchecked(PoolArena *arena, void *entry);
 StatusCode mem_PoolArenaReset(PoolArena *arena);
+// Entries allocated and not freed yet.
+u64 mem_PoolArenaLiveCount(const PoolArena *arena);
+/*
+ * Gives every internal block with no entry in use back to the OS. Walks the
+ * whole free list, so it is meant for quiet moments (e.g. level unloads), not
+ * every frame.
+ */
+StatusCode mem_PoolArenaTrim(PoolArena *arena);
+
+/* ----  VIRTUAL MEMORY  ---- */
+
+/*
+ * Thin wrappers over mmap/mprotect/madvise to reserve address space up front
+ * and only back it with memory when it is needed. Linux only, they fail on
+ * every other platform.
+ *
+ * Addresses and sizes passed to commit/decommit should be page aligned.
+ */
+u64 mem_PageSize(void);
+void *mem_VirtualReserve(u64 size);
+StatusCode mem_VirtualCommit(void *addr, u64 size);
+// Gives the memory back to the OS, while keeping the address space reserved.
+StatusCode mem_VirtualDecommit(void *addr, u64 size);
+StatusCode mem_VirtualRelease(void *addr, u64 size);
+/*
+ * Applies backing to reserved memory, before it gets committed. Both huge page
+ * modes only ask for transparent huge pages here, as reserved memory can't come
+ * from the explicit huge page pool.
+ */
+StatusCode mem_VirtualSetBacking(void *addr, u64 size, MemBacking backing);
+
+/* ----  ALLOCATOR  ---- */
+
+/*
+ * A generic allocator interface, so that containers can take their memory from
+ * the heap or from any of the arenas above.
+ *
+ * All the sizes are passed on free/realloc as well, so that allocators that
+ * don't track their allocation sizes can still work.
+ */
+typedef struct {
+  void *(*alloc_func)(void *ctx, u64 size);
+  // Can be NULL, in which case alloc_func + memset is used.
+  void *(*calloc_func)(void *ctx, u64 size);
+  void *(*realloc_func)(void *ctx, void *ptr, u64 old_size, u64 new_size);
+  void (*free_func)(void *ctx, void *ptr, u64 size);
+  // Passed as is to the functions above, e.g. the arena.
+  void *ctx;
+} Allocator;
+
+// Counts under MEM_CATEGORY_GENERAL.
+Allocator mem_HeapAllocator(void);
+Allocator mem_HeapAllocatorWCategory(MemCategories category);
+/*
+ * Frees are no-ops except for the latest allocation, the memory is given back
+ * on mem_BumpArenaReset/Restore. Reallocs of the latest allocation grow in
+ * place while its block has room.
+ */
+Allocator mem_BumpArenaAllocator(BumpArena *arena);
+/*
+ * Only allocations up to the pool's block_size can be served, and reallocs
+ * only succeed if they still fit the block.
+ */
+Allocator mem_PoolArenaAllocator(PoolArena *arena);
+
+// A NULL allocator means the heap allocator.
+void *mem_Alloc(const Allocator *allocator, u64 size);
+void *mem_Calloc(const Allocator *allocator, u64 size);
+void *mem_Realloc(const Allocator *allocator, void *ptr, u64 old_size,
+                  u64 new_size);
+void mem_Free(const Allocator *allocator, void *ptr, u64 size);
 
 #ifdef __cplusplus
 }
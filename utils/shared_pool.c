@@ -0,0 +1,447 @@
+// For pthread_mutex_t, which is hidden by -std=c17 otherwise.
+#define _POSIX_C_SOURCE 200809L
+
+#include "shared_pool.h"
+#include <pthread.h>
+
+#define MAGAZINE_SIZE (32)
+
+typedef struct __Magazine {
+  u64 count;
+  void *rounds[MAGAZINE_SIZE];
+  // Only used while the magazine sits in the depot.
+  struct __Magazine *next;
+} Magazine;
+
+struct __SharedPoolArena {
+  // Index into each thread's ThreadMagazines table.
+  u64 slot;
+  // Unique over the whole program, so a slot reused by a new arena is noticed.
+  u64 id;
+  u64 block_size;
+  /*
+   * Everything below is the depot and is only touched with depot_lock held.
+   * The depot's full magazines always have entries, its empty ones never do.
+   */
+  pthread_mutex_t depot_lock;
+  PoolArena *pool;
+  PoolArena *magazine_pool;
+  Magazine *full_magazines;
+  Magazine *empty_magazines;
+};
+
+typedef struct {
+  // Id of the arena the magazines belong to, 0 for none.
+  u64 arena_id;
+  Magazine *loaded;
+  Magazine *previous;
+} ThreadMagazines;
+
+static _Thread_local ThreadMagazines thread_magazines[MAX_SHARED_POOL_ARENAS];
+
+/*
+ * Guards the slot assignment of arenas. Held while a thread exiting flushes
+ * its magazines, so the arenas it flushes into can't be deleted meanwhile.
+ */
+static pthread_mutex_t arenas_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool arena_slots_used[MAX_SHARED_POOL_ARENAS];
+// The arenas that are fully created, by slot.
+static SharedPoolArena *arena_slots[MAX_SHARED_POOL_ARENAS];
+static u64 next_arena_id = 1;
+// Its destructor flushes the magazines of threads that exit.
+static pthread_key_t thread_exit_key;
+static pthread_once_t thread_exit_key_once = PTHREAD_ONCE_INIT;
+
+static ThreadMagazines *GetThreadMagazines(SharedPoolArena *arena);
+static void FlushMagazines(SharedPoolArena *arena,
+                           ThreadMagazines *magazines);
+static void CreateThreadExitKey(void);
+static void ThreadExitCallback(void *magazines);
+static Magazine *TakeEmptyMagazine(SharedPoolArena *arena);
+static void *AllocSlowPath(SharedPoolArena *arena, ThreadMagazines *magazines);
+static StatusCode FreeSlowPath(SharedPoolArena *arena,
+                               ThreadMagazines *magazines, void *entry);
+
+/* ----  INTERNAL FUNCTIONS  ---- */
+
+static ThreadMagazines *GetThreadMagazines(SharedPoolArena *arena) {
+  ThreadMagazines *magazines = &thread_magazines[arena->slot];
+  if (magazines->arena_id == arena->id) {
+    return magazines;
+  }
+
+  /*
+   * First use from this thread. Whatever the slot held belonged to an arena
+   * that has been deleted, and its magazines went with it.
+   */
+  pthread_mutex_lock(&arena->depot_lock);
+  Magazine *loaded = TakeEmptyMagazine(arena);
+  Magazine *previous = TakeEmptyMagazine(arena);
+  if (!loaded || !previous) {
+    if (loaded) {
+      mem_PoolArenaFreeUnchecked(arena->magazine_pool, loaded);
+    }
+    pthread_mutex_unlock(&arena->depot_lock);
+    STATUS_LOG(CREATION_FAILURE, "Cannot create the thread's magazines.");
+    return NULL;
+  }
+  pthread_mutex_unlock(&arena->depot_lock);
+
+  magazines->arena_id = arena->id;
+  magazines->loaded = loaded;
+  magazines->previous = previous;
+  // Only a non NULL value gets its destructor called on thread exit.
+  pthread_setspecific(thread_exit_key, thread_magazines);
+
+  return magazines;
+}
+
+// Hands the thread's cached entries back to the arena, and its magazines.
+static void FlushMagazines(SharedPoolArena *arena,
+                           ThreadMagazines *magazines) {
+  pthread_mutex_lock(&arena->depot_lock);
+  Magazine *to_flush[] = {magazines->loaded, magazines->previous};
+  for (u64 i = 0; i < sizeof(to_flush) / sizeof(to_flush[0]); i++) {
+    Magazine *magazine = to_flush[i];
+    while (magazine->count) {
+      mem_PoolArenaFreeUnchecked(arena->pool,
+                                 magazine->rounds[--magazine->count]);
+    }
+    magazine->next = arena->empty_magazines;
+    arena->empty_magazines = magazine;
+  }
+  pthread_mutex_unlock(&arena->depot_lock);
+
+  *magazines = (ThreadMagazines){0};
+}
+
+static void CreateThreadExitKey(void) {
+  pthread_key_create(&thread_exit_key, ThreadExitCallback);
+}
+
+// Runs on the exiting thread, its thread locals are still there.
+static void ThreadExitCallback(void *magazines) {
+  (void)magazines;
+
+  pthread_mutex_lock(&arenas_lock);
+  for (u64 slot = 0; slot < MAX_SHARED_POOL_ARENAS; slot++) {
+    SharedPoolArena *arena = arena_slots[slot];
+    // Magazines of deleted arenas went with them.
+    if (arena && thread_magazines[slot].arena_id == arena->id) {
+      FlushMagazines(arena, &thread_magazines[slot]);
+    }
+  }
+  pthread_mutex_unlock(&arenas_lock);
+}
+
+// Depot lock must be held.
+static Magazine *TakeEmptyMagazine(SharedPoolArena *arena) {
+  Magazine *magazine = arena->empty_magazines;
+  if (magazine) {
+    arena->empty_magazines = magazine->next;
+  } else {
+    magazine = mem_PoolArenaAlloc(arena->magazine_pool);
+    MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(magazine, NULL);
+    magazine->count = 0;
+  }
+
+  return magazine;
+}
+
+// Both of the thread's magazines are empty here.
+static void *AllocSlowPath(SharedPoolArena *arena, ThreadMagazines *magazines) {
+  pthread_mutex_lock(&arena->depot_lock);
+
+  if (arena->full_magazines) {
+    Magazine *full = arena->full_magazines;
+    arena->full_magazines = full->next;
+
+    magazines->previous->next = arena->empty_magazines;
+    arena->empty_magazines = magazines->previous;
+    magazines->previous = magazines->loaded;
+    magazines->loaded = full;
+  } else {
+    // Nothing cached anywhere, so half a magazine comes fresh from the pool.
+    Magazine *loaded = magazines->loaded;
+    while (loaded->count < MAGAZINE_SIZE / 2) {
+      void *entry = mem_PoolArenaAlloc(arena->pool);
+      IF_NULL(entry) { break; }
+      loaded->rounds[loaded->count++] = entry;
+    }
+  }
+
+  pthread_mutex_unlock(&arena->depot_lock);
+
+  Magazine *loaded = magazines->loaded;
+  if (!loaded->count) {
+    STATUS_LOG(FAILURE, "Cannot allocate from the shared pool arena.");
+    return NULL;
+  }
+
+  return loaded->rounds[--loaded->count];
+}
+
+// Both of the thread's magazines are full here.
+static StatusCode FreeSlowPath(SharedPoolArena *arena,
+                               ThreadMagazines *magazines, void *entry) {
+  pthread_mutex_lock(&arena->depot_lock);
+
+  Magazine *empty = TakeEmptyMagazine(arena);
+  IF_NULL(empty) {
+    // Can't swap magazines, the entry goes straight back to the pool instead.
+    mem_PoolArenaFreeUnchecked(arena->pool, entry);
+    pthread_mutex_unlock(&arena->depot_lock);
+    return SUCCESS;
+  }
+  magazines->previous->next = arena->full_magazines;
+  arena->full_magazines = magazines->previous;
+  magazines->previous = magazines->loaded;
+  magazines->loaded = empty;
+
+  pthread_mutex_unlock(&arena->depot_lock);
+
+  magazines->loaded->rounds[magazines->loaded->count++] = entry;
+
+  return SUCCESS;
+}
+
+/* ----  SHARED POOL ARENA  ---- */
+
+SharedPoolArena *mem_SharedPoolArenaCreate(u64 block_size) {
+  if (pthread_once(&thread_exit_key_once, CreateThreadExitKey) != 0) {
+    STATUS_LOG(CREATION_FAILURE, "Cannot create the thread exit key.");
+    return NULL;
+  }
+  SharedPoolArena *arena = calloc(1, sizeof(SharedPoolArena));
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(arena, NULL);
+
+  pthread_mutex_lock(&arenas_lock);
+  u64 slot = 0;
+  while (slot < MAX_SHARED_POOL_ARENAS && arena_slots_used[slot]) {
+    slot++;
+  }
+  if (slot == MAX_SHARED_POOL_ARENAS) {
+    pthread_mutex_unlock(&arenas_lock);
+    free(arena);
+    STATUS_LOG(CREATION_FAILURE, "Cannot have more than %d shared pool arenas.",
+               MAX_SHARED_POOL_ARENAS);
+    return NULL;
+  }
+  arena_slots_used[slot] = true;
+  arena->slot = slot;
+  arena->id = next_arena_id++;
+  pthread_mutex_unlock(&arenas_lock);
+
+  arena->pool = mem_PoolArenaCreate(block_size);
+  IF_NULL(arena->pool) {
+    mem_SharedPoolArenaDelete(arena);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(arena->pool, NULL);
+  }
+  arena->magazine_pool = mem_PoolArenaCreate(sizeof(Magazine));
+  IF_NULL(arena->magazine_pool) {
+    mem_SharedPoolArenaDelete(arena);
+    MEM_ALLOC_FAILURE_SUB_ROUTINE(arena->magazine_pool, NULL);
+  }
+  arena->block_size = block_size;
+  pthread_mutex_init(&arena->depot_lock, NULL);
+
+  // Listed once whole, for the exiting threads to flush into.
+  pthread_mutex_lock(&arenas_lock);
+  arena_slots[slot] = arena;
+  pthread_mutex_unlock(&arenas_lock);
+
+  return arena;
+}
+
+StatusCode mem_SharedPoolArenaDelete(SharedPoolArena *arena) {
+  NULL_FUNC_ARG_ROUTINE(arena, NULL_EXCEPTION);
+
+  // Unlisted first, so no exiting thread flushes into it anymore.
+  pthread_mutex_lock(&arenas_lock);
+  arena_slots[arena->slot] = NULL;
+  pthread_mutex_unlock(&arenas_lock);
+
+  /*
+   * The magazines and entries all live in these two pools. Entries cached by
+   * the threads look live to the pools, so they are reset first rather than
+   * reported as leaked.
+   */
+  if (arena->pool) {
+    mem_PoolArenaReset(arena->pool);
+    mem_PoolArenaDelete(arena->pool);
+  }
+  if (arena->magazine_pool) {
+    mem_PoolArenaReset(arena->magazine_pool);
+    mem_PoolArenaDelete(arena->magazine_pool);
+    pthread_mutex_destroy(&arena->depot_lock);
+  }
+
+  pthread_mutex_lock(&arenas_lock);
+  arena_slots_used[arena->slot] = false;
+  pthread_mutex_unlock(&arenas_lock);
+
+  free(arena);
+
+  return SUCCESS;
+}
+
+void *mem_SharedPoolArenaAlloc(SharedPoolArena *arena) {
+  NULL_FUNC_ARG_ROUTINE(arena, NULL);
+
+  ThreadMagazines *magazines = GetThreadMagazines(arena);
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(magazines, NULL);
+
+  if (magazines->loaded->count) {
+    return magazines->loaded->rounds[--magazines->loaded->count];
+  }
+  if (magazines->previous->count) {
+    SWAP(Magazine *, magazines->loaded, magazines->previous);
+    return magazines->loaded->rounds[--magazines->loaded->count];
+  }
+
+  return AllocSlowPath(arena, magazines);
+}
+
+void *mem_SharedPoolArenaCalloc(SharedPoolArena *arena) {
+  NULL_FUNC_ARG_ROUTINE(arena, NULL);
+
+  void *ptr = mem_SharedPoolArenaAlloc(arena);
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(ptr, NULL);
+
+  memset(ptr, 0, arena->block_size);
+
+  return ptr;
+}
+
+StatusCode mem_SharedPoolArenaFree(SharedPoolArena *arena, void *entry) {
+  NULL_FUNC_ARG_ROUTINE(arena, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(entry, NULL_EXCEPTION);
+
+  ThreadMagazines *magazines = GetThreadMagazines(arena);
+  IF_NULL(magazines) {
+    // No magazines to cache it in, so it goes straight back to the pool.
+    pthread_mutex_lock(&arena->depot_lock);
+    mem_PoolArenaFreeUnchecked(arena->pool, entry);
+    pthread_mutex_unlock(&arena->depot_lock);
+    return SUCCESS;
+  }
+
+  if (magazines->loaded->count < MAGAZINE_SIZE) {
+    magazines->loaded->rounds[magazines->loaded->count++] = entry;
+    return SUCCESS;
+  }
+  if (magazines->previous->count < MAGAZINE_SIZE) {
+    SWAP(Magazine *, magazines->loaded, magazines->previous);
+    magazines->loaded->rounds[magazines->loaded->count++] = entry;
+    return SUCCESS;
+  }
+
+  return FreeSlowPath(arena, magazines, entry);
+}
+
+StatusCode mem_SharedPoolArenaFlushThreadCache(SharedPoolArena *arena) {
+  NULL_FUNC_ARG_ROUTINE(arena, NULL_EXCEPTION);
+
+  ThreadMagazines *magazines = &thread_magazines[arena->slot];
+  if (magazines->arena_id != arena->id) {
+    return SUCCESS;
+  }
+  FlushMagazines(arena, magazines);
+
+  return SUCCESS;
+}
+
+u64 mem_SharedPoolArenaLiveCount(SharedPoolArena *arena) {
+  NULL_FUNC_ARG_ROUTINE(arena, 0);
+
+  pthread_mutex_lock(&arena->depot_lock);
+  u64 live_count = mem_PoolArenaLiveCount(arena->pool);
+  pthread_mutex_unlock(&arena->depot_lock);
+
+  return live_count;
+}
+
+StatusCode mem_SharedPoolArenaTrim(SharedPoolArena *arena) {
+  NULL_FUNC_ARG_ROUTINE(arena, NULL_EXCEPTION);
+
+  pthread_mutex_lock(&arena->depot_lock);
+  // Entries cached in the depot are unused, so they go back to the pool first.
+  while (arena->full_magazines) {
+    Magazine *magazine = arena->full_magazines;
+    arena->full_magazines = magazine->next;
+    while (magazine->count) {
+      mem_PoolArenaFreeUnchecked(arena->pool,
+                                 magazine->rounds[--magazine->count]);
+    }
+    mem_PoolArenaFreeUnchecked(arena->magazine_pool, magazine);
+  }
+  while (arena->empty_magazines) {
+    Magazine *magazine = arena->empty_magazines;
+    arena->empty_magazines = magazine->next;
+    mem_PoolArenaFreeUnchecked(arena->magazine_pool, magazine);
+  }
+  mem_PoolArenaTrim(arena->pool);
+  mem_PoolArenaTrim(arena->magazine_pool);
+  pthread_mutex_unlock(&arena->depot_lock);
+
+  return SUCCESS;
+}
+
+/* ----  ALLOCATOR  ---- */
+
+static void *SharedPoolAllocFunc(void *ctx, u64 size);
+static void *SharedPoolCallocFunc(void *ctx, u64 size);
+static void *SharedPoolReallocFunc(void *ctx, void *ptr, u64 old_size,
+                                   u64 new_size);
+static void SharedPoolFreeFunc(void *ctx, void *ptr, u64 size);
+
+static void *SharedPoolAllocFunc(void *ctx, u64 size) {
+  SharedPoolArena *arena = ctx;
+
+  if (size > arena->block_size) {
+    STATUS_LOG(FAILURE, "Shared pool arena blocks are: %zu, while allocation "
+                        "attempt of: %zu.",
+               arena->block_size, size);
+    return NULL;
+  }
+
+  return mem_SharedPoolArenaAlloc(arena);
+}
+
+static void *SharedPoolCallocFunc(void *ctx, u64 size) {
+  void *ptr = SharedPoolAllocFunc(ctx, size);
+  IF_NULL(ptr) { return NULL; }
+  memset(ptr, 0, size);
+
+  return ptr;
+}
+
+static void *SharedPoolReallocFunc(void *ctx, void *ptr, u64 old_size,
+                                   u64 new_size) {
+  SharedPoolArena *arena = ctx;
+  (void)old_size;
+
+  IF_NULL(ptr) { return SharedPoolAllocFunc(arena, new_size); }
+  if (new_size > arena->block_size) {
+    STATUS_LOG(FAILURE,
+               "Cannot realloc beyond the shared pool arena block size.");
+    return NULL;
+  }
+
+  return ptr;
+}
+
+static void SharedPoolFreeFunc(void *ctx, void *ptr, u64 size) {
+  (void)size;
+  if (ptr) {
+    mem_SharedPoolArenaFree(ctx, ptr);
+  }
+}
+
+Allocator mem_SharedPoolArenaAllocator(SharedPoolArena *arena) {
+  return (Allocator){.alloc_func = SharedPoolAllocFunc,
+                     .calloc_func = SharedPoolCallocFunc,
+                     .realloc_func = SharedPoolReallocFunc,
+                     .free_func = SharedPoolFreeFunc,
+                     .ctx = arena};
+}
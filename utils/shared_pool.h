@@ -0,0 +1,56 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+#include "mem.h"
+#include "status.h"
+
+/*
+ * A thread safe PoolArena. Every thread keeps two magazines (small stacks) of
+ * free entries per arena, and allocs/frees only touch those, with no locks or
+ * atomics. Only when both of a thread's magazines are empty (on alloc) or full
+ * (on free) does it lock the shared depot and swap a whole magazine, so the
+ * lock is taken once per MAGAZINE_SIZE ops at most.
+ *
+ * Entries cached by a thread are handed back to the other threads when it
+ * exits, or calls mem_SharedPoolArenaFlushThreadCache. Threads that outlive
+ * their use of an arena can call it to not hold onto the entries meanwhile.
+ *
+ * At most MAX_SHARED_POOL_ARENAS can exist at the same time.
+ */
+typedef struct __SharedPoolArena SharedPoolArena;
+
+#define MAX_SHARED_POOL_ARENAS (64)
+
+SharedPoolArena *mem_SharedPoolArenaCreate(u64 block_size);
+// Caller guarantees no other thread is using the arena anymore.
+StatusCode mem_SharedPoolArenaDelete(SharedPoolArena *arena);
+void *mem_SharedPoolArenaAlloc(SharedPoolArena *arena);
+void *mem_SharedPoolArenaCalloc(SharedPoolArena *arena);
+/*
+ * Unchecked, same as mem_PoolArenaFreeUnchecked. The entry can be freed from
+ * any thread, not just the one that allocated it.
+ */
+StatusCode mem_SharedPoolArenaFree(SharedPoolArena *arena, void *entry);
+// Returns the calling thread's cached entries to the arena.
+StatusCode mem_SharedPoolArenaFlushThreadCache(SharedPoolArena *arena);
+/*
+ * Entries taken from the arena's memory, including those cached by threads and
+ * by the depot, see mem_SharedPoolArenaTrim.
+ */
+u64 mem_SharedPoolArenaLiveCount(SharedPoolArena *arena);
+/*
+ * Returns the depot's cached entries to the arena, and gives its unused memory
+ * back to the OS, same as mem_PoolArenaTrim. Entries still cached by threads
+ * keep their memory in use.
+ */
+StatusCode mem_SharedPoolArenaTrim(SharedPoolArena *arena);
+// Same restrictions as mem_PoolArenaAllocator.
+Allocator mem_SharedPoolArenaAllocator(SharedPoolArena *arena);
+
+#ifdef __cplusplus
+}
+#endif
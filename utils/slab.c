@@ -0,0 +1,258 @@
+// For pthread_mutex_t, which is hidden by -std=c17 otherwise.
+#define _POSIX_C_SOURCE 200809L
+
+#include "slab.h"
+#include "shared_pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define SLAB_CLASS_COUNT (14)
+// Classes up to here are 16 bytes apart.
+#define SLAB_SMALL_CLASS_MAX (64)
+#define SLAB_SMALL_CLASS_STEP (16)
+
+static const u64 slab_class_sizes[SLAB_CLASS_COUNT] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048};
+
+struct __SlabArena {
+  /*
+   * Created on the first allocation of their size. Read without the lock, so
+   * only ever set once under create_lock, with release/acquire ordering.
+   */
+  _Atomic(SharedPoolArena *) classes[SLAB_CLASS_COUNT];
+  pthread_mutex_t create_lock;
+  // What is handed out is counted under this, the size classes as arenas.
+  MemCategories category;
+  // For everything above MAX_SLAB_SIZE, counted under category.
+  Allocator large_allocator;
+};
+
+static inline u64 GetSlabClass(u64 size);
+static SharedPoolArena *GetSlabClassArena(SlabArena *slab, u64 size_class);
+
+/* ----  INTERNAL FUNCTIONS  ---- */
+
+// size must be at most MAX_SLAB_SIZE.
+static inline u64 GetSlabClass(u64 size) {
+  size = MAX(size, 1);
+  if (size <= SLAB_SMALL_CLASS_MAX) {
+    return (size - 1) / SLAB_SMALL_CLASS_STEP;
+  }
+
+  // size is in (power, 2 * power], split in two classes at 1.5 * power.
+  u64 power = SLAB_SMALL_CLASS_MAX, size_class = 0;
+  while (power * 2 < size) {
+    power *= 2;
+    size_class += 2;
+  }
+  size_class += SLAB_SMALL_CLASS_MAX / SLAB_SMALL_CLASS_STEP;
+
+  return size_class + (size > power + power / 2);
+}
+
+static SharedPoolArena *GetSlabClassArena(SlabArena *slab, u64 size_class) {
+  SharedPoolArena *arena =
+      atomic_load_explicit(&slab->classes[size_class], memory_order_acquire);
+  if (arena) {
+    return arena;
+  }
+
+  pthread_mutex_lock(&slab->create_lock);
+  // Another thread might have created it while this one waited.
+  arena =
+      atomic_load_explicit(&slab->classes[size_class], memory_order_relaxed);
+  if (!arena) {
+    arena = mem_SharedPoolArenaCreate(slab_class_sizes[size_class]);
+    if (arena) {
+      atomic_store_explicit(&slab->classes[size_class], arena,
+                            memory_order_release);
+    }
+  }
+  pthread_mutex_unlock(&slab->create_lock);
+
+  IF_NULL(arena) {
+    STATUS_LOG(CREATION_FAILURE, "Cannot create slab size class of: %zu.",
+               slab_class_sizes[size_class]);
+  }
+
+  return arena;
+}
+
+/* ----  SLAB ARENA  ---- */
+
+SlabArena *mem_SlabArenaCreate(void) {
+  return mem_SlabArenaCreateWCategory(MEM_CATEGORY_GENERAL);
+}
+
+SlabArena *mem_SlabArenaCreateWCategory(MemCategories category) {
+  REQUIRE(category < MEM_CATEGORY_COUNT);
+  Allocator allocator = mem_HeapAllocatorWCategory(MEM_CATEGORY_ARENA);
+
+  SlabArena *slab = mem_Alloc(&allocator, sizeof(SlabArena));
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(slab, NULL);
+
+  for (u64 i = 0; i < SLAB_CLASS_COUNT; i++) {
+    atomic_init(&slab->classes[i], NULL);
+  }
+  pthread_mutex_init(&slab->create_lock, NULL);
+  slab->category = category;
+  slab->large_allocator = mem_HeapAllocatorWCategory(category);
+
+  return slab;
+}
+
+StatusCode mem_SlabArenaDelete(SlabArena *slab) {
+  NULL_FUNC_ARG_ROUTINE(slab, NULL_EXCEPTION);
+
+  for (u64 i = 0; i < SLAB_CLASS_COUNT; i++) {
+    SharedPoolArena *arena =
+        atomic_load_explicit(&slab->classes[i], memory_order_acquire);
+    if (arena) {
+      mem_SharedPoolArenaDelete(arena);
+    }
+  }
+  pthread_mutex_destroy(&slab->create_lock);
+
+  Allocator allocator = mem_HeapAllocatorWCategory(MEM_CATEGORY_ARENA);
+  mem_Free(&allocator, slab, sizeof(SlabArena));
+
+  return SUCCESS;
+}
+
+void *mem_SlabArenaAlloc(SlabArena *slab, u64 size) {
+  NULL_FUNC_ARG_ROUTINE(slab, NULL);
+
+  if (size > MAX_SLAB_SIZE) {
+    return mem_Alloc(&slab->large_allocator, size);
+  }
+
+  SharedPoolArena *arena = GetSlabClassArena(slab, GetSlabClass(size));
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(arena, NULL);
+
+  void *ptr = mem_SharedPoolArenaAlloc(arena);
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(ptr, NULL);
+  mem_StatsRecordAlloc(slab->category, size);
+
+  return ptr;
+}
+
+void *mem_SlabArenaCalloc(SlabArena *slab, u64 size) {
+  NULL_FUNC_ARG_ROUTINE(slab, NULL);
+
+  if (size > MAX_SLAB_SIZE) {
+    return mem_Calloc(&slab->large_allocator, size);
+  }
+
+  void *ptr = mem_SlabArenaAlloc(slab, size);
+  MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(ptr, NULL);
+
+  memset(ptr, 0, size);
+
+  return ptr;
+}
+
+void *mem_SlabArenaRealloc(SlabArena *slab, void *ptr, u64 old_size,
+                           u64 new_size) {
+  NULL_FUNC_ARG_ROUTINE(slab, NULL);
+
+  IF_NULL(ptr) { return mem_SlabArenaAlloc(slab, new_size); }
+  if (old_size > MAX_SLAB_SIZE && new_size > MAX_SLAB_SIZE) {
+    return mem_Realloc(&slab->large_allocator, ptr, old_size, new_size);
+  }
+  if (old_size <= MAX_SLAB_SIZE && new_size <= MAX_SLAB_SIZE &&
+      GetSlabClass(old_size) == GetSlabClass(new_size)) {
+    mem_StatsRecordResize(slab->category, old_size, new_size);
+    return ptr;
+  }
+
+  void *new_ptr = mem_SlabArenaAlloc(slab, new_size);
+  IF_NULL(new_ptr) { return NULL; }
+  memcpy(new_ptr, ptr, MIN(old_size, new_size));
+  mem_SlabArenaFree(slab, ptr, old_size);
+
+  return new_ptr;
+}
+
+StatusCode mem_SlabArenaFree(SlabArena *slab, void *ptr, u64 size) {
+  NULL_FUNC_ARG_ROUTINE(slab, NULL_EXCEPTION);
+  NULL_FUNC_ARG_ROUTINE(ptr, NULL_EXCEPTION);
+
+  if (size > MAX_SLAB_SIZE) {
+    mem_Free(&slab->large_allocator, ptr, size);
+    return SUCCESS;
+  }
+
+  SharedPoolArena *arena = atomic_load_explicit(
+      &slab->classes[GetSlabClass(size)], memory_order_acquire);
+  IF_NULL(arena) {
+    STATUS_LOG(FAILURE, "Nothing of size: %zu was allocated from the slab.",
+               size);
+    return FAILURE;
+  }
+  mem_StatsRecordFree(slab->category, size);
+
+  return mem_SharedPoolArenaFree(arena, ptr);
+}
+
+StatusCode mem_SlabArenaFlushThreadCache(SlabArena *slab) {
+  NULL_FUNC_ARG_ROUTINE(slab, NULL_EXCEPTION);
+
+  for (u64 i = 0; i < SLAB_CLASS_COUNT; i++) {
+    SharedPoolArena *arena =
+        atomic_load_explicit(&slab->classes[i], memory_order_acquire);
+    if (arena) {
+      mem_SharedPoolArenaFlushThreadCache(arena);
+    }
+  }
+
+  return SUCCESS;
+}
+
+StatusCode mem_SlabArenaTrim(SlabArena *slab) {
+  NULL_FUNC_ARG_ROUTINE(slab, NULL_EXCEPTION);
+
+  for (u64 i = 0; i < SLAB_CLASS_COUNT; i++) {
+    SharedPoolArena *arena =
+        atomic_load_explicit(&slab->classes[i], memory_order_acquire);
+    if (arena) {
+      mem_SharedPoolArenaTrim(arena);
+    }
+  }
+
+  return SUCCESS;
+}
+
+/* ----  ALLOCATOR  ---- */
+
+static void *SlabAllocFunc(void *ctx, u64 size);
+static void *SlabCallocFunc(void *ctx, u64 size);
+static void *SlabReallocFunc(void *ctx, void *ptr, u64 old_size,
+                             u64 new_size);
+static void SlabFreeFunc(void *ctx, void *ptr, u64 size);
+
+static void *SlabAllocFunc(void *ctx, u64 size) {
+  return mem_SlabArenaAlloc(ctx, size);
+}
+
+static void *SlabCallocFunc(void *ctx, u64 size) {
+  return mem_SlabArenaCalloc(ctx, size);
+}
+
+static void *SlabReallocFunc(void *ctx, void *ptr, u64 old_size,
+                             u64 new_size) {
+  return mem_SlabArenaRealloc(ctx, ptr, old_size, new_size);
+}
+
+static void SlabFreeFunc(void *ctx, void *ptr, u64 size) {
+  if (ptr) {
+    mem_SlabArenaFree(ctx, ptr, size);
+  }
+}
+
+Allocator mem_SlabArenaAllocator(SlabArena *slab) {
+  return (Allocator){.alloc_func = SlabAllocFunc,
+                     .calloc_func = SlabCallocFunc,
+                     .realloc_func = SlabReallocFunc,
+                     .free_func = SlabFreeFunc,
+                     .ctx = slab};
+}
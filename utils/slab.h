@@ -0,0 +1,56 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+#include "mem.h"
+#include "status.h"
+
+/*
+ * A general purpose, thread safe allocator for small objects, made of one
+ * SharedPoolArena per size class. Every size class keeps its objects packed
+ * together in the pool's blocks, and the pool's per thread magazines are the
+ * thread caches, so most allocs/frees never lock.
+ *
+ * Sizes are rounded up to the next class (16 byte steps up to 64, then 1.5x
+ * and 2x of every power of 2, up to MAX_SLAB_SIZE), which wastes under a
+ * third of an object at worst. Anything bigger goes to the heap.
+ *
+ * The size has to be passed on free, same as the Allocator interface, so the
+ * slab arena works as a drop in allocator for the containers:
+ *   SlabArena *slab = mem_SlabArenaCreate();
+ *   Allocator allocator = mem_SlabArenaAllocator(slab);
+ *   Vector *vec = arr_VectorCreateWAllocator(sizeof(u64), 16, &allocator);
+ *
+ * A size class only takes memory (and one of the MAX_SHARED_POOL_ARENAS)
+ * once something of its size is allocated. Like the heap allocator, what is
+ * handed out is counted under the slab's category, while the size classes'
+ * blocks are counted as MEM_CATEGORY_ARENA.
+ */
+typedef struct __SlabArena SlabArena;
+
+#define MAX_SLAB_SIZE (2048)
+
+// Counts under MEM_CATEGORY_GENERAL.
+SlabArena *mem_SlabArenaCreate(void);
+SlabArena *mem_SlabArenaCreateWCategory(MemCategories category);
+// Caller guarantees no other thread is using the arena anymore.
+StatusCode mem_SlabArenaDelete(SlabArena *slab);
+void *mem_SlabArenaAlloc(SlabArena *slab, u64 size);
+void *mem_SlabArenaCalloc(SlabArena *slab, u64 size);
+// Stays in place while the new size is still in the same size class.
+void *mem_SlabArenaRealloc(SlabArena *slab, void *ptr, u64 old_size,
+                           u64 new_size);
+// size must be the one ptr was allocated (or last realloced) with.
+StatusCode mem_SlabArenaFree(SlabArena *slab, void *ptr, u64 size);
+// Same as mem_SharedPoolArenaFlushThreadCache, for every size class.
+StatusCode mem_SlabArenaFlushThreadCache(SlabArena *slab);
+// Same as mem_SharedPoolArenaTrim, for every size class.
+StatusCode mem_SlabArenaTrim(SlabArena *slab);
+Allocator mem_SlabArenaAllocator(SlabArena *slab);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,15 +1,684 @@
+// For pthread_key_t, nanosleep, clock_gettime and sched_yield, hidden by
+// -std=c17 otherwise.
+#define _POSIX_C_SOURCE 200809L
+
 #include "status.h"
+#include "../types/queue.h"
 #include <pthread.h>
 #include <stdarg.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define LOG_MSG_SIZE (512)
+#define LOG_LINE_SIZE (1536) // 1536 + 512 = 2048
 
 static const char *StatusToStr(StatusCode code);
+static u64 FormatLogLine(char *log, u64 size, StatusCode code,
+                         const char *file_name, const char *func_name,
+                         i32 line_num, const char *msg);
+static void WriteLog(const char *log, u64 len);
+static void LogV(StatusCode code, const char *file_name,
+                 const char *func_name, i32 line_num, const char *fmt,
+                 va_list args);
 
 static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* ----  LEVELS & RATE LIMITING  ---- */
+
+#define NS_PER_SEC (1000 * 1000 * 1000)
+
+static _Atomic StatusLogLevels log_level = STATUS_LOG_LEVEL_INFO;
+static _Atomic u32 log_rate_limit = STATUS_LOG_RATE_LIMIT;
+// Sites that suppressed something at some point, only ever pushed to.
+static StatusLogSite *log_sites = NULL;
+
+static u64 GetTimeNs(void);
+static void ListLogSite(StatusLogSite *site, StatusCode code,
+                        const char *file_name, const char *func_name,
+                        i32 line_num);
+static void LogSuppressed(const StatusLogSite *site, u32 suppressed);
+static bool AllowLogSite(StatusLogSite *site, StatusCode code,
+                         const char *file_name, const char *func_name,
+                         i32 line_num);
+static void ReportSuppressed(void);
+
+static u64 GetTimeNs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (u64)now.tv_sec * NS_PER_SEC + (u64)now.tv_nsec;
+}
+
+/*
+ * The site struct lives in the header (every call site has a static one), so
+ * it has plain fields, accessed through the __atomic builtins here.
+ */
+static void ListLogSite(StatusLogSite *site, StatusCode code,
+                        const char *file_name, const char *func_name,
+                        i32 line_num) {
+  if (__atomic_exchange_n(&site->listed, true, __ATOMIC_RELAXED)) {
+    return;
+  }
+  site->code = code;
+  site->file_name = file_name;
+  site->func_name = func_name;
+  site->line_num = line_num;
+
+  StatusLogSite *head = __atomic_load_n(&log_sites, __ATOMIC_RELAXED);
+  do {
+    site->next = head;
+  } while (!__atomic_compare_exchange_n(&log_sites, &head, site, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static void LogSuppressed(const StatusLogSite *site, u32 suppressed) {
+  status_Log(WARNING, site->file_name, site->func_name, site->line_num,
+             "%u similar %s messages suppressed by the rate limit.",
+             suppressed, StatusToStr(site->code));
+}
+
+/*
+ * Counts are per one second window, started by the first message after the
+ * last window ran out. Resets racing with other threads can let a few extra
+ * messages through, which is fine for a rate limit.
+ */
+static bool AllowLogSite(StatusLogSite *site, StatusCode code,
+                         const char *file_name, const char *func_name,
+                         i32 line_num) {
+  u32 limit = atomic_load_explicit(&log_rate_limit, memory_order_relaxed);
+  if (!limit) {
+    return true;
+  }
+
+  u64 now = GetTimeNs();
+  u64 window_start = __atomic_load_n(&site->window_start, __ATOMIC_RELAXED);
+  if (now - window_start >= NS_PER_SEC &&
+      __atomic_compare_exchange_n(&site->window_start, &window_start, now,
+                                  false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    __atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+    u32 suppressed =
+        __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+    if (suppressed) {
+      LogSuppressed(site, suppressed);
+    }
+  }
+
+  if (__atomic_fetch_add(&site->count, 1, __ATOMIC_RELAXED) < limit) {
+    return true;
+  }
+  __atomic_fetch_add(&site->suppressed, 1, __ATOMIC_RELAXED);
+  ListLogSite(site, code, file_name, func_name, line_num);
+
+  return false;
+}
+
+static void ReportSuppressed(void) {
+  StatusLogSite *site = __atomic_load_n(&log_sites, __ATOMIC_ACQUIRE);
+  for (; site; site = site->next) {
+    u32 suppressed =
+        __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+    if (suppressed) {
+      LogSuppressed(site, suppressed);
+    }
+  }
+}
+
+StatusCode status_LogSetLevel(StatusLogLevels level) {
+  if (level > STATUS_LOG_LEVEL_NONE) {
+    STATUS_LOG(FAILURE, "Invalid level provided to set log level.");
+    return FAILURE;
+  }
+  atomic_store_explicit(&log_level, level, memory_order_relaxed);
+
+  return SUCCESS;
+}
+
+StatusCode status_LogSetRateLimit(u32 per_second) {
+  atomic_store_explicit(&log_rate_limit, per_second, memory_order_relaxed);
+
+  return SUCCESS;
+}
+
+/* ----  ASYNC LOGGING  ---- */
+
+// Every record is one fixed size element of a thread's ring.
+#define LOG_RECORD_ARGS_SIZE (216)
+#define LOG_RING_CAP (512)
+// Records popped from a ring at once.
+#define LOG_DRAIN_BATCH (16)
+#define LOG_WRITE_BUFFER_SIZE ((u64)1 << 16)
+#define LOG_IDLE_SLEEP_NS (2 * 1000 * 1000)
+
+/*
+ * The message is only formatted by the logging thread. The caller copies the
+ * args out of its va_list as the fmt dictates, 8 bytes per arg (plus a 4 byte
+ * int per '*' width/precision), and strings by value with a u16 length prefix,
+ * as they might not outlive the call.
+ */
+typedef struct {
+  const char *fmt;
+  const char *file_name;
+  const char *func_name;
+  i32 line_num;
+  StatusCode code;
+  // Conversions packed in args, the fmt is cut there if truncated is set.
+  u16 spec_count;
+  bool truncated;
+  u8 args[LOG_RECORD_ARGS_SIZE];
+} LogRecord;
+
+typedef struct {
+  // Points right after the conversion char.
+  const char *end;
+  // Where the length modifier starts, or the conversion char if none.
+  const char *length_start;
+  bool width_star;
+  bool precision_star;
+  // -1 when not given, or given through '*'.
+  i32 precision;
+  char length[3];
+  char conv;
+} LogSpec;
+
+/*
+ * Every logging thread has its own single producer ring, with the logging
+ * thread as the only consumer, so logging never contends with other threads.
+ * Rings are never freed, a thread that exits leaves its ring to the next new
+ * thread instead.
+ */
+typedef struct __LogRing {
+  SpscQueue *queue;
+  _Atomic bool orphaned;
+  // Set by the owner while it pushes, a switch to sync waits for it to clear.
+  _Atomic bool pushing;
+  // Records that didn't fit the ring, reported by the logging thread.
+  _Atomic u64 dropped;
+  struct __LogRing *next;
+} LogRing;
+
+// Only ever pushed to.
+static _Atomic(LogRing *) log_rings = NULL;
+static _Thread_local LogRing *thread_ring = NULL;
+// Logs made while logging (e.g. ring creation failing) go the sync way.
+static _Thread_local bool thread_in_log = false;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static _Atomic StatusLogModes log_mode = STATUS_LOG_SYNC;
+// Serializes mode switches.
+static pthread_mutex_t mode_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic bool log_thread_running = false;
+static pthread_t log_thread;
+// Held by whoever consumes the rings, the logging thread or a flush.
+static pthread_mutex_t consumer_lock = PTHREAD_MUTEX_INITIALIZER;
+static char log_write_buffer[LOG_WRITE_BUFFER_SIZE];
+
+static const char *ParseLogSpec(const char *percent, LogSpec *spec);
+static void PackLogArgs(LogRecord *record, va_list args);
+static u64 FormatLogMsg(const LogRecord *record, char *msg, u64 size);
+static void CreateRingKey(void);
+static void OrphanRing(void *ring);
+static LogRing *GetThreadRing(void);
+static void WaitForLogPushes(void);
+static u64 DrainLogRings(void);
+static void *LogThreadFunc(void *arg);
+
+// percent points at the '%' of the spec.
+static const char *ParseLogSpec(const char *percent, LogSpec *spec) {
+  const char *c = percent + 1;
+  *spec = (LogSpec){.precision = -1};
+
+  while (*c && strchr("-+ #0'", *c)) {
+    c++;
+  }
+  if (*c == '*') {
+    spec->width_star = true;
+    c++;
+  }
+  while (*c >= '0' && *c <= '9') {
+    c++;
+  }
+  if (*c == '.') {
+    c++;
+    spec->precision = 0;
+    if (*c == '*') {
+      spec->precision_star = true;
+      spec->precision = -1;
+      c++;
+    }
+    while (*c >= '0' && *c <= '9') {
+      spec->precision = spec->precision * 10 + (*c - '0');
+      c++;
+    }
+  }
+
+  spec->length_start = c;
+  u64 length_len = 0;
+  while (*c && strchr("hlzjtL", *c) && length_len < 2) {
+    spec->length[length_len++] = *c++;
+  }
+  spec->conv = *c;
+  spec->end = (*c) ? c + 1 : c;
+
+  return spec->end;
+}
+
+#define PACK_ARG(cursor, end, type, val)                                       \
+  do {                                                                         \
+    type packed = (val);                                                       \
+    if ((u64)((end) - (cursor)) < sizeof(packed)) {                            \
+      goto truncated;                                                          \
+    }                                                                          \
+    memcpy((cursor), &packed, sizeof(packed));                                 \
+    (cursor) += sizeof(packed);                                                \
+  } while (0)
+
+static void PackLogArgs(LogRecord *record, va_list args) {
+  u8 *cursor = record->args, *end = record->args + LOG_RECORD_ARGS_SIZE;
+  const char *c = record->fmt;
+
+  while ((c = strchr(c, '%')) != NULL) {
+    LogSpec spec;
+    c = ParseLogSpec(c, &spec);
+    if (spec.conv == '%') {
+      continue;
+    }
+
+    if (spec.width_star) {
+      PACK_ARG(cursor, end, i32, va_arg(args, int));
+    }
+    if (spec.precision_star) {
+      i32 precision = va_arg(args, int);
+      PACK_ARG(cursor, end, i32, precision);
+      spec.precision = precision;
+    }
+
+    const char *length = spec.length;
+    switch (spec.conv) {
+    case 'd':
+    case 'i':
+      if (!strcmp(length, "hh")) {
+        PACK_ARG(cursor, end, i64, (signed char)va_arg(args, int));
+      } else if (!strcmp(length, "h")) {
+        PACK_ARG(cursor, end, i64, (short)va_arg(args, int));
+      } else if (!strcmp(length, "l")) {
+        PACK_ARG(cursor, end, i64, va_arg(args, long));
+      } else if (!strcmp(length, "ll")) {
+        PACK_ARG(cursor, end, i64, va_arg(args, long long));
+      } else if (!strcmp(length, "z")) {
+        PACK_ARG(cursor, end, i64, (i64)va_arg(args, size_t));
+      } else if (!strcmp(length, "j")) {
+        PACK_ARG(cursor, end, i64, va_arg(args, intmax_t));
+      } else if (!strcmp(length, "t")) {
+        PACK_ARG(cursor, end, i64, va_arg(args, ptrdiff_t));
+      } else {
+        PACK_ARG(cursor, end, i64, va_arg(args, int));
+      }
+      break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      if (!strcmp(length, "hh")) {
+        PACK_ARG(cursor, end, u64, (unsigned char)va_arg(args, unsigned));
+      } else if (!strcmp(length, "h")) {
+        PACK_ARG(cursor, end, u64, (unsigned short)va_arg(args, unsigned));
+      } else if (!strcmp(length, "l")) {
+        PACK_ARG(cursor, end, u64, va_arg(args, unsigned long));
+      } else if (!strcmp(length, "ll")) {
+        PACK_ARG(cursor, end, u64, va_arg(args, unsigned long long));
+      } else if (!strcmp(length, "z")) {
+        PACK_ARG(cursor, end, u64, va_arg(args, size_t));
+      } else if (!strcmp(length, "j")) {
+        PACK_ARG(cursor, end, u64, va_arg(args, uintmax_t));
+      } else if (!strcmp(length, "t")) {
+        PACK_ARG(cursor, end, u64, (u64)va_arg(args, ptrdiff_t));
+      } else {
+        PACK_ARG(cursor, end, u64, va_arg(args, unsigned));
+      }
+      break;
+    case 'c':
+      PACK_ARG(cursor, end, i64, va_arg(args, int));
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      if (!strcmp(length, "L")) {
+        PACK_ARG(cursor, end, f64, (f64)va_arg(args, long double));
+      } else {
+        PACK_ARG(cursor, end, f64, va_arg(args, double));
+      }
+      break;
+    case 'p':
+      PACK_ARG(cursor, end, void *, va_arg(args, void *));
+      break;
+    case 's': {
+      const char *str = va_arg(args, const char *);
+      IF_NULL(str) { str = "(null)"; }
+      // Strings get cut to whatever space is left, rather than dropped.
+      u64 space = (u64)(end - cursor);
+      if (space <= sizeof(u16)) {
+        goto truncated;
+      }
+      u64 max_len = space - sizeof(u16);
+      if (spec.precision >= 0) {
+        max_len = MIN(max_len, (u64)spec.precision);
+      }
+      u16 len = (u16)strnlen(str, max_len);
+      PACK_ARG(cursor, end, u16, len);
+      memcpy(cursor, str, len);
+      cursor += len;
+      break;
+    }
+    default:
+      // %n and anything unknown, the message is cut here.
+      goto truncated;
+    }
+    record->spec_count++;
+  }
+  return;
+
+truncated:
+  record->truncated = true;
+}
+
+#undef PACK_ARG
+
+#define UNPACK_ARG(cursor, type, dest)                                         \
+  do {                                                                         \
+    memcpy(&(dest), (cursor), sizeof(type));                                   \
+    (cursor) += sizeof(type);                                                  \
+  } while (0)
+
+static u64 FormatLogMsg(const LogRecord *record, char *msg, u64 size) {
+  const u8 *cursor = record->args;
+  const char *c = record->fmt;
+  u64 len = 0;
+  u16 spec_i = 0;
+
+  while (*c && len + 1 < size) {
+    if (*c != '%') {
+      msg[len++] = *c++;
+      continue;
+    }
+
+    LogSpec spec;
+    const char *spec_start = c;
+    c = ParseLogSpec(c, &spec);
+    if (spec.conv == '%') {
+      msg[len++] = '%';
+      continue;
+    }
+    if (spec_i++ == record->spec_count) {
+      len += snprintf(msg + len, size - len, "...");
+      break;
+    }
+
+    /*
+     * Rebuilding the spec with the '*'s replaced by their values, and the
+     * length modifier matching the packed type.
+     */
+    char spec_str[64];
+    u64 spec_len = 0;
+    for (const char *s = spec_start; s < spec.length_start && spec_len < 32;
+         s++) {
+      if (*s == '*') {
+        i32 star = 0;
+        UNPACK_ARG(cursor, i32, star);
+        spec_len += snprintf(spec_str + spec_len, sizeof(spec_str) - spec_len,
+                             "%d", star);
+      } else {
+        spec_str[spec_len++] = *s;
+      }
+    }
+
+    u64 left = size - len;
+    i32 written = 0;
+    switch (spec.conv) {
+    case 'd':
+    case 'i':
+    case 'c': {
+      i64 val = 0;
+      UNPACK_ARG(cursor, i64, val);
+      if (spec.conv == 'c') {
+        snprintf(spec_str + spec_len, sizeof(spec_str) - spec_len, "c");
+        written = snprintf(msg + len, left, spec_str, (int)val);
+      } else {
+        snprintf(spec_str + spec_len, sizeof(spec_str) - spec_len, "ll%c",
+                 spec.conv);
+        written = snprintf(msg + len, left, spec_str, (long long)val);
+      }
+      break;
+    }
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X': {
+      u64 val = 0;
+      UNPACK_ARG(cursor, u64, val);
+      snprintf(spec_str + spec_len, sizeof(spec_str) - spec_len, "ll%c",
+               spec.conv);
+      written = snprintf(msg + len, left, spec_str, (unsigned long long)val);
+      break;
+    }
+    case 'p': {
+      void *val = NULL;
+      UNPACK_ARG(cursor, void *, val);
+      snprintf(spec_str + spec_len, sizeof(spec_str) - spec_len, "p");
+      written = snprintf(msg + len, left, spec_str, val);
+      break;
+    }
+    case 's': {
+      u16 str_len = 0;
+      UNPACK_ARG(cursor, u16, str_len);
+      char str[LOG_RECORD_ARGS_SIZE];
+      memcpy(str, cursor, str_len);
+      str[str_len] = '\0';
+      cursor += str_len;
+      snprintf(spec_str + spec_len, sizeof(spec_str) - spec_len, "s");
+      written = snprintf(msg + len, left, spec_str, str);
+      break;
+    }
+    default: {
+      f64 val = 0;
+      UNPACK_ARG(cursor, f64, val);
+      snprintf(spec_str + spec_len, sizeof(spec_str) - spec_len, "%c",
+               spec.conv);
+      written = snprintf(msg + len, left, spec_str, val);
+      break;
+    }
+    }
+    len += MIN((u64)MAX(written, 0), left - 1);
+  }
+
+  len = MIN(len, size - 1);
+  msg[len] = '\0';
+
+  return len;
+}
+
+#undef UNPACK_ARG
+
+static void CreateRingKey(void) { pthread_key_create(&ring_key, OrphanRing); }
+
+// Runs when a thread that logged exits.
+static void OrphanRing(void *ring) {
+  atomic_store_explicit(&((LogRing *)ring)->orphaned, true,
+                        memory_order_release);
+}
+
+static LogRing *GetThreadRing(void) {
+  if (thread_ring) {
+    return thread_ring;
+  }
+  pthread_once(&ring_key_once, CreateRingKey);
+
+  LogRing *ring = atomic_load_explicit(&log_rings, memory_order_acquire);
+  for (; ring; ring = ring->next) {
+    bool orphaned = true;
+    if (atomic_compare_exchange_strong_explicit(&ring->orphaned, &orphaned,
+                                                false, memory_order_acquire,
+                                                memory_order_relaxed)) {
+      break;
+    }
+  }
+
+  IF_NULL(ring) {
+    ring = calloc(1, sizeof(LogRing));
+    MEM_ALLOC_FAILURE_NO_CLEANUP_ROUTINE(ring, NULL);
+    ring->queue = queue_SpscCreate(sizeof(LogRecord), LOG_RING_CAP);
+    IF_NULL(ring->queue) {
+      free(ring);
+      MEM_ALLOC_FAILURE_SUB_ROUTINE(ring->queue, NULL);
+    }
+
+    LogRing *head = atomic_load_explicit(&log_rings, memory_order_relaxed);
+    do {
+      ring->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(
+        &log_rings, &head, ring, memory_order_seq_cst, memory_order_relaxed));
+  }
+
+  pthread_setspecific(ring_key, ring);
+  thread_ring = ring;
+
+  return ring;
+}
+
+/*
+ * Called once log_mode is sync, pushes that still saw it async are done after
+ * this, so a flush after it can't miss them.
+ */
+static void WaitForLogPushes(void) {
+  // seq_cst along with the stores and loads in LogV, see there.
+  LogRing *ring = atomic_load_explicit(&log_rings, memory_order_seq_cst);
+  for (; ring; ring = ring->next) {
+    while (atomic_load_explicit(&ring->pushing, memory_order_seq_cst)) {
+      sched_yield();
+    }
+  }
+}
+
+// consumer_lock must be held.
+static u64 DrainLogRings(void) {
+  LogRecord records[LOG_DRAIN_BATCH];
+  u64 drained = 0, used = 0;
+
+  LogRing *ring = atomic_load_explicit(&log_rings, memory_order_acquire);
+  for (; ring; ring = ring->next) {
+    u64 dropped =
+        atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+    if (dropped) {
+      if (used + LOG_LINE_SIZE > LOG_WRITE_BUFFER_SIZE) {
+        WriteLog(log_write_buffer, used);
+        used = 0;
+      }
+      char msg[LOG_MSG_SIZE];
+      snprintf(msg, sizeof(msg),
+               "%zu log messages dropped, as the thread's log ring was full.",
+               dropped);
+      used += FormatLogLine(log_write_buffer + used, LOG_LINE_SIZE, WARNING,
+                            __FILE__, __func__, __LINE__, msg);
+    }
+
+    u64 count = 0;
+    while ((count = queue_SpscPopBatch(ring->queue, records,
+                                       LOG_DRAIN_BATCH)) != 0) {
+      for (u64 i = 0; i < count; i++) {
+        if (used + LOG_LINE_SIZE > LOG_WRITE_BUFFER_SIZE) {
+          WriteLog(log_write_buffer, used);
+          used = 0;
+        }
+        char msg[LOG_MSG_SIZE];
+        FormatLogMsg(&records[i], msg, sizeof(msg));
+        used += FormatLogLine(log_write_buffer + used, LOG_LINE_SIZE,
+                              records[i].code, records[i].file_name,
+                              records[i].func_name, records[i].line_num, msg);
+      }
+      drained += count;
+    }
+  }
+  if (used) {
+    WriteLog(log_write_buffer, used);
+  }
+
+  return drained;
+}
+
+static void *LogThreadFunc(void *arg) {
+  (void)arg;
+
+  while (atomic_load_explicit(&log_thread_running, memory_order_acquire)) {
+    pthread_mutex_lock(&consumer_lock);
+    u64 drained = DrainLogRings();
+    pthread_mutex_unlock(&consumer_lock);
+
+    if (!drained) {
+      struct timespec idle = {.tv_sec = 0, .tv_nsec = LOG_IDLE_SLEEP_NS};
+      nanosleep(&idle, NULL);
+    }
+  }
+
+  return NULL;
+}
+
+StatusCode status_LogSetMode(StatusLogModes mode) {
+  if (mode != STATUS_LOG_SYNC && mode != STATUS_LOG_ASYNC) {
+    STATUS_LOG(FAILURE, "Invalid mode provided to set log mode.");
+    return FAILURE;
+  }
+
+  pthread_mutex_lock(&mode_lock);
+  if (mode == atomic_load_explicit(&log_mode, memory_order_relaxed)) {
+    pthread_mutex_unlock(&mode_lock);
+    return SUCCESS;
+  }
+
+  if (mode == STATUS_LOG_ASYNC) {
+    atomic_store_explicit(&log_thread_running, true, memory_order_release);
+    if (pthread_create(&log_thread, NULL, LogThreadFunc, NULL) != 0) {
+      atomic_store_explicit(&log_thread_running, false, memory_order_release);
+      pthread_mutex_unlock(&mode_lock);
+      STATUS_LOG(CREATION_FAILURE, "Cannot start the logging thread.");
+      return CREATION_FAILURE;
+    }
+    atomic_store_explicit(&log_mode, STATUS_LOG_ASYNC, memory_order_release);
+  } else {
+    atomic_store_explicit(&log_mode, STATUS_LOG_SYNC, memory_order_seq_cst);
+    WaitForLogPushes();
+    atomic_store_explicit(&log_thread_running, false, memory_order_release);
+    pthread_join(log_thread, NULL);
+    status_LogFlush();
+  }
+  pthread_mutex_unlock(&mode_lock);
+
+  return SUCCESS;
+}
+
+StatusCode status_LogFlush(void) {
+  ReportSuppressed();
+
+  pthread_mutex_lock(&consumer_lock);
+  DrainLogRings();
+  pthread_mutex_unlock(&consumer_lock);
+
+  return SUCCESS;
+}
+
+/* ----  LOGGING  ---- */
+
 static const char *StatusToStr(StatusCode code) {
   switch (code) {
   case SUCCESS:
     return "SUCCESS";
+  case WARNING:
+    return "WARNING";
   case FAILURE:
     return "FAILURE";
   case NULL_EXCEPTION:
@@ -25,24 +694,98 @@ static const char *StatusToStr(StatusCode code) {
   }
 }
 
-void status_Log(StatusCode code, const char *file_name, const char *func_name,
-                i32 line_num, const char *fmt, ...) {
-
+static u64 FormatLogLine(char *log, u64 size, StatusCode code,
+                         const char *file_name, const char *func_name,
+                         i32 line_num, const char *msg) {
   IF_NULL(file_name) { file_name = "UnknownFile"; }
   IF_NULL(func_name) { func_name = "UnknownFunc"; }
 
-  va_list args;
-  va_start(args, fmt);
-  char buffer[512];
-  vsnprintf(buffer, sizeof(buffer), fmt, args);
-  va_end(args);
+  i32 len = snprintf(log, size, "[%s] %s:%d (%s): %s\n", StatusToStr(code),
+                     file_name, line_num, func_name, msg);
 
-  char log[1536]; // 1536 + 512 = 2048
-  snprintf(log, sizeof(log), "[%s] %s:%d (%s): %s\n", StatusToStr(code),
-           file_name, line_num, func_name, buffer);
+  return MIN((u64)MAX(len, 0), size - 1);
+}
 
+static void WriteLog(const char *log, u64 len) {
   pthread_mutex_lock(&log_mutex);
-  fputs(log, stdout);
+  fwrite(log, 1, len, stdout);
   fflush(stdout);
   pthread_mutex_unlock(&log_mutex);
 }
+
+static void LogV(StatusCode code, const char *file_name,
+                 const char *func_name, i32 line_num, const char *fmt,
+                 va_list args) {
+  if (STATUS_LOG_LEVEL_OF(code) <
+      atomic_load_explicit(&log_level, memory_order_relaxed)) {
+    return;
+  }
+
+  if (atomic_load_explicit(&log_mode, memory_order_relaxed) ==
+          STATUS_LOG_ASYNC &&
+      !thread_in_log) {
+    thread_in_log = true;
+    LogRing *ring = GetThreadRing();
+    thread_in_log = false;
+
+    /*
+     * The mode is checked again after announcing the push, all seq_cst. Either
+     * a switch to sync sees pushing set and waits for the record before its
+     * flush, or the check here sees sync and the record is written right away.
+     */
+    if (ring) {
+      atomic_store_explicit(&ring->pushing, true, memory_order_seq_cst);
+      bool async = atomic_load_explicit(&log_mode, memory_order_seq_cst) ==
+                   STATUS_LOG_ASYNC;
+
+      if (async) {
+        LogRecord record = {.fmt = fmt,
+                            .file_name = file_name,
+                            .func_name = func_name,
+                            .line_num = line_num,
+                            .code = code};
+        PackLogArgs(&record, args);
+
+        IF_FUNC_FAILED(queue_SpscPush(ring->queue, &record)) {
+          atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        }
+      }
+      atomic_store_explicit(&ring->pushing, false, memory_order_release);
+      if (async) {
+        return;
+      }
+    }
+  }
+
+  char buffer[LOG_MSG_SIZE];
+  vsnprintf(buffer, sizeof(buffer), fmt, args);
+
+  char log[LOG_LINE_SIZE];
+  u64 len = FormatLogLine(log, sizeof(log), code, file_name, func_name,
+                          line_num, buffer);
+  WriteLog(log, len);
+}
+
+void status_Log(StatusCode code, const char *file_name, const char *func_name,
+                i32 line_num, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  LogV(code, file_name, func_name, line_num, fmt, args);
+  va_end(args);
+}
+
+void status_LogAt(StatusLogSite *site, StatusCode code, const char *file_name,
+                  const char *func_name, i32 line_num, const char *fmt, ...) {
+  if (STATUS_LOG_LEVEL_OF(code) <
+      atomic_load_explicit(&log_level, memory_order_relaxed)) {
+    return;
+  }
+  if (site && !AllowLogSite(site, code, file_name, func_name, line_num)) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, fmt);
+  LogV(code, file_name, func_name, line_num, fmt, args);
+  va_end(args);
+}
@@ -32,12 +32,108 @@ typedef enum {
   USE_AFTER_FREE
 } StatusCode;
 
+typedef enum {
+  // SUCCESS
+  STATUS_LOG_LEVEL_INFO,
+  // WARNING
+  STATUS_LOG_LEVEL_WARNING,
+  // Every other StatusCode.
+  STATUS_LOG_LEVEL_ERROR,
+  // Only as a min level, turns logging off.
+  STATUS_LOG_LEVEL_NONE
+} StatusLogLevels;
+
+#define STATUS_LOG_LEVEL_OF(code)                                              \
+  ((code) == SUCCESS   ? STATUS_LOG_LEVEL_INFO                                 \
+   : (code) == WARNING ? STATUS_LOG_LEVEL_WARNING                              \
+                       : STATUS_LOG_LEVEL_ERROR)
+
+/*
+ * STATUS_LOG call sites below this level compile to nothing, args included,
+ * e.g. -DSTATUS_LOG_MIN_LEVEL=STATUS_LOG_LEVEL_ERROR for release builds. The
+ * error routines below still check and return as usual, only silently.
+ */
+#ifndef STATUS_LOG_MIN_LEVEL
+#define STATUS_LOG_MIN_LEVEL STATUS_LOG_LEVEL_INFO
+#endif
+
+// Default for status_LogSetRateLimit.
+#ifndef STATUS_LOG_RATE_LIMIT
+#define STATUS_LOG_RATE_LIMIT (16)
+#endif
+
+/*
+ * Rate limiting state of one STATUS_LOG call site, every call site has its own
+ * static one. Only ever touched by status.c.
+ */
+typedef struct __StatusLogSite {
+  u64 window_start;
+  u32 count;
+  u32 suppressed;
+  // Sites that ever suppressed something are listed, for status_LogFlush.
+  bool listed;
+  StatusCode code;
+  i32 line_num;
+  const char *file_name;
+  const char *func_name;
+  struct __StatusLogSite *next;
+} StatusLogSite;
+
 // A thread safe and generally better logger.
 void status_Log(StatusCode code, const char *file_name,
                        const char *func_name, i32 line_num, const char *fmt,
                        ...);
+// Same as status_Log, but rate limited per site.
+void status_LogAt(StatusLogSite *site, StatusCode code, const char *file_name,
+                  const char *func_name, i32 line_num, const char *fmt, ...);
 #define STATUS_LOG(code, log, ...)                                             \
-  status_Log(code, __FILE__, __func__, __LINE__, log, ##__VA_ARGS__)
+  do {                                                                         \
+    if (STATUS_LOG_LEVEL_OF(code) >= STATUS_LOG_MIN_LEVEL) {                   \
+      static StatusLogSite status_log_site;                                    \
+      status_LogAt(&status_log_site, code, __FILE__, __func__, __LINE__, log,  \
+                   ##__VA_ARGS__);                                             \
+    }                                                                          \
+  } while (0)
+
+// Messages below level are skipped at runtime, on top of STATUS_LOG_MIN_LEVEL.
+StatusCode status_LogSetLevel(StatusLogLevels level);
+/*
+ * At most per_second messages are logged per STATUS_LOG call site every
+ * second, 0 for no limit. Whatever goes over is counted, and the count is
+ * logged as a WARNING once the site logs again in a later second, or on
+ * status_LogFlush.
+ */
+StatusCode status_LogSetRateLimit(u32 per_second);
+
+typedef enum {
+  // Formats and writes on the calling thread, under a lock (the default).
+  STATUS_LOG_SYNC,
+  /*
+   * The calling thread only copies the args into its own ring, without locks
+   * or syscalls, and a background thread formats and writes them in batches.
+   * If a thread logs faster than the background thread keeps up and its ring
+   * fills, messages are dropped (and the drop count is logged) rather than
+   * blocking the caller.
+   *
+   * NOTE: fmt, file_name and func_name have to be string literals (as with
+   * STATUS_LOG), as only their pointers are kept. %n is not supported.
+   */
+  STATUS_LOG_ASYNC
+} StatusLogModes;
+
+/*
+ * Switching to STATUS_LOG_ASYNC starts the logging thread, and switching back
+ * to STATUS_LOG_SYNC stops it after writing everything still pending, messages
+ * other threads log during the switch included.
+ */
+StatusCode status_LogSetMode(StatusLogModes mode);
+/*
+ * Writes every pending async message on the calling thread, along with the
+ * counts of rate limited messages not reported yet, e.g. before an abort or in
+ * a crash handler. Not async signal safe, so only call it from a signal
+ * handler as a best effort right before exiting.
+ */
+StatusCode status_LogFlush(void);
 
 #define IF_NULL(x) if (!(x))
 #define IF_FUNC_FAILED(func_call) if ((func_call) != SUCCESS)